@@ -0,0 +1,137 @@
+/**
+ * @file at_parser.c
+ * @brief Modem receive ring buffer and line tokenizer (see header)
+ */
+
+#include <string.h>
+#include "at_parser.h"
+
+_Static_assert((AT_RX_RING_SIZE & (AT_RX_RING_SIZE - 1)) == 0, "AT_RX_RING_SIZE must be a power of two");
+
+#define RING_MASK (AT_RX_RING_SIZE - 1)
+
+void at_parser_init(at_parser_t *p, at_line_fn_t fallback, void *ctx) {
+    memset(p, 0, sizeof(*p));
+    p->fallback = fallback;
+    p->fallback_ctx = ctx;
+}
+
+bool at_parser_register(at_parser_t *p, const char *prefix, at_line_fn_t fn, void *ctx) {
+    if (p->handler_count >= AT_MAX_HANDLERS) return false;
+
+    at_handler_t *h = &p->handlers[p->handler_count++];
+    h->prefix = prefix;
+    h->prefix_len = strlen(prefix);
+    h->fn = fn;
+    h->ctx = ctx;
+    return true;
+}
+
+void at_parser_expect_raw(at_parser_t *p, at_raw_fn_t fn, void *ctx) {
+    p->raw_fn = fn;
+    p->raw_ctx = ctx;
+}
+
+char *at_parser_rx_space(at_parser_t *p, size_t *room) {
+    uint32_t used = p->head - p->tail;
+    uint32_t at = p->head & RING_MASK;
+    uint32_t to_end = AT_RX_RING_SIZE - at;
+    uint32_t free_bytes = AT_RX_RING_SIZE - used;
+
+    *room = free_bytes < to_end ? free_bytes : to_end;
+    return p->ring + at;
+}
+
+void at_parser_rx_commit(at_parser_t *p, size_t n) {
+    p->head += (uint32_t)n;
+}
+
+static void dispatch_line(at_parser_t *p) {
+    // Blank lines separate responses; nothing to report
+    if (p->line_len == 0) return;
+
+    p->line[p->line_len] = '\0';
+    for (size_t i = 0; i < p->handler_count; i++) {
+        const at_handler_t *h = &p->handlers[i];
+        if (p->line_len >= h->prefix_len && memcmp(p->line, h->prefix, h->prefix_len) == 0) {
+            h->fn(p->line, p->line_len, h->ctx);
+            return;
+        }
+    }
+    if (p->fallback) p->fallback(p->line, p->line_len, p->fallback_ctx);
+}
+
+/**
+ * @brief Consume one contiguous run of bytes, up to and including a '\n'
+ * @return Bytes consumed
+ */
+static size_t consume_run(at_parser_t *p, const char *data, size_t n) {
+    const char *nl = memchr(data, '\n', n);
+    size_t take = nl ? (size_t)(nl - data) + 1 : n;
+
+    if (p->raw_fn) {
+        at_raw_fn_t fn = p->raw_fn;
+        if (nl) p->raw_fn = NULL; // Cleared first so the sink may claim the next line
+        fn(data, take, nl != NULL, p->raw_ctx);
+        return take;
+    }
+
+    if (p->resync) {
+        // Tail of a line whose start was lost: never dispatched
+        if (nl) p->resync = false;
+        return take;
+    }
+
+    size_t text = nl ? take - 1 : take;
+    if (!p->line_overflow) {
+        if (p->line_len + text <= AT_LINE_MAX) {
+            memcpy(p->line + p->line_len, data, text);
+            p->line_len += text;
+        } else {
+            p->line_overflow = true;
+        }
+    }
+
+    if (nl) {
+        if (p->line_overflow) {
+            p->dropped_lines++;
+        } else {
+            if (p->line_len > 0 && p->line[p->line_len - 1] == '\r') p->line_len--;
+            dispatch_line(p);
+        }
+        p->line_len = 0;
+        p->line_overflow = false;
+    }
+    return take;
+}
+
+void at_parser_poll(at_parser_t *p) {
+    while (p->tail != p->head) {
+        uint32_t at = p->tail & RING_MASK;
+        uint32_t avail = p->head - p->tail;
+        uint32_t to_end = AT_RX_RING_SIZE - at;
+        size_t n = avail < to_end ? avail : to_end;
+
+        p->tail += (uint32_t)consume_run(p, p->ring + at, n);
+    }
+}
+
+void at_parser_resync(at_parser_t *p) {
+    p->line_len = 0;
+    p->line_overflow = false;
+    p->resync = (p->raw_fn == NULL);
+    p->resyncs++;
+}
+
+void at_parser_feed(at_parser_t *p, const char *data, size_t n) {
+    while (n > 0) {
+        size_t room;
+        char *dst = at_parser_rx_space(p, &room);
+        if (room > n) room = n;
+        memcpy(dst, data, room);
+        at_parser_rx_commit(p, room);
+        at_parser_poll(p);
+        data += room;
+        n -= room;
+    }
+}
@@ -0,0 +1,121 @@
+/**
+ * @file at_parser.h
+ * @brief Modem receive ring buffer, line tokenizer and prefix dispatch
+ *
+ * UART bytes go into a circular buffer (the driver can read straight into
+ * it, see at_parser_rx_space()). at_parser_poll() scans every byte once,
+ * cuts complete lines and hands each to the first handler whose prefix
+ * matches, or to the fallback. Supporting a new URC is one
+ * at_parser_register() call.
+ *
+ * The line after a PDU header (+CMGL, +CMGR, +CMT, ...) can be claimed with
+ * at_parser_expect_raw(): its bytes are then passed through in chunks as
+ * they arrive instead of being copied into the line buffer, so the line
+ * buffer only has to hold ordinary response lines.
+ *
+ * Pure C with no ESP-IDF dependencies; host tested.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AT_RX_RING_SIZE     2048    // Power of two
+#define AT_LINE_MAX         256     // Longest non-raw line kept; longer lines are dropped
+#define AT_MAX_HANDLERS     12
+
+/**
+ * @brief Handler for one complete line (terminator stripped, NUL-terminated)
+ */
+typedef void (*at_line_fn_t)(const char *line, size_t len, void *ctx);
+
+/**
+ * @brief Sink for a raw line, called once per contiguous chunk
+ *
+ * @param end   Last chunk: it ends with the '\n' terminator
+ */
+typedef void (*at_raw_fn_t)(const char *data, size_t len, bool end, void *ctx);
+
+typedef struct {
+    const char *prefix;
+    size_t prefix_len;
+    at_line_fn_t fn;
+    void *ctx;
+} at_handler_t;
+
+typedef struct {
+    char ring[AT_RX_RING_SIZE];
+    uint32_t head;                      // Write position (free-running)
+    uint32_t tail;                      // Read position (free-running)
+
+    char line[AT_LINE_MAX + 1];
+    size_t line_len;
+    bool line_overflow;                 // Current line is too long and is being dropped
+
+    at_handler_t handlers[AT_MAX_HANDLERS];
+    size_t handler_count;
+    at_line_fn_t fallback;
+    void *fallback_ctx;
+
+    at_raw_fn_t raw_fn;                 // Set: the next line goes here in chunks
+    void *raw_ctx;
+    bool resync;                        // Skipping to the next line start after lost input
+
+    uint32_t dropped_lines;             // Lines longer than AT_LINE_MAX
+    uint32_t resyncs;                   // at_parser_resync() calls
+} at_parser_t;
+
+/**
+ * @brief Reset the parser
+ * @param fallback  Receives lines no registered prefix matches (may be NULL)
+ */
+void at_parser_init(at_parser_t *p, at_line_fn_t fallback, void *ctx);
+
+/**
+ * @brief Route lines starting with @p prefix to @p fn
+ *
+ * Prefixes are tried in registration order. @p prefix must stay valid.
+ *
+ * @return false if the table is full
+ */
+bool at_parser_register(at_parser_t *p, const char *prefix, at_line_fn_t fn, void *ctx);
+
+/**
+ * @brief Deliver the next line raw to @p fn (typically called from a header handler)
+ */
+void at_parser_expect_raw(at_parser_t *p, at_raw_fn_t fn, void *ctx);
+
+/**
+ * @brief Contiguous free space in the ring, for a driver to read into
+ * @param room  Set to the number of bytes that may be written at the result
+ */
+char *at_parser_rx_space(at_parser_t *p, size_t *room);
+
+/**
+ * @brief Account for @p n bytes written at at_parser_rx_space()
+ */
+void at_parser_rx_commit(at_parser_t *p, size_t n);
+
+/**
+ * @brief Tokenize and dispatch everything buffered so far
+ *
+ * A partial line at the end stays pending until more bytes arrive.
+ */
+void at_parser_poll(at_parser_t *p);
+
+/**
+ * @brief Recover from input lost between what is buffered and what comes next
+ *
+ * Call after the driver dropped bytes, once everything received before the
+ * loss has been committed and polled. The partial line is dropped and
+ * parsing restarts at the next line boundary. A claimed raw line stays
+ * claimed, so its sink sees the rest of the line and can skip it.
+ */
+void at_parser_resync(at_parser_t *p);
+
+/**
+ * @brief Copy @p n bytes into the ring and poll, as often as needed to take them all
+ */
+void at_parser_feed(at_parser_t *p, const char *data, size_t n);
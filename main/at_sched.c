@@ -0,0 +1,174 @@
+/**
+ * @file at_sched.c
+ * @brief AT command queue (see header)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "at_sched.h"
+
+void at_sched_init(at_sched_t *s, at_write_fn_t write, void *ctx) {
+    memset(s, 0, sizeof(*s));
+    s->write = write;
+    s->write_ctx = ctx;
+}
+
+/**
+ * @brief Write the oldest queued command if nothing is in flight
+ */
+static void start_next(at_sched_t *s, int64_t now_ms) {
+    if (s->busy || s->resync || s->count == 0) return;
+
+    at_cmd_t *c = &s->queue[s->head];
+    s->busy = true;
+    s->deadline_ms = now_ms + c->timeout_ms;
+    s->write(c->cmd, s->write_ctx);
+}
+
+/**
+ * @brief Hold the queue until the modem is known to be back in step
+ *
+ * The abandoned command's final result may still be on its way; if the
+ * next command went out now, that stale OK would complete it instead.
+ */
+static void begin_resync(at_sched_t *s, int64_t now_ms) {
+    s->resync = true;
+    s->sentinel_sent = false;
+    s->sentinel_ok = false;
+    s->last_rx_ms = now_ms;
+    s->resyncs++;
+}
+
+/**
+ * @brief Retire the in-flight command and start the next one
+ *
+ * With @p resync the next one waits for at_sched_poll() to get a clean
+ * answer from the modem first.
+ */
+static void complete(at_sched_t *s, at_result_t result, int cms_error, int64_t now_ms,
+                     bool resync) {
+    at_cmd_t done = s->queue[s->head];
+
+    s->head = (uint8_t)((s->head + 1) % AT_SCHED_QUEUE_LEN);
+    s->count--;
+    s->busy = false;
+
+    // Next command first: the callback may queue more work behind it
+    if (resync) begin_resync(s, now_ms);
+    start_next(s, now_ms);
+    if (done.on_done) done.on_done(result, cms_error, done.ctx);
+}
+
+/**
+ * @brief Put a command at queue position @p pos (0 = oldest), shifting the
+ *        ones from there back by one
+ */
+static bool insert(at_sched_t *s, uint8_t pos, const char *cmd, uint32_t timeout_ms,
+                   at_cmd_line_fn_t on_line, at_cmd_done_fn_t on_done, void *ctx,
+                   int64_t now_ms) {
+    size_t len = strlen(cmd);
+    if (s->count == AT_SCHED_QUEUE_LEN || len >= AT_SCHED_CMD_MAX) return false;
+
+    for (uint8_t i = s->count; i > pos; i--) {
+        s->queue[(s->head + i) % AT_SCHED_QUEUE_LEN] =
+            s->queue[(s->head + i - 1) % AT_SCHED_QUEUE_LEN];
+    }
+    at_cmd_t *c = &s->queue[(s->head + pos) % AT_SCHED_QUEUE_LEN];
+    memcpy(c->cmd, cmd, len + 1);
+    c->timeout_ms = timeout_ms ? timeout_ms : AT_SCHED_DEFAULT_TIMEOUT_MS;
+    c->on_line = on_line;
+    c->on_done = on_done;
+    c->ctx = ctx;
+    s->count++;
+
+    start_next(s, now_ms);
+    return true;
+}
+
+bool at_sched_submit(at_sched_t *s, const char *cmd, uint32_t timeout_ms,
+                     at_cmd_line_fn_t on_line, at_cmd_done_fn_t on_done, void *ctx,
+                     int64_t now_ms) {
+    return insert(s, s->count, cmd, timeout_ms, on_line, on_done, ctx, now_ms);
+}
+
+bool at_sched_submit_front(at_sched_t *s, const char *cmd, uint32_t timeout_ms,
+                           at_cmd_line_fn_t on_line, at_cmd_done_fn_t on_done, void *ctx,
+                           int64_t now_ms) {
+    // The in-flight command stays where it is: it is already on the wire
+    return insert(s, s->busy ? 1 : 0, cmd, timeout_ms, on_line, on_done, ctx, now_ms);
+}
+
+static bool line_is(const char *line, size_t len, const char *word) {
+    size_t n = strlen(word);
+    return len == n && memcmp(line, word, n) == 0;
+}
+
+static bool is_final(const char *line, size_t len) {
+    return line_is(line, len, "OK") || line_is(line, len, "ERROR") ||
+           (len >= 11 && memcmp(line, "+CMS ERROR:", 11) == 0);
+}
+
+bool at_sched_on_line(at_sched_t *s, const char *line, size_t len, int64_t now_ms) {
+    if (s->resync) {
+        // Leftovers of the abandoned command, or the sentinel's answer
+        s->last_rx_ms = now_ms;
+        if (s->sentinel_sent && is_final(line, len)) s->sentinel_ok = true;
+        return true;
+    }
+    if (!s->busy) return false;
+
+    if (line_is(line, len, "OK")) {
+        complete(s, AT_RESULT_OK, -1, now_ms, false);
+    } else if (line_is(line, len, "ERROR")) {
+        complete(s, AT_RESULT_ERROR, -1, now_ms, false);
+    } else if (len >= 11 && memcmp(line, "+CMS ERROR:", 11) == 0) {
+        complete(s, AT_RESULT_CMS_ERROR, atoi(line + 11), now_ms, false);
+    } else {
+        const at_cmd_t *c = &s->queue[s->head];
+        if (c->on_line) c->on_line(line, len, c->ctx);
+    }
+    return true;
+}
+
+/**
+ * @brief Quiet line, then a plain AT whose answer is known to be ours,
+ *        then quiet again before the queue moves on
+ *
+ * The second quiet period covers a late result of the abandoned command
+ * turning up just ahead of the sentinel's own OK: whichever of the two is
+ * taken for the sentinel, the other is swallowed here too.
+ */
+static void poll_resync(at_sched_t *s, int64_t now_ms) {
+    if (now_ms - s->last_rx_ms < AT_SCHED_QUIET_MS) return;
+
+    if (!s->sentinel_sent) {
+        s->sentinel_sent = true;
+        s->sentinel_ok = false;
+        s->deadline_ms = now_ms + AT_SCHED_SENTINEL_TIMEOUT_MS;
+        s->write("AT", s->write_ctx);
+    } else if (s->sentinel_ok) {
+        s->resync = false;
+        start_next(s, now_ms);
+    } else if (now_ms >= s->deadline_ms) {
+        s->sentinel_sent = false;       // Unanswered: try again
+    }
+}
+
+void at_sched_poll(at_sched_t *s, int64_t now_ms) {
+    if (s->busy && now_ms >= s->deadline_ms) {
+        s->timeouts++;
+        complete(s, AT_RESULT_TIMEOUT, -1, now_ms, true);
+    }
+    if (s->resync) poll_resync(s, now_ms);
+}
+
+bool at_sched_cancel(at_sched_t *s, int64_t now_ms) {
+    if (!s->busy) return false;
+    s->cancelled++;
+    complete(s, AT_RESULT_CANCELLED, -1, now_ms, true);
+    return true;
+}
+
+const char *at_sched_current(const at_sched_t *s) {
+    return s->busy ? s->queue[s->head].cmd : NULL;
+}
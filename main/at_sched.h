@@ -0,0 +1,143 @@
+/**
+ * @file at_sched.h
+ * @brief AT command queue with response correlation and timeouts
+ *
+ * Commands are written one at a time; the next one goes out in the same
+ * call that sees the previous one's final result code (OK, ERROR or
+ * +CMS ERROR), so back-to-back commands cost one modem round trip each and
+ * no fixed delays. Every non-URC line that arrives while a command is on
+ * the wire is handed to that command's line callback.
+ *
+ * A command that times out or is cancelled leaves the modem's answer
+ * unaccounted for: it may still arrive and would then complete whatever
+ * was written next. So after a timeout or a cancel the queue is held and a
+ * plain "AT" sentinel is sent once the line has been quiet for
+ * AT_SCHED_QUIET_MS. Nothing is dequeued until the sentinel's OK has
+ * arrived and the line has been quiet for AT_SCHED_QUIET_MS again;
+ * everything received meanwhile is discarded.
+ *
+ * Pure C with no ESP-IDF dependencies (time is passed in); host tested.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AT_SCHED_QUEUE_LEN          16
+#define AT_SCHED_CMD_MAX            64
+#define AT_SCHED_DEFAULT_TIMEOUT_MS 5000
+#define AT_SCHED_QUIET_MS           200     // Silence that ends a resync phase
+#define AT_SCHED_SENTINEL_TIMEOUT_MS 1000
+
+typedef enum {
+    AT_RESULT_OK = 0,
+    AT_RESULT_ERROR,            // Plain ERROR
+    AT_RESULT_CMS_ERROR,        // +CMS ERROR: <code> (code passed to on_done)
+    AT_RESULT_TIMEOUT,          // No final result code within the timeout
+    AT_RESULT_CANCELLED,        // Dropped before it completed
+} at_result_t;
+
+/** Intermediate response line (terminator stripped, NUL-terminated) */
+typedef void (*at_cmd_line_fn_t)(const char *line, size_t len, void *ctx);
+
+/** Final outcome; @p cms_error is the +CMS ERROR code, else -1 */
+typedef void (*at_cmd_done_fn_t)(at_result_t result, int cms_error, void *ctx);
+
+/** Put one command on the wire (the writer appends the terminator) */
+typedef void (*at_write_fn_t)(const char *cmd, void *ctx);
+
+typedef struct {
+    char cmd[AT_SCHED_CMD_MAX];
+    uint32_t timeout_ms;
+    at_cmd_line_fn_t on_line;
+    at_cmd_done_fn_t on_done;
+    void *ctx;
+} at_cmd_t;
+
+typedef struct {
+    at_cmd_t queue[AT_SCHED_QUEUE_LEN];
+    uint8_t head;                       // queue[head] is the oldest command
+    uint8_t count;
+    bool busy;                          // queue[head] has been written
+    int64_t deadline_ms;
+    at_write_fn_t write;
+    void *write_ctx;
+    uint32_t timeouts;                  // Commands that never got a final result
+    uint32_t cancelled;                 // Commands dropped by at_sched_cancel()
+    bool resync;                        // Queue held until the modem is back in step
+    bool sentinel_sent;
+    bool sentinel_ok;                   // Sentinel answered; waiting for quiet
+    int64_t last_rx_ms;                 // Last line seen while resyncing
+    uint32_t resyncs;
+} at_sched_t;
+
+void at_sched_init(at_sched_t *s, at_write_fn_t write, void *ctx);
+
+/**
+ * @brief Queue a command; it is written at once if nothing is in flight
+ *
+ * @param cmd           Command text without terminator (copied)
+ * @param timeout_ms    0 selects AT_SCHED_DEFAULT_TIMEOUT_MS
+ * @param on_line       Intermediate lines (may be NULL)
+ * @param on_done       Final result (may be NULL)
+ * @return false if the queue is full or @p cmd is too long
+ */
+bool at_sched_submit(at_sched_t *s, const char *cmd, uint32_t timeout_ms,
+                     at_cmd_line_fn_t on_line, at_cmd_done_fn_t on_done, void *ctx,
+                     int64_t now_ms);
+
+/**
+ * @brief Like at_sched_submit(), but ahead of everything still queued
+ *
+ * For replies the modem only accepts within a short window (+CMT
+ * acknowledgements): the command goes out as soon as the in-flight one, if
+ * any, completes.
+ */
+bool at_sched_submit_front(at_sched_t *s, const char *cmd, uint32_t timeout_ms,
+                           at_cmd_line_fn_t on_line, at_cmd_done_fn_t on_done, void *ctx,
+                           int64_t now_ms);
+
+/**
+ * @brief Route one response line (everything the URC table did not claim)
+ *
+ * Completes the in-flight command on a final result code and writes the
+ * next queued one; other lines go to the command's line callback. Lines
+ * with nothing in flight are ignored. While resyncing every line is
+ * consumed and dropped.
+ *
+ * @return true if the line belonged to a command
+ */
+bool at_sched_on_line(at_sched_t *s, const char *line, size_t len, int64_t now_ms);
+
+/**
+ * @brief Time out the in-flight command if its deadline has passed, and
+ *        drive the resync that follows (call at least every
+ *        AT_SCHED_QUIET_MS / 2)
+ */
+void at_sched_poll(at_sched_t *s, int64_t now_ms);
+
+/**
+ * @brief Finish the in-flight command with AT_RESULT_CANCELLED
+ *
+ * For when its response may have been lost (receive overflow) and waiting
+ * for the timeout would only stall the queue. The next command is held
+ * for the sentinel resync, like after a timeout.
+ *
+ * @return false if nothing was in flight
+ */
+bool at_sched_cancel(at_sched_t *s, int64_t now_ms);
+
+/**
+ * @brief Text of the in-flight command, or NULL
+ */
+const char *at_sched_current(const at_sched_t *s);
+
+static inline bool at_sched_idle(const at_sched_t *s) {
+    return s->count == 0 && !s->resync;
+}
+
+static inline size_t at_sched_free(const at_sched_t *s) {
+    return AT_SCHED_QUEUE_LEN - s->count;
+}
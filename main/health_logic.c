@@ -3,6 +3,7 @@
  * @brief Pure decision logic for the software watchdog (see header).
  */
 #include "health_logic.h"
+#include <stdarg.h>
 #include <stdio.h>
 
 health_verdict_t health_evaluate(const health_snapshot_t *s)
@@ -35,20 +36,49 @@ health_verdict_t health_evaluate(const health_snapshot_t *s)
     return HEALTH_OK;
 }
 
+/* snprintf at buf + *n; false on truncation */
+static bool append(char *buf, size_t buf_size, int *n, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int m = vsnprintf(buf + *n, buf_size - (size_t)*n, fmt, ap);
+    va_end(ap);
+    if (m < 0 || (size_t)(*n + m) >= buf_size) return false;
+    *n += m;
+    return true;
+}
+
 int format_heartbeat_json(char *buf, size_t buf_size, const heartbeat_info_t *hb)
 {
     if (!buf || buf_size == 0 || !hb) return -1;
 
     int n = snprintf(buf, buf_size,
         "{\"device\":\"%s\",\"boot_id\":%u,\"reset_reason\":\"%s\","
-        "\"uptime_s\":%u,\"free_heap\":%u,\"mqtt\":%s}",
+        "\"uptime_s\":%u,\"free_heap\":%u,\"mqtt\":%s",
         hb->device ? hb->device : "",
         (unsigned)hb->boot_id,
         hb->reset_reason ? hb->reset_reason : "",
         (unsigned)hb->uptime_s,
         (unsigned)hb->free_heap,
         hb->mqtt_connected ? "true" : "false");
-
     if (n < 0 || (size_t)n >= buf_size) return -1; /* truncated */
+
+    /* Only when something happened: the usual heartbeat stays unchanged */
+    if (hb->uart_overflows &&
+        !append(buf, buf_size, &n, ",\"uart_overflows\":%u", (unsigned)hb->uart_overflows)) {
+        return -1;
+    }
+    if (hb->sms_blocks > 0 && (hb->sms_blocks_free_min < hb->sms_blocks || hb->sms_evictions) &&
+        !append(buf, buf_size, &n, ",\"sms_pool\":{\"blocks\":%u,\"free_min\":%u,\"evictions\":%u}",
+                (unsigned)hb->sms_blocks, (unsigned)hb->sms_blocks_free_min,
+                (unsigned)hb->sms_evictions)) {
+        return -1;
+    }
+    if (hb->sim_total > 0 &&
+        !append(buf, buf_size, &n, ",\"sim_storage\":{\"used\":%u,\"total\":%u}",
+                (unsigned)hb->sim_used, (unsigned)hb->sim_total)) {
+        return -1;
+    }
+    if (!append(buf, buf_size, &n, "}")) return -1; /* truncated */
     return n;
 }
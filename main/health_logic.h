@@ -44,6 +44,14 @@ typedef struct {
     uint32_t    uptime_s;      /* seconds since boot */
     uint32_t    free_heap;     /* bytes free heap */
     bool        mqtt_connected;
+    uint32_t    uart_overflows; /* SIM UART receive overflows; field omitted while 0 */
+    /* Long-SMS assembly pool; "sms_pool" omitted until a long SMS used it */
+    uint16_t    sms_blocks;          /* pool size (0: not reported) */
+    uint16_t    sms_blocks_free_min; /* fewest free blocks since boot */
+    uint32_t    sms_evictions;       /* messages published early to make room */
+    /* SIM message storage from AT+CPMS; "sim_storage" omitted while total is 0 */
+    uint16_t    sim_used;
+    uint16_t    sim_total;
 } heartbeat_info_t;
 
 /**
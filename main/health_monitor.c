@@ -19,6 +19,7 @@
 #include "mqtt_client.h"
 
 #include "app_common.h"
+#include "sim_modem.h"
 #include "config.h"
 
 static const char *TAG = "HEALTH";
@@ -109,6 +110,11 @@ static void publish_heartbeat(int64_t t, bool mqtt_up)
 {
     if (!mqtt_client || !mqtt_up) return;
 
+    sim_modem_rx_stats_t rx;
+    sim_modem_get_rx_stats(&rx);
+    int sim_used = 0, sim_total = 0;    /* stays 0 (omitted) until AT+CPMS answered */
+    sim_modem_get_storage(&sim_used, &sim_total);
+
     heartbeat_info_t hb = {
         .device         = s_device_id,
         .reset_reason   = s_reset_reason,
@@ -116,9 +122,15 @@ static void publish_heartbeat(int64_t t, bool mqtt_up)
         .uptime_s       = (uint32_t)(t / 1000),
         .free_heap      = (uint32_t)esp_get_free_heap_size(),
         .mqtt_connected = mqtt_up,
+        .uart_overflows = rx.fifo_overflows + rx.buffer_full,
+        .sms_blocks          = rx.assembly_blocks,
+        .sms_blocks_free_min = rx.assembly_blocks_free_min,
+        .sms_evictions       = rx.assembly_evictions,
+        .sim_used            = (uint16_t)sim_used,
+        .sim_total           = (uint16_t)sim_total,
     };
 
-    char buf[192];
+    char buf[256];
     if (format_heartbeat_json(buf, sizeof(buf), &hb) > 0) {
         /* QoS 0, no retain: heartbeats are frequent and disposable; a retained
          * stale heartbeat would otherwise make a dead device look alive to a
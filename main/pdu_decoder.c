@@ -4,356 +4,620 @@
  */
 
 #include <string.h>
-#include <stdlib.h>
 #include "pdu_decoder.h"
+#include "pdu_hex.h"
+#include "sms_codec.h"
 #include "esp_log.h"
 
 static const char *TAG = "PDU_DECODER";
 
 // --- Helper Functions ---
 
-/**
- * @brief Convert hex character to nibble value
- */
-static int hex_to_nibble(char c) {
-    if (c >= '0' && c <= '9') return c - '0';
-    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
-    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
-    return -1;
-}
-
-/**
- * @brief Convert two hex characters to byte
- */
-static int hex_to_byte(const char *hex) {
-    int hi = hex_to_nibble(hex[0]);
-    int lo = hex_to_nibble(hex[1]);
-    if (hi < 0 || lo < 0) return -1;
-    return (hi << 4) | lo;
-}
-
 /**
  * @brief Decode semi-octet encoded phone number (swapped nibbles)
- * @param hex       Input hex string
+ * @param bytes      Input octets
  * @param num_digits Number of digits to decode
- * @param out       Output buffer
- * @param out_size  Output buffer size
+ * @param out        Output buffer
+ * @param out_size   Output buffer size
+ * @return Number of characters written
  */
-static void decode_phone_number(const char *hex, int num_digits, char *out, size_t out_size) {
+static size_t decode_phone_number(const uint8_t *bytes, int num_digits, char *out, size_t out_size) {
+    static const char digits[] = "0123456789ABCDEF";
     size_t j = 0;
     for (int i = 0; i < num_digits && j < out_size - 1; i++) {
-        // Semi-octet: nibbles are swapped
-        // hex[0] hex[1] -> digit 2, digit 1
-        int hex_idx = (i / 2) * 2;
-        char c;
-        if (i % 2 == 0) {
-            c = hex[hex_idx + 1]; // Low nibble first
-        } else {
-            c = hex[hex_idx];     // High nibble second
-        }
-        if (c == 'F' || c == 'f') break; // Padding
-        out[j++] = c;
+        // Semi-octet: low nibble is the first digit, high nibble the second
+        uint8_t b = bytes[i / 2];
+        uint8_t nibble = (i % 2 == 0) ? (b & 0x0F) : (b >> 4);
+        if (nibble == 0x0F) break; // Padding
+        out[j++] = digits[nibble];
     }
     out[j] = '\0';
+    return j;
 }
 
 /**
  * @brief Decode GSM 7-bit packed data to UTF-8
- * @param hex           Input hex string (packed 7-bit data)
+ * @param bytes         Input octets (packed 7-bit data)
+ * @param byte_count    Number of octets available in @p bytes
  * @param num_septets   Number of septets (characters)
- * @param udh_bits      Number of bits used by UDH (for alignment)
+ * @param bit_offset    Fill bits between the UDH and the first septet
+ * @param nl_locking    National language locking shift ID (0 = default)
+ * @param nl_single     National language single shift ID (0 = default)
  * @param out           Output buffer
  * @param out_size      Output buffer size
+ * @return Number of bytes written
  */
-static void decode_gsm7bit(const char *hex, int num_septets, int udh_bits, char *out, size_t out_size) {
-    // GSM 7-bit default alphabet (basic ASCII subset)
-    static const char gsm7bit_basic[] = 
-        "@£$¥èéùìòÇ\nØø\rÅåΔ_ΦΓΛΩΠΨΣΘΞ\x1bÆæßÉ !\"#¤%&'()*+,-./0123456789:;<=>?"
-        "¡ABCDEFGHIJKLMNOPQRSTUVWXYZÄÖÑÜ§¿abcdefghijklmnopqrstuvwxyzäöñüà";
-    
-    // Convert hex to bytes
-    size_t hex_len = strlen(hex);
-    size_t byte_count = hex_len / 2;
-    uint8_t *bytes = malloc(byte_count);
-    if (!bytes) return;
-    
-    for (size_t i = 0; i < byte_count; i++) {
-        int b = hex_to_byte(hex + i * 2);
-        bytes[i] = (b >= 0) ? b : 0;
+static size_t decode_gsm7bit(const uint8_t *bytes, size_t byte_count, int num_septets, int bit_offset,
+                             uint8_t nl_locking, uint8_t nl_single, char *out, size_t out_size) {
+    if (num_septets <= 0) {
+        out[0] = '\0';
+        return 0;
     }
-    
-    // Skip UDH fill bits
-    int bit_offset = udh_bits % 7;
-    if (bit_offset > 0) bit_offset = 7 - bit_offset;
-    
-    size_t out_idx = 0;
-    int bit_pos = bit_offset;
-    
-    for (int sept = 0; sept < num_septets && out_idx < out_size - 1; sept++) {
-        int byte_idx = bit_pos / 8;
-        int bit_in_byte = bit_pos % 8;
-        
-        uint8_t septet;
-        if (bit_in_byte <= 1) {
-            // Septet fits in one byte
-            septet = (bytes[byte_idx] >> bit_in_byte) & 0x7F;
-        } else {
-            // Septet spans two bytes
-            septet = (bytes[byte_idx] >> bit_in_byte);
-            if ((size_t)(byte_idx + 1) < byte_count) {
-                septet |= (bytes[byte_idx + 1] << (8 - bit_in_byte));
-            }
-            septet &= 0x7F;
-        }
-        
-        // Map to character (simplified - ASCII range only for now)
-        if (septet < 128) {
-            // Basic ASCII mapping for common characters
-            if (septet >= 32 && septet < 127) {
-                out[out_idx++] = (char)septet;
-            } else if (septet == 0x0A) {
-                out[out_idx++] = '\n';
-            } else if (septet == 0x0D) {
-                out[out_idx++] = '\r';
-            } else {
-                out[out_idx++] = '?';
-            }
-        }
-        
-        bit_pos += 7;
-    }
-    
-    out[out_idx] = '\0';
-    free(bytes);
+    if (num_septets > GSM7_MAX_SEPTETS) num_septets = GSM7_MAX_SEPTETS;
+
+    uint8_t septets[GSM7_MAX_SEPTETS];
+    size_t count = gsm7_unpack(bytes, byte_count, (unsigned)bit_offset, septets, (size_t)num_septets);
+
+    return gsm7_to_utf8_lang(septets, count, nl_locking, nl_single, out, out_size);
 }
 
+// --- Main Decode Functions ---
+
 /**
- * @brief Decode UCS2 (UTF-16BE) hex to UTF-8
- *
- * Handles UTF-16 surrogate pairs: characters above U+FFFF (e.g. emoji) arrive
- * as a high surrogate (0xD800-0xDBFF) followed by a low surrogate
- * (0xDC00-0xDFFF) and must be combined into one code point, then encoded as
- * 4-byte UTF-8. Emitting each surrogate half on its own produces INVALID UTF-8
- * (0xED 0xA0..), which downstream consumers reject -- dropping the whole SMS.
- * An unpaired surrogate is replaced with U+FFFD rather than emitted raw.
+ * @brief Convert @p len PDU hex characters (need not be NUL-terminated)
+ * @param pdu   Output, PDU_MAX_OCTETS bytes
+ * @return Number of octets, or 0 if the text is not a plausible PDU
  */
-static void decode_ucs2(const char *hex, int num_octets, int udh_octets, char *out, size_t out_size) {
-    const char *data_start = hex + (udh_octets * 2);
-    int data_hexlen = (num_octets - udh_octets) * 2;
+static size_t hex_span_to_octets(const char *pdu_hex, size_t len, uint8_t *pdu) {
+    if (len < 20) {
+        ESP_LOGW(TAG, "PDU too short: %d chars", (int)len);
+        return 0;
+    }
+    if (len > PDU_MAX_OCTETS * 2) {
+        ESP_LOGW(TAG, "PDU too long: %d chars", (int)len);
+        return 0;
+    }
 
-    size_t j = 0;
-    int i = 0;
-    while (i + 3 < data_hexlen && j + 4 < out_size) {
-        int b1 = hex_to_byte(data_start + i);
-        int b2 = hex_to_byte(data_start + i + 2);
-        i += 4;
-        if (b1 < 0 || b2 < 0) continue;
-
-        uint32_t wc = (uint32_t)((b1 << 8) | b2);
-
-        // High surrogate: try to pair with the following low surrogate.
-        if (wc >= 0xD800 && wc <= 0xDBFF && i + 3 < data_hexlen) {
-            int b3 = hex_to_byte(data_start + i);
-            int b4 = hex_to_byte(data_start + i + 2);
-            if (b3 >= 0 && b4 >= 0) {
-                uint32_t lo = (uint32_t)((b3 << 8) | b4);
-                if (lo >= 0xDC00 && lo <= 0xDFFF) {
-                    wc = 0x10000u + ((wc - 0xD800u) << 10) + (lo - 0xDC00u);
-                    i += 4; // consume the low surrogate too
-                }
-            }
-        }
+    // Convert the whole PDU once; every field below reads plain octets.
+    size_t bad_pos = 0;
+    if (!pdu_hex_decode(pdu_hex, len, pdu, &bad_pos)) {
+        ESP_LOGW(TAG, "Invalid hex in PDU at char %d", (int)bad_pos);
+        return 0;
+    }
+    return len / 2;
+}
 
-        // Any leftover (unpaired) surrogate is not a valid scalar value.
-        if (wc >= 0xD800 && wc <= 0xDFFF) {
-            wc = 0xFFFD;
-        }
+bool pdu_decode(const char *pdu_hex, pdu_sms_t *out) {
+    if (!pdu_hex || !out) return false;
 
-        if (wc < 0x80) {
-            out[j++] = (char)wc;
-        } else if (wc < 0x800) {
-            out[j++] = 0xC0 | (wc >> 6);
-            out[j++] = 0x80 | (wc & 0x3F);
-        } else if (wc < 0x10000) {
-            out[j++] = 0xE0 | (wc >> 12);
-            out[j++] = 0x80 | ((wc >> 6) & 0x3F);
-            out[j++] = 0x80 | (wc & 0x3F);
-        } else {
-            out[j++] = 0xF0 | (wc >> 18);
-            out[j++] = 0x80 | ((wc >> 12) & 0x3F);
-            out[j++] = 0x80 | ((wc >> 6) & 0x3F);
-            out[j++] = 0x80 | (wc & 0x3F);
+    memset(out, 0, sizeof(pdu_sms_t));
+
+    uint8_t pdu[PDU_MAX_OCTETS];
+    size_t pdu_len = hex_span_to_octets(pdu_hex, strlen(pdu_hex), pdu);
+    if (pdu_len == 0) return false;
+
+    return pdu_decode_bytes(pdu, pdu_len, out);
+}
+
+bool pdu_decode_bytes(const uint8_t *pdu, size_t len, pdu_sms_t *out) {
+    if (!out) return false;
+
+    memset(out, 0, sizeof(pdu_sms_t));
+
+    pdu_sms_view_t view;
+    if (!pdu_view_parse(pdu, len, &view)) return false;
+
+    pdu_view_sender(&view, out->sender, sizeof(out->sender));
+    pdu_view_text(&view, out->message, sizeof(out->message));
+    out->is_multipart = view.is_multipart;
+    out->ref_num = view.ref_num;
+    out->total_parts = view.total_parts;
+    out->part_num = view.part_num;
+
+    ESP_LOGI(TAG, "Decoded: from=%s, msg=%s", out->sender, out->message);
+    return true;
+}
+
+// --- Lazy view ---
+
+/**
+ * @brief Fill the view fields derived from one UDH IE
+ */
+static void udh_apply_ie(pdu_sms_view_t *view, uint8_t iei, uint8_t iel, const uint8_t *ie) {
+    switch (iei) {
+    case PDU_IEI_CONCAT_8:
+        // Concatenated SMS, 8-bit reference
+        if (iel == 3 && ie[1] > 0 && ie[2] > 0) {
+            view->is_multipart = true;
+            view->ref_num = ie[0];
+            view->total_parts = ie[1];
+            view->part_num = ie[2];
+            ESP_LOGI(TAG, "Multipart SMS: ref=%d, part %d/%d", ie[0], ie[2], ie[1]);
         }
+        break;
+    case PDU_IEI_CONCAT_16:
+        // Concatenated SMS, 16-bit reference
+        if (iel == 4 && ie[2] > 0 && ie[3] > 0) {
+            view->is_multipart = true;
+            view->ref_num = (uint16_t)((ie[0] << 8) | ie[1]);
+            view->total_parts = ie[2];
+            view->part_num = ie[3];
+            ESP_LOGI(TAG, "Multipart SMS (16-bit): ref=%d, part %d/%d",
+                     view->ref_num, ie[3], ie[2]);
+        }
+        break;
+    case PDU_IEI_PORTS_8:
+        if (iel == 2) {
+            view->has_ports = true;
+            view->dst_port = ie[0];
+            view->src_port = ie[1];
+        }
+        break;
+    case PDU_IEI_PORTS_16:
+        if (iel == 4) {
+            view->has_ports = true;
+            view->dst_port = (uint16_t)((ie[0] << 8) | ie[1]);
+            view->src_port = (uint16_t)((ie[2] << 8) | ie[3]);
+        }
+        break;
+    case PDU_IEI_NL_LOCKING:
+        if (iel == 1) view->nl_locking = ie[0];
+        break;
+    case PDU_IEI_NL_SINGLE:
+        if (iel == 1) view->nl_single = ie[0];
+        break;
+    default:
+        // Special SMS indication (0x01) and the rest are only indexed
+        break;
     }
-    out[j] = '\0';
 }
 
-// --- Main Decode Function ---
 
-bool pdu_decode(const char *pdu_hex, pdu_sms_t *out) {
-    if (!pdu_hex || !out) return false;
-    
-    memset(out, 0, sizeof(pdu_sms_t));
-    
-    size_t len = strlen(pdu_hex);
-    if (len < 20) {
-        ESP_LOGW(TAG, "PDU too short: %d chars", (int)len);
+bool pdu_view_parse(const uint8_t *pdu, size_t len, pdu_sms_view_t *view) {
+    if (!pdu || !view) return false;
+
+    memset(view, 0, sizeof(pdu_sms_view_t));
+
+    if (len < 10) {
+        ESP_LOGW(TAG, "PDU too short: %d octets", (int)len);
         return false;
     }
-    
-    int pos = 0;
-    
+    if (len > UINT16_MAX) return false;
+
+    size_t pos = 0;
+
     // 1. SMSC Length (skip SMSC info)
-    int smsc_len = hex_to_byte(pdu_hex + pos);
-    if (smsc_len < 0) return false;
-    pos += 2 + (smsc_len * 2); // Skip SMSC length + SMSC data
-    
-    if ((size_t)pos >= len) return false;
-    
+    pos += 1 + pdu[0]; // Skip SMSC length + SMSC data
+
+    if (pos >= len) return false;
+
     // 2. PDU Type (first octet)
-    int pdu_type = hex_to_byte(pdu_hex + pos);
-    if (pdu_type < 0) return false;
-    pos += 2;
-    
+    uint8_t pdu_type = pdu[pos++];
+
     // Check TP-MTI (bits 0-1): should be 00 for SMS-DELIVER
     if ((pdu_type & 0x03) != 0x00) {
         ESP_LOGW(TAG, "Not SMS-DELIVER: type=0x%02X", pdu_type);
         return false;
     }
-    
+
     // Check TP-UDHI (bit 6): User Data Header present?
     bool has_udh = (pdu_type & 0x40) != 0;
-    
-    // 3. Originating Address (Sender)
-    if ((size_t)pos + 2 > len) return false;
-    int oa_len = hex_to_byte(pdu_hex + pos); // Number of digits
-    pos += 2;
-    
-    if ((size_t)pos + 2 > len) return false;
-    int oa_type = hex_to_byte(pdu_hex + pos);
-    pos += 2;
-    
+
+    // 3. Originating Address (Sender): only located here, decoded on demand
+    if (pos + 2 > len) return false;
+    view->oa_len = pdu[pos++];      // Number of digits
+    view->oa_type = pdu[pos++];
+
     // Calculate octets for address (round up)
-    int oa_octets = (oa_len + 1) / 2;
-    if ((size_t)pos + oa_octets * 2 > len) return false;
-    
+    size_t oa_octets = ((size_t)view->oa_len + 1) / 2;
+    if (pos + oa_octets > len) return false;
+    view->oa_pos = (uint16_t)pos;
+    pos += oa_octets;
+
+    // 4. Protocol Identifier
+    if (pos + 1 > len) return false;
+    view->pid = pdu[pos++];
+
+    // 5. Data Coding Scheme
+    if (pos + 1 > len) return false;
+    view->dcs = pdu[pos++];
+
+    // 6. Timestamp (7 octets)
+    view->scts_pos = (uint16_t)pos;
+    pos += 7;
+
+    // 7. User Data Length
+    if (pos + 1 > len) return false;
+    view->udl = pdu[pos++];
+
+    // User Data starts here
+    const uint8_t *ud = pdu + pos;
+    size_t ud_len = len - pos;
+    size_t udh_octets = 0;
+
+    // 8. Index the UDH if present (concatenation info is the assembly key, so
+    //    it is read now; the text itself is left for pdu_view_text())
+    if (has_udh) {
+        if (ud_len < 1) return false;
+
+        udh_octets = 1 + (size_t)ud[0]; // UDHL + UDH content
+        if (udh_octets > ud_len) return false;
+
+        // Index every Information Element, then read the ones we act on
+        size_t ie_pos = 1; // After UDHL
+        while (ie_pos + 2 <= udh_octets) {
+            uint8_t iei = ud[ie_pos++];
+            uint8_t iel = ud[ie_pos++];
+            if (ie_pos + iel > udh_octets) break;
+
+            if (view->udh.count < PDU_UDH_MAX_IES) {
+                pdu_udh_ie_t *entry = &view->udh.ie[view->udh.count++];
+                entry->iei = iei;
+                entry->len = iel;
+                entry->offset = (uint16_t)(pos + ie_pos);
+            } else {
+                view->udh.dropped++;
+            }
+            udh_apply_ie(view, iei, iel, ud + ie_pos);
+
+            ie_pos += iel;
+        }
+    }
+
+    view->pdu = pdu;
+    view->ud_pos = (uint16_t)pos;
+    view->ud_len = (uint16_t)ud_len;
+    view->udh_len = (uint16_t)udh_octets;
+    return true;
+}
+
+size_t pdu_view_sender(const pdu_sms_view_t *view, char *out, size_t out_size) {
+    if (out_size == 0) return 0;
+
+    const uint8_t *oa = view->pdu + view->oa_pos;
+    size_t oa_octets = ((size_t)view->oa_len + 1) / 2;
+
     // Extract Type of Number (bits 6-4 of ToA byte)
-    int ton = (oa_type >> 4) & 0x07;
-    
+    int ton = (view->oa_type >> 4) & 0x07;
+
     if (ton == 0x05) {
         // Alphanumeric sender (GSM 7-bit packed in address field)
         // oa_len = number of usable semi-octets (nibbles), not digit count
         // Each nibble is 4 bits, so total bits = oa_len * 4
         // Number of GSM 7-bit septets = total_bits / 7
-        int num_septets = (oa_len * 4) / 7;
-        decode_gsm7bit(pdu_hex + pos, num_septets, 0, out->sender, sizeof(out->sender));
-    } else if (ton == 0x01) {
-        // International number: prepend '+'
-        out->sender[0] = '+';
-        decode_phone_number(pdu_hex + pos, oa_len, out->sender + 1,
-                            sizeof(out->sender) - 1);
-    } else {
-        // National (0x02), Unknown (0x00), and others: BCD without prefix
-        decode_phone_number(pdu_hex + pos, oa_len, out->sender,
-                            sizeof(out->sender));
+        int num_septets = (view->oa_len * 4) / 7;
+        return decode_gsm7bit(oa, oa_octets, num_septets, 0, GSM7_LANG_DEFAULT, GSM7_LANG_DEFAULT,
+                              out, out_size);
     }
-    pos += oa_octets * 2;
-    
-    // 4. Protocol Identifier (skip)
-    pos += 2;
-    
-    // 5. Data Coding Scheme
-    if ((size_t)pos + 2 > len) return false;
-    int dcs = hex_to_byte(pdu_hex + pos);
-    if (dcs < 0) return false;
-    pos += 2;
-    
-    // 6. Timestamp (7 octets, skip)
-    pos += 14;
-    
-    // 7. User Data Length
-    if ((size_t)pos + 2 > len) return false;
-    int udl = hex_to_byte(pdu_hex + pos);
-    if (udl < 0) return false;
-    pos += 2;
-    
-    // User Data starts here
-    const char *ud_hex = pdu_hex + pos;
-    int udh_octets = 0;
-    
-    // 8. Parse UDH if present
-    if (has_udh) {
-        int udhl = hex_to_byte(ud_hex);
-        if (udhl < 0) return false;
-        
-        udh_octets = 1 + udhl; // UDHL + UDH content
-        
-        // Parse UDH Information Elements
-        int ie_pos = 2; // After UDHL
-        while (ie_pos < udh_octets * 2) {
-            int iei = hex_to_byte(ud_hex + ie_pos);
-            if (iei < 0) break;
-            ie_pos += 2;
-            
-            int iel = hex_to_byte(ud_hex + ie_pos);
-            if (iel < 0) break;
-            ie_pos += 2;
-            
-            if (iei == 0x00 && iel == 3) {
-                // Concatenated SMS, 8-bit reference
-                int ref = hex_to_byte(ud_hex + ie_pos);
-                int total = hex_to_byte(ud_hex + ie_pos + 2);
-                int part = hex_to_byte(ud_hex + ie_pos + 4);
-                
-                if (ref >= 0 && total > 0 && part > 0) {
-                    out->is_multipart = true;
-                    out->ref_num = (uint16_t)ref;
-                    out->total_parts = (uint8_t)total;
-                    out->part_num = (uint8_t)part;
-                    ESP_LOGI(TAG, "Multipart SMS: ref=%d, part %d/%d", ref, part, total);
-                }
-            } else if (iei == 0x08 && iel == 4) {
-                // Concatenated SMS, 16-bit reference
-                int ref_hi = hex_to_byte(ud_hex + ie_pos);
-                int ref_lo = hex_to_byte(ud_hex + ie_pos + 2);
-                int total = hex_to_byte(ud_hex + ie_pos + 4);
-                int part = hex_to_byte(ud_hex + ie_pos + 6);
-                
-                if (ref_hi >= 0 && ref_lo >= 0 && total > 0 && part > 0) {
-                    out->is_multipart = true;
-                    out->ref_num = (uint16_t)((ref_hi << 8) | ref_lo);
-                    out->total_parts = (uint8_t)total;
-                    out->part_num = (uint8_t)part;
-                    ESP_LOGI(TAG, "Multipart SMS (16-bit): ref=%d, part %d/%d", 
-                             out->ref_num, part, total);
-                }
-            }
-            
-            ie_pos += iel * 2;
-        }
+    if (ton == 0x01 && out_size > 1) {
+        // International number: prepend '+'
+        out[0] = '+';
+        return 1 + decode_phone_number(oa, view->oa_len, out + 1, out_size - 1);
     }
-    
-    // 9. Decode message content based on DCS
+    // National (0x02), Unknown (0x00), and others: BCD without prefix
+    return decode_phone_number(oa, view->oa_len, out, out_size);
+}
+
+void pdu_view_payload(const pdu_sms_view_t *view, pdu_payload_t *out) {
     // DCS coding groups (simplified):
     // 0x00-0x03: GSM 7-bit
     // 0x04-0x07: 8-bit data
     // 0x08-0x0F: UCS2
-    
-    if ((dcs & 0x0C) == 0x08) {
-        // UCS2 encoding
-        // UDL is in octets for UCS2
-        decode_ucs2(ud_hex, udl, udh_octets, out->message, sizeof(out->message));
-    } else {
-        // GSM 7-bit encoding (default)
-        // UDL is in septets (characters)
-        int udh_bits = udh_octets * 8;
-        int septets_for_udh = has_udh ? ((udh_bits + 6) / 7) : 0;
-        int msg_septets = udl - septets_for_udh;
-        
-        decode_gsm7bit(ud_hex + (udh_octets * 2), msg_septets, udh_bits, 
-                       out->message, sizeof(out->message));
+    size_t udh_octets = view->udh_len;
+    size_t data_len = (size_t)view->ud_len - udh_octets;
+
+    out->data = view->pdu + view->ud_pos + udh_octets;
+    out->len = (uint16_t)data_len;
+    out->ucs2 = (view->dcs & 0x0C) == 0x08;
+    out->fill_bits = 0;
+
+    if (out->ucs2) {
+        // UDL is in octets for UCS2 (and includes the UDH)
+        size_t ucs2_len = ((size_t)view->udl > udh_octets) ? (size_t)view->udl - udh_octets : 0;
+        if (ucs2_len > data_len) ucs2_len = data_len;
+        out->units = (uint16_t)ucs2_len;
+        return;
     }
-    
-    ESP_LOGI(TAG, "Decoded: from=%s, msg=%s", out->sender, out->message);
+
+    // GSM 7-bit (default): UDL is in septets and the text starts on the
+    // first septet boundary after the UDH
+    int udh_bits = (int)udh_octets * 8;
+    int septets_for_udh = (udh_bits + 6) / 7;
+    int msg_septets = view->udl - septets_for_udh;
+
+    out->units = (uint16_t)(msg_septets > 0 ? msg_septets : 0);
+    out->fill_bits = (uint8_t)(septets_for_udh * 7 - udh_bits);
+}
+
+size_t pdu_view_text(const pdu_sms_view_t *view, char *out, size_t out_size) {
+    if (out_size == 0) return 0;
+
+    pdu_payload_t payload;
+    pdu_view_payload(view, &payload);
+
+    if (payload.ucs2) {
+        return ucs2_to_utf8(payload.data, payload.units, out, out_size);
+    }
+    return decode_gsm7bit(payload.data, payload.len, payload.units, payload.fill_bits,
+                          view->nl_locking, view->nl_single, out, out_size);
+}
+
+size_t pdu_view_text_bound(const pdu_sms_view_t *view) {
+    size_t udh_octets = view->udh_len;
+    size_t data_len = (size_t)view->ud_len - udh_octets;
+
+    if ((view->dcs & 0x0C) == 0x08) {
+        // Every UTF-16 unit -> at most 3 bytes (a surrogate pair -> 4 for 2),
+        // plus the 4-byte headroom ucs2_to_utf8() keeps and the terminator
+        size_t ucs2_len = ((size_t)view->udl > udh_octets) ? (size_t)view->udl - udh_octets : 0;
+        if (ucs2_len > data_len) ucs2_len = data_len;
+        return (ucs2_len / 2) * 3 + 5;
+    }
+
+    // Every septet -> at most 2 bytes (escape + 0x65 -> 3 for 2), plus the
+    // 3-byte headroom gsm7_to_utf8() keeps and the terminator. A locking
+    // shift table can map one septet to 3 bytes.
+    size_t septets = data_len * 8 / 7;
+    if (septets > view->udl) septets = view->udl;
+    if (septets > GSM7_MAX_SEPTETS) septets = GSM7_MAX_SEPTETS;
+    return septets * (view->nl_locking ? 3 : 2) + 4;
+}
+
+bool pdu_view_text_alloc(const pdu_sms_view_t *view, pdu_arena_t *arena, pdu_text_t *out) {
+    size_t avail = arena->size - arena->used;
+    out->ptr = "";
+    out->len = 0;
+
+    if (pdu_view_text_bound(view) > avail) {
+        ESP_LOGW(TAG, "Text arena full: %d of %d bytes used", (int)arena->used, (int)arena->size);
+        return false;
+    }
+
+    char *dst = arena->buf + arena->used;
+    out->len = pdu_view_text(view, dst, avail);
+    out->ptr = dst;
+    arena->used += out->len + 1;
     return true;
 }
+
+const pdu_udh_ie_t *pdu_view_find_ie(const pdu_sms_view_t *view, uint8_t iei) {
+    for (uint8_t i = 0; i < view->udh.count; i++) {
+        if (view->udh.ie[i].iei == iei) return &view->udh.ie[i];
+    }
+    return NULL;
+}
+
+static inline uint8_t swapped_bcd(uint8_t b) {
+    return (uint8_t)((b & 0x0F) * 10 + (b >> 4));
+}
+
+bool pdu_view_timestamp(const pdu_sms_view_t *view, pdu_timestamp_t *ts) {
+    if (!view->pdu || (size_t)view->scts_pos + 7 > (size_t)view->ud_pos) return false;
+
+    const uint8_t *scts = view->pdu + view->scts_pos;
+    ts->year = swapped_bcd(scts[0]);
+    ts->month = swapped_bcd(scts[1]);
+    ts->day = swapped_bcd(scts[2]);
+    ts->hour = swapped_bcd(scts[3]);
+    ts->minute = swapped_bcd(scts[4]);
+    ts->second = swapped_bcd(scts[5]);
+    // Time zone in quarter hours; bit 3 of the octet is the sign
+    int8_t tz = (int8_t)((scts[6] & 0x07) * 10 + (scts[6] >> 4));
+    ts->tz_quarters = (scts[6] & 0x08) ? (int8_t)-tz : tz;
+    return true;
+}
+
+// --- Incremental (streaming) decode ---
+
+enum {
+    STREAM_STEP_SMSC = 0,   // SMSC length octet
+    STREAM_STEP_TYPE,       // PDU type (TP-MTI / TP-UDHI)
+    STREAM_STEP_OA,         // OA length + type of address
+    STREAM_STEP_UDL,        // OA digits, PID, DCS, SCTS, UDL
+};
+
+static pdu_stream_result_t stream_fail(pdu_stream_t *ctx, const char *why) {
+    ESP_LOGW(TAG, "Streamed PDU rejected: %s", why);
+    ctx->state = PDU_STREAM_SKIP;
+    return PDU_STREAM_FAILED;
+}
+
+static pdu_stream_result_t stream_finish(pdu_stream_t *ctx, pdu_sms_view_t *out) {
+    ctx->state = PDU_STREAM_SKIP;
+    return pdu_view_parse(ctx->octets, ctx->len, out) ? PDU_STREAM_DECODED : PDU_STREAM_FAILED;
+}
+
+/**
+ * @brief A field just completed (len == need): check it and set the next target
+ */
+static pdu_stream_result_t stream_advance(pdu_stream_t *ctx, pdu_sms_view_t *out) {
+    const uint8_t *o = ctx->octets;
+
+    if (ctx->state == PDU_STREAM_BODY) {
+        return stream_finish(ctx, out);
+    }
+
+    switch (ctx->step) {
+    case STREAM_STEP_SMSC:
+        ctx->need = 1 + (size_t)o[0] + 1;
+        ctx->step = STREAM_STEP_TYPE;
+        break;
+    case STREAM_STEP_TYPE:
+        if ((o[ctx->need - 1] & 0x03) != 0x00) return stream_fail(ctx, "not SMS-DELIVER");
+        ctx->need += 2;
+        ctx->step = STREAM_STEP_OA;
+        break;
+    case STREAM_STEP_OA: {
+        size_t oa_octets = ((size_t)o[ctx->need - 2] + 1) / 2;
+        ctx->need += oa_octets + 1 + 1 + 7 + 1; // OA digits, PID, DCS, SCTS, UDL
+        ctx->step = STREAM_STEP_UDL;
+        break;
+    }
+    case STREAM_STEP_UDL: {
+        uint8_t udl = o[ctx->need - 1];
+        uint8_t dcs = o[ctx->need - 1 - 7 - 1];
+        // UDL counts septets for GSM 7-bit, octets for 8-bit data and UCS2
+        size_t ud_octets = ((dcs & 0x0C) == 0x00) ? ((size_t)udl * 7 + 7) / 8 : udl;
+        ctx->need += ud_octets;
+        ctx->state = PDU_STREAM_BODY;
+        if (ud_octets == 0) return stream_finish(ctx, out);
+        break;
+    }
+    default:
+        return stream_fail(ctx, "bad state");
+    }
+
+    if (ctx->need > PDU_MAX_OCTETS) return stream_fail(ctx, "too long");
+    return PDU_STREAM_MORE;
+}
+
+void pdu_stream_begin(pdu_stream_t *ctx) {
+    ctx->state = PDU_STREAM_HEADER;
+    ctx->len = 0;
+    ctx->need = 1;
+    ctx->step = STREAM_STEP_SMSC;
+    ctx->pending_hex = 0;
+}
+
+pdu_stream_result_t pdu_stream_feed(pdu_stream_t *ctx, const char *data, size_t n,
+                                    size_t *consumed, pdu_sms_view_t *out) {
+    size_t i = 0;
+    pdu_stream_result_t result = PDU_STREAM_MORE;
+
+    while (i < n && ctx->state != PDU_STREAM_IDLE) {
+        if (data[i] == '\r' || data[i] == '\n') {
+            // Line ended: decode whatever arrived (short PDUs are decoded
+            // best-effort, as pdu_decode() always did), then hand back.
+            if (ctx->state == PDU_STREAM_HEADER || ctx->state == PDU_STREAM_BODY) {
+                result = stream_finish(ctx, out);
+            }
+            ctx->state = PDU_STREAM_IDLE;
+            break;
+        }
+
+        if (ctx->state == PDU_STREAM_SKIP) {
+            i++;
+            continue;
+        }
+
+        // Hex run up to the line end (or end of this chunk)
+        size_t run = i;
+        while (run < n && data[run] != '\r' && data[run] != '\n') run++;
+        size_t avail = run - i;
+
+        if (ctx->pending_hex) {
+            // Complete a pair that was split across two UART events
+            char pair[2] = { ctx->pending_hex, data[i] };
+            ctx->pending_hex = 0;
+            i++;
+            if (!pdu_hex_decode(pair, 2, ctx->octets + ctx->len, NULL)) {
+                result = stream_fail(ctx, "invalid hex");
+                break;
+            }
+            ctx->len++;
+        } else if (avail == 1) {
+            if (data[i] == '\0') {
+                result = stream_fail(ctx, "invalid hex");
+                break;
+            }
+            ctx->pending_hex = data[i];
+            i++;
+            continue;
+        } else {
+            size_t take = (ctx->need - ctx->len) * 2;
+            if (take > (avail & ~(size_t)1)) take = avail & ~(size_t)1;
+            size_t bad_pos = 0;
+            if (!pdu_hex_decode(data + i, take, ctx->octets + ctx->len, &bad_pos)) {
+                i += bad_pos;
+                result = stream_fail(ctx, "invalid hex");
+                break;
+            }
+            ctx->len += take / 2;
+            i += take;
+        }
+
+        if (ctx->len == ctx->need) {
+            result = stream_advance(ctx, out);
+            if (result != PDU_STREAM_MORE) break;
+        }
+    }
+
+    *consumed = i;
+    return result;
+}
+
+// --- Batch decode (AT+CMGL response) ---
+
+/**
+ * @brief Parse "+CMGL: <index>,<stat>,..." up to the stat field
+ */
+static bool parse_cmgl_header(const char *line, size_t len, int *index, int *stat) {
+    size_t i = 6; // past "+CMGL:"
+    int *fields[2] = { index, stat };
+
+    for (int f = 0; f < 2; f++) {
+        while (i < len && line[i] == ' ') i++;
+        if (i >= len || line[i] < '0' || line[i] > '9') return false;
+        int v = 0;
+        while (i < len && line[i] >= '0' && line[i] <= '9' && v < 100000) {
+            v = v * 10 + (line[i++] - '0');
+        }
+        *fields[f] = v;
+        if (f == 0) {
+            if (i >= len || line[i] != ',') return false;
+            i++;
+        }
+    }
+    return true;
+}
+
+size_t pdu_decode_batch(const char *resp, size_t len, pdu_cmgl_record_t *out, size_t max,
+                        size_t *consumed) {
+    size_t pos = 0;
+    size_t n = 0;
+
+    if (!resp || !out) {
+        if (consumed) *consumed = 0;
+        return 0;
+    }
+
+    while (pos < len && n < max) {
+        const char *line = resp + pos;
+        const char *eol = memchr(line, '\n', len - pos);
+        if (!eol) break;
+        size_t line_len = (size_t)(eol - line);
+        size_t next = pos + line_len + 1;
+
+        if (line_len == 0 || (line_len == 1 && line[0] == '\r')) {
+            pos = next; // Blank separator line
+            continue;
+        }
+        if (line_len < 6 || memcmp(line, "+CMGL:", 6) != 0) {
+            break; // OK / URC / anything else belongs to the caller
+        }
+
+        // The PDU is the next line; a record is only taken when both are complete
+        const char *pdu = resp + next;
+        const char *pdu_eol = (next < len) ? memchr(pdu, '\n', len - next) : NULL;
+        if (!pdu_eol) break;
+        size_t pdu_len = (size_t)(pdu_eol - pdu);
+        if (pdu_len > 0 && pdu[pdu_len - 1] == '\r') pdu_len--;
+
+        pdu_cmgl_record_t *rec = &out[n];
+        if (!parse_cmgl_header(line, line_len, &rec->index, &rec->stat)) {
+            ESP_LOGW(TAG, "Failed to parse CMGL header");
+        } else {
+            size_t octets = hex_span_to_octets(pdu, pdu_len, rec->pdu);
+            if (octets > 0 && pdu_view_parse(rec->pdu, octets, &rec->view)) {
+                n++;
+            } else {
+                ESP_LOGE(TAG, "Failed to decode PDU at index %d", rec->index);
+            }
+        }
+
+        pos = (size_t)(pdu_eol - resp) + 1;
+    }
+
+    if (consumed) *consumed = pos;
+    return n;
+}
@@ -11,10 +11,12 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define PDU_MAX_SENDER_LEN   32
 #define PDU_MAX_MESSAGE_LEN  512
+#define PDU_MAX_OCTETS       384   // Binary PDU cap (matches the 768-char CMGL line cap)
 
 /**
  * @brief Decoded SMS message structure
@@ -39,3 +41,337 @@ typedef struct {
  * @return false    Decode failed (malformed PDU)
  */
 bool pdu_decode(const char *pdu_hex, pdu_sms_t *out);
+
+/**
+ * @brief Decode a binary PDU (already converted from hex) into SMS structure
+ *
+ * Every field is read straight from the byte span; nothing on this path
+ * allocates from the heap, so it is safe to call back to back during a
+ * backlog flush on rx_task's stack.
+ *
+ * @param pdu       PDU octets, starting at the SMSC length byte
+ * @param len       Number of octets in @p pdu
+ * @param out       Output structure to fill
+ * @return true     Decode successful
+ * @return false    Decode failed (malformed PDU)
+ */
+bool pdu_decode_bytes(const uint8_t *pdu, size_t len, pdu_sms_t *out);
+
+// --- Lazy view ---
+
+/**
+ * @brief Service centre time stamp (TP-SCTS)
+ */
+typedef struct {
+    uint8_t year;                       // 00-99
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    int8_t tz_quarters;                 // Offset from UTC in quarter hours (e.g. +32 = UTC+8)
+} pdu_timestamp_t;
+
+// --- UDH information elements ---
+
+#define PDU_UDH_MAX_IES      8     // A 140-octet UDH rarely carries more than 3
+
+#define PDU_IEI_CONCAT_8         0x00
+#define PDU_IEI_SPECIAL_SMS      0x01  // Special SMS message indication (voicemail etc.)
+#define PDU_IEI_PORTS_8          0x04
+#define PDU_IEI_PORTS_16         0x05
+#define PDU_IEI_CONCAT_16        0x08
+#define PDU_IEI_NL_LOCKING       0x24  // National language locking shift
+#define PDU_IEI_NL_SINGLE        0x25  // National language single shift
+
+/**
+ * @brief One UDH information element: where its data lives in the PDU
+ */
+typedef struct {
+    uint8_t iei;
+    uint8_t len;                        // IE data length
+    uint16_t offset;                    // Offset of the IE data from the PDU start
+} pdu_udh_ie_t;
+
+/**
+ * @brief Every UDH IE in header order, built in one pass by pdu_view_parse()
+ */
+typedef struct {
+    uint8_t count;
+    uint8_t dropped;                    // Well-formed IEs beyond PDU_UDH_MAX_IES
+    pdu_udh_ie_t ie[PDU_UDH_MAX_IES];
+} pdu_udh_index_t;
+
+/**
+ * @brief Zero-copy view of an SMS-DELIVER PDU
+ *
+ * pdu_view_parse() only walks the header: it validates the structure,
+ * records where each field lives, indexes the UDH and reads the
+ * concatenation info (the assembly key), port addressing and national
+ * language shift IDs from it. Sender and text are decoded only when asked for, so
+ * duplicate fragments and already-processed indices cost no text decoding.
+ * The view points into the PDU buffer, which must outlive it.
+ */
+typedef struct {
+    const uint8_t *pdu;                 // PDU octets the offsets refer to
+    uint16_t oa_pos;                    // Originating address digits
+    uint16_t scts_pos;                  // 7-octet time stamp
+    uint16_t ud_pos;                    // User data (UDH included)
+    uint16_t ud_len;                    // Octets available from ud_pos
+    uint16_t udh_len;                   // UDH octets including UDHL, 0 if none
+    uint8_t oa_len;                     // OA length in semi-octets
+    uint8_t oa_type;                    // OA type of address
+    uint8_t pid;                        // TP-PID
+    uint8_t dcs;                        // TP-DCS
+    uint8_t udl;                        // TP-UDL (septets or octets, per DCS)
+
+    // Concatenated SMS info (valid when is_multipart == true)
+    bool is_multipart;
+    uint16_t ref_num;
+    uint8_t total_parts;
+    uint8_t part_num;                   // 1-based
+
+    // Application port addressing (valid when has_ports == true)
+    bool has_ports;
+    uint16_t dst_port;
+    uint16_t src_port;
+
+    // National language shift tables for GSM 7-bit text (0 = default)
+    uint8_t nl_locking;
+    uint8_t nl_single;
+
+    pdu_udh_index_t udh;
+} pdu_sms_view_t;
+
+/**
+ * @brief Locate the fields of a binary SMS-DELIVER PDU without decoding text
+ *
+ * @param pdu       PDU octets, starting at the SMSC length byte
+ * @param len       Number of octets in @p pdu
+ * @param view      View to fill
+ * @return true     PDU is a well-formed SMS-DELIVER
+ * @return false    Malformed or not SMS-DELIVER
+ */
+bool pdu_view_parse(const uint8_t *pdu, size_t len, pdu_sms_view_t *view);
+
+/**
+ * @brief Decode the sender address ('+' prefix for international numbers)
+ * @return Number of bytes written, excluding the terminator
+ */
+size_t pdu_view_sender(const pdu_sms_view_t *view, char *out, size_t out_size);
+
+/**
+ * @brief Decode the message text (GSM 7-bit or UCS2) to UTF-8
+ * @return Number of bytes written, excluding the terminator
+ */
+size_t pdu_view_text(const pdu_sms_view_t *view, char *out, size_t out_size);
+
+/**
+ * @brief Raw user data of a view, UDH stripped, for decoding later
+ */
+typedef struct {
+    const uint8_t *data;    // First octet after the UDH
+    uint16_t len;           // Octets from data to the end of the UD
+    uint16_t units;         // Text length: septets (GSM 7-bit) or octets (UCS2)
+    uint8_t fill_bits;      // GSM 7-bit: padding bits before the first septet
+    bool ucs2;
+} pdu_payload_t;
+
+/**
+ * @brief Locate the message text in its undecoded form
+ *
+ * Lets a caller keep the raw bytes of several parts and decode them in one
+ * go (see sms_assembly.h); pdu_view_text() decodes the same span.
+ */
+void pdu_view_payload(const pdu_sms_view_t *view, pdu_payload_t *out);
+
+/**
+ * @brief Read the service centre time stamp
+ * @return false if the view was never successfully parsed
+ */
+bool pdu_view_timestamp(const pdu_sms_view_t *view, pdu_timestamp_t *ts);
+
+/**
+ * @brief First UDH IE with the given IEI, or NULL
+ */
+const pdu_udh_ie_t *pdu_view_find_ie(const pdu_sms_view_t *view, uint8_t iei);
+
+/**
+ * @brief Data octets of an IE from the view's index
+ */
+static inline const uint8_t *pdu_view_ie_data(const pdu_sms_view_t *view, const pdu_udh_ie_t *ie) {
+    return view->pdu + ie->offset;
+}
+
+/**
+ * @brief TP-PID (protocol identifier), e.g. 0x40 for a silent "type 0" SMS
+ */
+static inline uint8_t pdu_view_pid(const pdu_sms_view_t *view) {
+    return view->pid;
+}
+
+// --- Text arena ---
+
+/**
+ * @brief Caller-supplied bump arena for decoded text
+ *
+ * Text is appended back to back, so storage is sized for what messages
+ * actually need rather than PDU_MAX_MESSAGE_LEN each. Individual slices
+ * are never freed; the owner resets the whole arena.
+ */
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t used;
+} pdu_arena_t;
+
+/**
+ * @brief Length-tagged slice of decoded UTF-8 text (also NUL-terminated)
+ */
+typedef struct {
+    const char *ptr;
+    size_t len;
+} pdu_text_t;
+
+static inline void pdu_arena_init(pdu_arena_t *arena, char *buf, size_t size) {
+    arena->buf = buf;
+    arena->size = size;
+    arena->used = 0;
+}
+
+static inline void pdu_arena_reset(pdu_arena_t *arena) {
+    arena->used = 0;
+}
+
+/**
+ * @brief Largest pdu_view_text_bound() of a well-formed SMS: 140 octets of
+ *        UD carry at most 160 septets, 3 UTF-8 bytes each under a locking
+ *        shift table
+ */
+#define PDU_TEXT_BOUND_SMS   (160 * 3 + 4)
+
+/**
+ * @brief Worst-case arena space pdu_view_text_alloc() needs for this PDU
+ */
+size_t pdu_view_text_bound(const pdu_sms_view_t *view);
+
+/**
+ * @brief Decode the message text into an arena
+ *
+ * Needs pdu_view_text_bound() bytes free but only consumes the decoded
+ * length plus the terminator.
+ *
+ * @param view      Parsed PDU
+ * @param arena     Arena to append to
+ * @param out       Slice of the decoded text
+ * @return true     Text decoded in full
+ * @return false    Not enough room: nothing is written, the arena and
+ *                  @p out (set to an empty slice) are left unchanged
+ */
+bool pdu_view_text_alloc(const pdu_sms_view_t *view, pdu_arena_t *arena, pdu_text_t *out);
+
+// --- Incremental (streaming) decode ---
+
+typedef enum {
+    PDU_STREAM_IDLE = 0,    // No PDU line in progress
+    PDU_STREAM_HEADER,      // Collecting SMSC..UDL, validating each field as it completes
+    PDU_STREAM_BODY,        // Collecting user data up to the length announced by UDL
+    PDU_STREAM_SKIP,        // PDU finished or rejected; discarding the rest of the line
+} pdu_stream_state_t;
+
+typedef enum {
+    PDU_STREAM_MORE = 0,    // Nothing to report yet (need more input, or line ended while skipping)
+    PDU_STREAM_DECODED,     // *out holds a parsed SMS view
+    PDU_STREAM_FAILED,      // PDU was malformed; the rest of its line is skipped
+} pdu_stream_result_t;
+
+/**
+ * @brief Resumable decoder state for one PDU line
+ *
+ * Hex characters are converted into @c octets as they arrive; header fields
+ * are checked the moment their octets are complete, so a non-DELIVER or
+ * oversized PDU is rejected early. Once UDL is known the decoder knows the
+ * exact PDU length and parses it as soon as the last user-data octet lands,
+ * without waiting for the line terminator.
+ */
+typedef struct {
+    pdu_stream_state_t state;
+    uint8_t octets[PDU_MAX_OCTETS];
+    size_t len;                         // Octets converted so far
+    size_t need;                        // Octet count at which the next field is complete
+    uint8_t step;                       // Header field being collected
+    char pending_hex;                   // First char of a hex pair split across feeds, or 0
+} pdu_stream_t;
+
+/**
+ * @brief Start a new PDU line (call right after the +CMGL/+CMGR header line)
+ */
+void pdu_stream_begin(pdu_stream_t *ctx);
+
+/**
+ * @brief Discard the coming PDU line without decoding it (e.g. already processed)
+ */
+static inline void pdu_stream_skip(pdu_stream_t *ctx) {
+    ctx->state = PDU_STREAM_SKIP;
+}
+
+/**
+ * @brief True while the stream still owns incoming bytes (up to the line end)
+ */
+static inline bool pdu_stream_busy(const pdu_stream_t *ctx) {
+    return ctx->state != PDU_STREAM_IDLE;
+}
+
+/**
+ * @brief Feed raw UART bytes into the PDU decoder
+ *
+ * Consumes bytes up to (not including) the line terminator; once the
+ * terminator is seen the stream returns to PDU_STREAM_IDLE and the caller
+ * parses the rest of the input as ordinary lines.
+ *
+ * @param ctx       Stream state from pdu_stream_begin()
+ * @param data      Incoming bytes
+ * @param n         Number of bytes in @p data
+ * @param consumed  Set to the number of bytes taken from @p data
+ * @param out       Filled when PDU_STREAM_DECODED is returned; points into
+ *                  @p ctx and stays valid until the next pdu_stream_begin()
+ * @return See pdu_stream_result_t. Call again with the remaining bytes
+ *         while pdu_stream_busy() and input is left.
+ */
+pdu_stream_result_t pdu_stream_feed(pdu_stream_t *ctx, const char *data, size_t n,
+                                    size_t *consumed, pdu_sms_view_t *out);
+
+// --- Batch decode (AT+CMGL response) ---
+
+/**
+ * @brief One stored message from an AT+CMGL listing
+ */
+typedef struct {
+    int index;                          // SIM storage index (for AT+CMGD)
+    int stat;                           // 0=unread, 1=read, 2=unsent, 3=sent
+    uint8_t pdu[PDU_MAX_OCTETS];        // Binary PDU the view points into
+    pdu_sms_view_t view;
+} pdu_cmgl_record_t;
+
+/**
+ * @brief Parse every complete +CMGL record in a response in one linear pass
+ *
+ * Walks the text line by line: each "+CMGL: <index>,<stat>,..." header and
+ * the PDU line after it become one record, holding the binary PDU and a
+ * view over it (text is not decoded here; see pdu_view_text()). Blank lines are skipped. Stops
+ * at the first line that is not part of the listing (e.g. the final "OK"
+ * or an interleaved URC), at a record whose PDU line is not complete yet,
+ * or when @p max records are filled. Records whose PDU fails to parse are
+ * logged and dropped.
+ *
+ * @param resp      Response text (need not be NUL-terminated)
+ * @param len       Number of bytes in @p resp
+ * @param out       Record array to fill
+ * @param max       Capacity of @p out
+ * @param consumed  Optional: set to the number of bytes handled; anything
+ *                  after it (the stopping line, a partial record) is left
+ *                  for the caller
+ * @return Number of records written to @p out
+ */
+size_t pdu_decode_batch(const char *resp, size_t len, pdu_cmgl_record_t *out, size_t max,
+                        size_t *consumed);
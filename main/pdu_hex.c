@@ -0,0 +1,163 @@
+/**
+ * @file pdu_hex.c
+ * @brief Hex-to-binary kernels for PDU strings (see header)
+ */
+
+#include <string.h>
+#include "pdu_hex.h"
+
+// PDU_HEX_FORCE_SWAR: build the target's SWAR kernel on an x86 host as well,
+// so host tests cover the path the ESP32 runs
+#if defined(__AVX2__) && !defined(PDU_HEX_FORCE_SWAR)
+#include <immintrin.h>
+#elif defined(__SSE2__) && !defined(PDU_HEX_FORCE_SWAR)
+#include <emmintrin.h>
+#endif
+
+// --- Scalar ---
+
+/**
+ * @brief Convert hex character to nibble value
+ */
+static int hex_to_nibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+static bool decode_scalar(const char *hex, size_t hex_len, uint8_t *out, size_t base, size_t *bad_pos) {
+    for (size_t i = 0; i + 1 < hex_len; i += 2) {
+        int hi = hex_to_nibble(hex[i]);
+        int lo = hex_to_nibble(hex[i + 1]);
+        if (hi < 0 || lo < 0) {
+            if (bad_pos) *bad_pos = base + i + (hi < 0 ? 0 : 1);
+            return false;
+        }
+        out[i / 2] = (uint8_t)((hi << 4) | lo);
+    }
+    return true;
+}
+
+// --- Vector / SWAR blocks ---
+// Each block kernel converts a fixed number of characters. On an invalid
+// character it returns its index within the block, otherwise -1.
+
+#if defined(__AVX2__) && !defined(PDU_HEX_FORCE_SWAR)
+
+#define HEX_BLOCK 32
+
+static int decode_block(const char *hex, uint8_t *out) {
+    const __m256i v = _mm256_loadu_si256((const __m256i *)hex);
+    const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+
+    // Signed compares: bytes >= 0x80 are negative and fail both ranges
+    const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                           _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+    const __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                           _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+
+    const uint32_t valid = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(digit, alpha));
+    if (valid != 0xFFFFFFFFu) {
+        return __builtin_ctz(~valid);
+    }
+
+    // nibble = (c & 0x0F) + 9 for letters
+    const __m256i nib = _mm256_add_epi8(_mm256_and_si256(v, _mm256_set1_epi8(0x0F)),
+                                        _mm256_and_si256(alpha, _mm256_set1_epi8(9)));
+    // 16-bit lane = nib[2i] | nib[2i+1] << 8  ->  (nib[2i] << 4) | nib[2i+1]
+    const __m256i packed16 = _mm256_or_si256(
+        _mm256_and_si256(_mm256_slli_epi16(nib, 4), _mm256_set1_epi16(0x00F0)),
+        _mm256_srli_epi16(nib, 8));
+    const __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(packed16),
+                                           _mm256_extracti128_si256(packed16, 1));
+    _mm_storeu_si128((__m128i *)out, bytes);
+    return -1;
+}
+
+#elif defined(__SSE2__) && !defined(PDU_HEX_FORCE_SWAR)
+
+#define HEX_BLOCK 16
+
+static int decode_block(const char *hex, uint8_t *out) {
+    const __m128i v = _mm_loadu_si128((const __m128i *)hex);
+    const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+
+    // Signed compares: bytes >= 0x80 are negative and fail both ranges
+    const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                        _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                        _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+
+    const unsigned valid = (unsigned)_mm_movemask_epi8(_mm_or_si128(digit, alpha));
+    if (valid != 0xFFFFu) {
+        return __builtin_ctz(~valid);
+    }
+
+    // nibble = (c & 0x0F) + 9 for letters
+    const __m128i nib = _mm_add_epi8(_mm_and_si128(v, _mm_set1_epi8(0x0F)),
+                                     _mm_and_si128(alpha, _mm_set1_epi8(9)));
+    // 16-bit lane = nib[2i] | nib[2i+1] << 8  ->  (nib[2i] << 4) | nib[2i+1]
+    const __m128i packed16 = _mm_or_si128(
+        _mm_and_si128(_mm_slli_epi16(nib, 4), _mm_set1_epi16(0x00F0)),
+        _mm_srli_epi16(nib, 8));
+    _mm_storel_epi64((__m128i *)out, _mm_packus_epi16(packed16, packed16));
+    return -1;
+}
+
+#elif defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+
+// 64-bit SWAR: 8 characters per step. Used on Xtensa (ESP32), where the
+// compiler splits it into branch-free 32-bit register pairs.
+#define HEX_BLOCK 8
+
+#define SWAR_BYTES(b) (0x0101010101010101ULL * (uint8_t)(b))
+#define SWAR_HIGH     SWAR_BYTES(0x80)
+
+static int decode_block(const char *hex, uint8_t *out) {
+    uint64_t x;
+    memcpy(&x, hex, sizeof(x));
+
+    // Range tests: for bytes < 0x80, (b + 0x80 - k) has its high bit set
+    // iff b >= k, and never carries into the next byte.
+    const uint64_t ascii = ~x & SWAR_HIGH;
+    const uint64_t x7 = x & ~SWAR_HIGH;
+    const uint64_t digit = (x7 + SWAR_BYTES(0x80 - '0')) & ~(x7 + SWAR_BYTES(0x80 - '9' - 1));
+    const uint64_t lower = x7 | SWAR_BYTES(0x20);
+    const uint64_t alpha = (lower + SWAR_BYTES(0x80 - 'a')) & ~(lower + SWAR_BYTES(0x80 - 'f' - 1));
+
+    const uint64_t invalid = ~((digit | alpha) & ascii) & SWAR_HIGH;
+    if (invalid) {
+        return __builtin_ctzll(invalid) / 8;
+    }
+
+    // nibble = (c & 0x0F) + 9 for letters
+    const uint64_t nib = (x & SWAR_BYTES(0x0F)) + ((alpha & SWAR_HIGH) >> 7) * 9;
+    // 16-bit lane = nib[2i] | nib[2i+1] << 8  ->  (nib[2i] << 4) | nib[2i+1]
+    uint64_t t = ((nib << 4) | (nib >> 8)) & 0x00FF00FF00FF00FFULL;
+    t = (t | (t >> 8)) & 0x0000FFFF0000FFFFULL;
+    t = (t | (t >> 16)) & 0x00000000FFFFFFFFULL;
+
+    const uint32_t bytes = (uint32_t)t;
+    memcpy(out, &bytes, sizeof(bytes));
+    return -1;
+}
+
+#endif
+
+bool pdu_hex_decode(const char *hex, size_t hex_len, uint8_t *out, size_t *bad_pos) {
+    hex_len &= ~(size_t)1;
+    size_t i = 0;
+
+#ifdef HEX_BLOCK
+    for (; i + HEX_BLOCK <= hex_len; i += HEX_BLOCK) {
+        int bad = decode_block(hex + i, out + i / 2);
+        if (bad >= 0) {
+            if (bad_pos) *bad_pos = i + (size_t)bad;
+            return false;
+        }
+    }
+#endif
+
+    return decode_scalar(hex + i, hex_len - i, out + i / 2, i, bad_pos);
+}
@@ -0,0 +1,27 @@
+/**
+ * @file pdu_hex.h
+ * @brief Validating hex-to-binary conversion for PDU strings
+ *
+ * Converts many characters per step: AVX2 (32) or SSE2 (16) on x86 host
+ * builds, 64-bit SWAR (8) everywhere else, including the Xtensa target.
+ * A scalar loop handles the tail. Define PDU_HEX_FORCE_SWAR to get the
+ * SWAR kernel on x86 too (host tests of the target's path).
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Convert hex characters to octets
+ *
+ * @param hex       Input characters ('0'-'9', 'A'-'F', 'a'-'f')
+ * @param hex_len   Number of characters to convert (odd trailing nibble is ignored)
+ * @param out       Output buffer, at least hex_len / 2 bytes
+ * @param bad_pos   Optional: set to the index of the first invalid character
+ * @return true     All characters were valid hex
+ * @return false    Invalid character found (out is only partially written)
+ */
+bool pdu_hex_decode(const char *hex, size_t hex_len, uint8_t *out, size_t *bad_pos);
@@ -12,8 +12,14 @@
 #include "cJSON.h"
 #include "mqtt_client.h"
 #include "app_common.h"
+#include "sim_modem.h"
 #include "config.h"
 #include "pdu_decoder.h"
+#include "sms_assembly.h"
+#include "at_parser.h"
+#include "at_sched.h"
+#include "sim_storage.h"
+#include "spsc_ring.h"
 #include "health_monitor.h"
 
 static const char *TAG = "SIM_MODEM";
@@ -21,168 +27,315 @@ static const char *TAG = "SIM_MODEM";
 // UART Configuration
 #define EX_UART_NUM UART_NUM_2
 #define BUF_SIZE (2048)
-#define RD_BUF_SIZE (BUF_SIZE)
 #define TXD_PIN SIM_UART_TX_PIN
 #define RXD_PIN SIM_UART_RX_PIN
 
+// 速率協商：開機以模組預設速率連線，再以 AT+IPR 拉到目標速率 (config.h 可覆寫)
+#ifndef SIM_UART_BAUD
+#define SIM_UART_BAUD 115200            // 模組出廠速率
+#endif
+#ifndef SIM_UART_TARGET_BAUD
+#define SIM_UART_TARGET_BAUD 460800     // 協商目標 (460800/921600)；設為 SIM_UART_BAUD 即不協商
+#endif
+// 硬體流量控制：RTS/CTS 兩腳都有接才啟用
+#ifndef SIM_UART_RTS_PIN
+#define SIM_UART_RTS_PIN UART_PIN_NO_CHANGE
+#endif
+#ifndef SIM_UART_CTS_PIN
+#define SIM_UART_CTS_PIN UART_PIN_NO_CHANGE
+#endif
+#define UART_RX_FLOW_THRESH 122         // RX FIFO (128 bytes) 到這裡就拉 RTS
+
+// 硬體行偵測：驅動每收到一個 '\n' 就送一個 UART_PATTERN_DET 事件，rx_task 一次讀一行
+#define UART_PATTERN_QUEUE_LEN 32                   // 尚未讀走的行尾位置
+#define UART_RX_DRAIN_LEVEL    (BUF_SIZE)           // 驅動緩衝 (BUF_SIZE*2) 用掉一半就不等行尾
+
+// --- 工作分配 (config.h 可覆寫) ---
+// rx_task：UART 讀取、行切割、AT 指令、PDU 解析，短小且高優先，不讓慢速發布拖到收資料；
+// publish_task：解碼文字、組合長簡訊、cJSON、MQTT 發布，在另一顆核心上與模組傳送下一筆重疊。
+// 兩者之間是無鎖 SPSC 佇列 (見 spsc_ring.h)
+#ifndef SIM_RX_TASK_CORE
+#if CONFIG_FREERTOS_UNICORE
+#define SIM_RX_TASK_CORE 0
+#else
+#define SIM_RX_TASK_CORE 1                  // APP CPU；Wi-Fi/lwIP 在 PRO CPU (0)
+#endif
+#endif
+#ifndef SIM_RX_TASK_PRIORITY
+#define SIM_RX_TASK_PRIORITY 10
+#endif
+#ifndef SIM_RX_TASK_STACK
+#define SIM_RX_TASK_STACK 4096
+#endif
+#ifndef SIM_PUBLISH_TASK_CORE
+// 固定在 PRO CPU (0)，與 Wi-Fi/lwIP 和 esp-mqtt 的 task 同核：發布本來就要經過它們，
+// 而 APP CPU 整顆留給 rx_task，解碼、組 JSON 再忙也不會搶到 UART 讀取。
+// 優先權低於 Wi-Fi (23) 與 lwIP (18)，不影響網路。可設為 tskNO_AFFINITY 讓排程器自選
+#define SIM_PUBLISH_TASK_CORE 0
+#endif
+#ifndef SIM_PUBLISH_TASK_PRIORITY
+#define SIM_PUBLISH_TASK_PRIORITY 5
+#endif
+#ifndef SIM_PUBLISH_TASK_STACK
+#define SIM_PUBLISH_TASK_STACK 8192         // cJSON + 文字解碼 call chain
+#endif
+
 static QueueHandle_t uart0_queue;
 static SemaphoreHandle_t flush_sem = NULL;
 
 // --- Multipart SMS Assembly (PDU Mode) ---
+// 片段只存原始 UD bytes，收齊或逾時才整則解碼一次；各則共用一個固定區塊池，
+// 最多 255 段 (見 sms_assembly.h)；區塊池放不下的長簡訊經驅逐分幾次發布
 #define SMS_FRAGMENT_TIMEOUT_MS     30000   // 片段逾時 30 秒 (給更多時間等所有分段)
-#define SMS_MAX_FRAGMENTS           10      // 每則訊息最大片段數
-#define SMS_COMBINED_MSG_SIZE       2048    // 組合後訊息最大長度
+#define SMS_COMBINED_MSG_CHUNK      1024    // 組合後訊息的 heap 緩衝起始大小，不夠時加倍
+#define SMS_SINGLE_TEXT_SIZE        PDU_TEXT_BOUND_SMS  // 單則簡訊文字 arena (鎖定移位表 160 septets 最壞 484 bytes)
 
-// 改進的分段簡訊緩衝結構 (使用 ref_num 正確識別)
-typedef struct {
-    char sender[64];                        // 發送者
-    uint16_t ref_num;                       // 分段參考號碼 (關鍵識別)
-    uint8_t total_parts;                    // 預期總片段數
-    uint8_t received_parts;                 // 已收到片段數
-    bool part_received[SMS_MAX_FRAGMENTS];  // 各片段接收狀態 (1-indexed)
-    char fragments[SMS_MAX_FRAGMENTS][512]; // 片段內容 (按 part_num 索引)
-    int indices[SMS_MAX_FRAGMENTS];         // 各片段的 SIM 儲存索引 (用於刪除)
-    int64_t first_fragment_time;            // 第一個片段的接收時間
-    bool active;                            // 此緩衝槽是否使用中
-} sms_assembly_buffer_t;
-
-#define SMS_ASSEMBLY_SLOTS 4
-static sms_assembly_buffer_t s_assembly_buffers[SMS_ASSEMBLY_SLOTS] = {0};
-
-// --- 已處理索引追蹤 (防止重複處理) ---
-#define PROCESSED_RING_SIZE 32
-static int s_processed_ring[PROCESSED_RING_SIZE];
-static int s_processed_ring_count = 0;
+static sms_assembly_t s_assembly;
+
+#define SMS_INDEX_DIRECT            (-1)    // +CMT 直送的簡訊沒有 SIM 索引
+
+// --- 延遲刪除 / 已處理索引 ---
+// 已讀/待刪除索引用 bitmap 追蹤 (不會滿也不會重複)，由規劃器挑最省的刪除指令 (見 sim_storage.h)。
+// 排入刪除到真正刪掉之前都算「已處理」：期間的清單讀到也會跳過，不會重複發布
+static sim_storage_t s_storage;
 
 static bool is_index_processed(int index) {
-    for (int i = 0; i < s_processed_ring_count; i++) {
-        if (s_processed_ring[i] == index) return true;
+    return sim_storage_is_processed(&s_storage, index);
+}
+
+static void queue_delete_sms(int index) {
+    if (!sim_storage_mark_delete(&s_storage, index)) {
+        ESP_LOGW(TAG, "SIM index %d out of range, not deleted", index);
+    }
+}
+
+static void send_at_command(const char *cmd)
+{
+    uart_write_bytes(EX_UART_NUM, cmd, strlen(cmd));
+    uart_write_bytes(EX_UART_NUM, "\r\n", 2);
+    ESP_LOGI(TAG, "Sent: %s", cmd);
+}
+
+static int64_t get_time_ms(void) {
+    return (int64_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+}
+
+// --- UART 速率協商 (只在 rx_task 進入主循環前使用，直接同步讀 UART) ---
+#define SIM_MODEM_BOOT_TIMEOUT_MS   30000   // 等模組開機回應 AT 的上限
+static int s_uart_baud = SIM_UART_BAUD;
+
+// 送出指令並等待 OK；ERROR 或逾時回傳 false
+static bool modem_command_ok(const char *cmd, int timeout_ms) {
+    char resp[64];
+    size_t len = 0;
+    int64_t deadline = get_time_ms() + timeout_ms;
+
+    uart_flush_input(EX_UART_NUM);
+    send_at_command(cmd);
+    while (get_time_ms() < deadline) {
+        int n = uart_read_bytes(EX_UART_NUM, resp + len, sizeof(resp) - 1 - len, pdMS_TO_TICKS(20));
+        if (n <= 0) continue;
+        len += (size_t)n;
+        resp[len] = '\0';
+        if (strstr(resp, "OK")) return true;
+        if (strstr(resp, "ERROR")) return false;
+        // 只保留尾端，讓跨讀取的 "OK" 仍比對得到
+        if (len > sizeof(resp) / 2) {
+            memmove(resp, resp + len - 8, 8);
+            len = 8;
+        }
     }
     return false;
 }
 
-static void mark_index_processed(int index) {
-    if (s_processed_ring_count < PROCESSED_RING_SIZE) {
-        s_processed_ring[s_processed_ring_count++] = index;
-    } else {
-        // Ring buffer 滿了，shift 掉最舊的
-        memmove(s_processed_ring, s_processed_ring + 1, 
-                (PROCESSED_RING_SIZE - 1) * sizeof(int));
-        s_processed_ring[PROCESSED_RING_SIZE - 1] = index;
+static bool probe_modem(int attempts) {
+    for (int i = 0; i < attempts; i++) {
+        if (modem_command_ok("AT", 300)) return true;
     }
+    return false;
 }
 
-static void clear_processed_ring(void) {
-    s_processed_ring_count = 0;
+static void set_uart_baud(int baud) {
+    uart_wait_tx_done(EX_UART_NUM, pdMS_TO_TICKS(100));
+    uart_set_baudrate(EX_UART_NUM, baud);
+    s_uart_baud = baud;
 }
 
-// --- Flush 狀態控制 ---
-static int64_t s_last_flush_time = 0;
-#define FLUSH_COOLDOWN_MS 3000  // flush 之間最少間隔 3 秒
+// 反覆探測直到模組回 OK (模組開機中就一直等)，取代開機的固定延遲。
+// AT+IPR 多半存進模組：ESP 單獨重啟時模組還停在協商後的速率，所以兩個速率輪流試
+static bool find_modem(int timeout_ms) {
+    int64_t deadline = get_time_ms() + timeout_ms;
+    do {
+        // 模組的 auto-baud 也靠這幾個 AT 鎖定
+        if (probe_modem(2)) return true;
+        if (SIM_UART_TARGET_BAUD != SIM_UART_BAUD) {
+            set_uart_baud(s_uart_baud == SIM_UART_BAUD ? SIM_UART_TARGET_BAUD : SIM_UART_BAUD);
+        }
+    } while (get_time_ms() < deadline);
+    return false;
+}
+
+// 找出模組目前的速率並拉到 SIM_UART_TARGET_BAUD；任何一步失敗都退回能通的速率
+static void negotiate_uart(void) {
+    if (!find_modem(SIM_MODEM_BOOT_TIMEOUT_MS)) {
+        set_uart_baud(SIM_UART_BAUD);
+        ESP_LOGE(TAG, "Modem not answering AT after %d ms, staying at %d baud",
+                 SIM_MODEM_BOOT_TIMEOUT_MS, s_uart_baud);
+        return;
+    }
+    ESP_LOGI(TAG, "Modem answered at %d baud after %lld ms", s_uart_baud, (long long)get_time_ms());
+    if (s_uart_baud == SIM_UART_TARGET_BAUD) return;
 
-// --- 延遲刪除佇列 ---
-#define DELETE_QUEUE_SIZE 16
-static int s_delete_queue[DELETE_QUEUE_SIZE];
-static int s_delete_queue_count = 0;
+    char cmd[24];
+    snprintf(cmd, sizeof(cmd), "AT+IPR=%d", SIM_UART_TARGET_BAUD);
+    // 模組以舊速率回 OK 之後才切換
+    if (!modem_command_ok(cmd, 1000)) {
+        ESP_LOGW(TAG, "AT+IPR rejected, staying at %d baud", s_uart_baud);
+        return;
+    }
+    set_uart_baud(SIM_UART_TARGET_BAUD);
+    vTaskDelay(pdMS_TO_TICKS(50));
+    if (probe_modem(3)) {
+        ESP_LOGI(TAG, "UART switched to %d baud", s_uart_baud);
+        return;
+    }
 
-static void queue_delete_sms(int index) {
-    if (s_delete_queue_count < DELETE_QUEUE_SIZE) {
-        // 避免重複加入
-        for (int i = 0; i < s_delete_queue_count; i++) {
-            if (s_delete_queue[i] == index) return;
-        }
-        s_delete_queue[s_delete_queue_count++] = index;
+    // 新速率不通 (線路品質/模組不支援)：回到原速率
+    set_uart_baud(SIM_UART_BAUD);
+    if (probe_modem(3)) {
+        ESP_LOGW(TAG, "No answer at %d baud, back to %d", SIM_UART_TARGET_BAUD, s_uart_baud);
+    } else {
+        ESP_LOGE(TAG, "Modem lost after AT+IPR=%d", SIM_UART_TARGET_BAUD);
     }
 }
 
-static void send_at_command(const char *cmd)
-{
-    uart_write_bytes(EX_UART_NUM, cmd, strlen(cmd));
-    uart_write_bytes(EX_UART_NUM, "\r\n", 2);
-    ESP_LOGI(TAG, "Sent: %s", cmd);
+// 模組端先以 AT+IFC 開啟 RTS/CTS，成功後 ESP 端才跟進
+static void enable_flow_control(void) {
+    if (SIM_UART_RTS_PIN == UART_PIN_NO_CHANGE || SIM_UART_CTS_PIN == UART_PIN_NO_CHANGE) return;
+
+    if (!modem_command_ok("AT+IFC=2,2", 500)) {
+        ESP_LOGW(TAG, "AT+IFC rejected, hardware flow control off");
+        return;
+    }
+    uart_set_hw_flow_ctrl(EX_UART_NUM, UART_HW_FLOWCTRL_CTS_RTS, UART_RX_FLOW_THRESH);
+    ESP_LOGI(TAG, "RTS/CTS flow control on");
 }
 
-// 執行延遲刪除（在主循環中呼叫，每次刪一個並等回應）
-static void process_delete_queue(void) {
-    if (s_delete_queue_count > 0) {
-        int index = s_delete_queue[0];
-        char cmd[32];
-        snprintf(cmd, sizeof(cmd), "AT+CMGD=%d", index);
-        send_at_command(cmd);
-        ESP_LOGI(TAG, "Deleted SMS at index %d (%d remaining)", 
-                 index, s_delete_queue_count - 1);
-        
-        // 移除佇列頭
-        memmove(s_delete_queue, s_delete_queue + 1, 
-                (s_delete_queue_count - 1) * sizeof(int));
-        s_delete_queue_count--;
-        
-        // 標記為已處理，防止未來 CMGL 再讀到
-        mark_index_processed(index);
+// --- AT 指令排程 ---
+// 所有執行期指令都排進這裡：收到最終結果碼 (OK/ERROR/+CMS ERROR) 就立刻送下一個，
+// 不再靠固定間隔猜測前一個指令是否完成 (見 at_sched.h)
+static at_sched_t s_at_sched;
+
+static void at_write(const char *cmd, void *ctx) {
+    send_at_command(cmd);
+}
+
+// --- SIM 容量 (AT+CPMS?) ---
+// 開機、每次清單後與批次刪除後查一次；其間由 +CMTI / 刪除結果即時增減
+#define SIM_STORAGE_WARN_PERCENT 80     // 用量到這裡就警告 (滿了新簡訊會被網路端擋下)
+static bool s_storage_warned = false;
+
+static void check_storage_level(void) {
+    int used = s_storage.used, total = s_storage.total;
+    if (total <= 0) return;
+
+    bool high = used * 100 >= total * SIM_STORAGE_WARN_PERCENT;
+    if (high && !s_storage_warned) {
+        ESP_LOGW(TAG, "SIM storage %d/%d in use", used, total);
     }
+    s_storage_warned = high;
 }
 
-// --- Multipart SMS Assembly Functions ---
+static void on_cpms_line(const char *line, size_t len, void *ctx) {
+    int used, total;
+    if (!sim_storage_parse_cpms(line, &used, &total)) return;
+    sim_storage_set_usage(&s_storage, used, total);
+    ESP_LOGI(TAG, "SIM storage: %d/%d", used, total);
+    check_storage_level();
+}
 
-static int64_t get_time_ms(void) {
-    return (int64_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+static void request_storage_status(void) {
+    at_sched_submit(&s_at_sched, "AT+CPMS?", 0, on_cpms_line, NULL, NULL, get_time_ms());
 }
 
-// 尋找現有的組合緩衝槽 (使用 sender + ref_num)
-static sms_assembly_buffer_t* find_assembly_buffer(const char *sender, uint16_t ref_num) {
-    for (int i = 0; i < SMS_ASSEMBLY_SLOTS; i++) {
-        if (s_assembly_buffers[i].active && 
-            s_assembly_buffers[i].ref_num == ref_num &&
-            strcmp(s_assembly_buffers[i].sender, sender) == 0) {
-            return &s_assembly_buffers[i];
+bool sim_modem_get_storage(int *used, int *total) {
+    // rx_task 更新、其他 task 讀取：各自是 16-bit 對齊存取
+    int u = s_storage.used, t = s_storage.total;
+    if (u < 0 || t < 0) return false;
+    *used = u;
+    *total = t;
+    return true;
+}
+
+static void on_delete_done(at_result_t result, int cms_error, void *ctx) {
+    int index = (int)(intptr_t)ctx;
+    sim_delete_status_t status = SIM_DELETE_OK;
+
+    if (result == AT_RESULT_OK) {
+        if (index == SIM_STORAGE_BULK) {
+            ESP_LOGI(TAG, "Deleted all read SMS");
+            request_storage_status();
+        } else {
+            ESP_LOGI(TAG, "Deleted SMS at index %d", index);
         }
+    } else {
+        ESP_LOGW(TAG, "AT+CMGD (index %d) failed (result %d, CMS %d)", index, (int)result, cms_error);
+        // 沒有回應就重送；被拒絕 (索引已不存在、模組不支援批次旗標) 不重送
+        status = (result == AT_RESULT_TIMEOUT || result == AT_RESULT_CANCELLED)
+                     ? SIM_DELETE_RETRY : SIM_DELETE_FAILED;
     }
-    return NULL;
+    sim_storage_delete_done(&s_storage, index, status);
+    check_storage_level();
 }
 
-// 取得或建立組合緩衝槽
-static sms_assembly_buffer_t* get_or_create_assembly_buffer(const char *sender, uint16_t ref_num, uint8_t total_parts) {
-    sms_assembly_buffer_t *buf = find_assembly_buffer(sender, ref_num);
-    if (buf) return buf;
-    
-    // 尋找空的槽
-    for (int i = 0; i < SMS_ASSEMBLY_SLOTS; i++) {
-        if (!s_assembly_buffers[i].active) {
-            memset(&s_assembly_buffers[i], 0, sizeof(sms_assembly_buffer_t));
-            memset(s_assembly_buffers[i].indices, -1, sizeof(s_assembly_buffers[i].indices));
-            s_assembly_buffers[i].active = true;
-            s_assembly_buffers[i].ref_num = ref_num;
-            s_assembly_buffers[i].total_parts = total_parts;
-            strncpy(s_assembly_buffers[i].sender, sender, sizeof(s_assembly_buffers[i].sender) - 1);
-            s_assembly_buffers[i].first_fragment_time = get_time_ms();
-            ESP_LOGI(TAG, "Created assembly buffer for ref=%d, total=%d", ref_num, total_parts);
-            return &s_assembly_buffers[i];
-        }
+// 把待刪除的索引交給排程器：能批次就一個 AT+CMGD=1,1，否則逐一背對背送出。
+// 保留一格給 +CMTI 觸發的 AT+CMGR，不讓刪除佔滿排程佇列
+static void process_delete_queue(void) {
+    int64_t now = get_time_ms();
+    int index;
+    char cmd[32];
+
+    // 批次刪除只在佇列全空時：排在前面的讀取會讓更多簡訊變成「已讀」
+    while (at_sched_free(&s_at_sched) > 1 &&
+           sim_storage_next_delete(&s_storage, at_sched_idle(&s_at_sched), &index, cmd, sizeof(cmd))) {
+        at_sched_submit(&s_at_sched, cmd, 0, NULL, on_delete_done, (void *)(intptr_t)index, now);
     }
-    
-    // 找不到空槽，覆蓋最舊的
-    int oldest_idx = 0;
-    int64_t oldest_time = s_assembly_buffers[0].first_fragment_time;
-    for (int i = 1; i < SMS_ASSEMBLY_SLOTS; i++) {
-        if (s_assembly_buffers[i].first_fragment_time < oldest_time) {
-            oldest_time = s_assembly_buffers[i].first_fragment_time;
-            oldest_idx = i;
-        }
+}
+
+// --- 解析後的記錄交給 publish_task，結果送回 rx_task ---
+// SIM 索引狀態 (s_storage) 與指令排程只在 rx_task 存取；publish_task 以結果佇列回報
+#define SMS_RECORD_RING_LEN 16      // 2 的次方；每格一筆完整 PDU
+#define SMS_RESULT_RING_LEN 64
+
+typedef enum {
+    SMS_RESULT_DONE = 0,            // 記錄處理完 (不論是否發布)
+    SMS_RESULT_DELETE,              // 已發布，排入刪除
+} sms_result_kind_t;
+
+typedef struct {
+    int16_t kind;
+    int16_t index;
+} sms_result_t;
+
+static pdu_cmgl_record_t s_record_buf[SMS_RECORD_RING_LEN];
+static sms_result_t s_result_buf[SMS_RESULT_RING_LEN];
+static spsc_ring_t s_records;       // rx_task -> publish_task
+static spsc_ring_t s_results;       // publish_task -> rx_task
+static TaskHandle_t s_publish_task = NULL;
+
+// publish_task 端：結果佇列滿就等 rx_task 消化，不丟掉任何刪除/確認
+static void report_result(sms_result_kind_t kind, int index) {
+    sms_result_t r = { .kind = (int16_t)kind, .index = (int16_t)index };
+    while (!spsc_ring_push(&s_results, &r)) {
+        vTaskDelay(1);
     }
-    
-    ESP_LOGW(TAG, "Assembly buffer full, overwriting oldest slot");
-    memset(&s_assembly_buffers[oldest_idx], 0, sizeof(sms_assembly_buffer_t));
-    memset(s_assembly_buffers[oldest_idx].indices, -1, sizeof(s_assembly_buffers[oldest_idx].indices));
-    s_assembly_buffers[oldest_idx].active = true;
-    s_assembly_buffers[oldest_idx].ref_num = ref_num;
-    s_assembly_buffers[oldest_idx].total_parts = total_parts;
-    strncpy(s_assembly_buffers[oldest_idx].sender, sender, sizeof(s_assembly_buffers[oldest_idx].sender) - 1);
-    s_assembly_buffers[oldest_idx].first_fragment_time = get_time_ms();
-    return &s_assembly_buffers[oldest_idx];
-}
-
-// 發布單則 SMS (非分段)
-static void publish_single_sms(const char *sender, const char *message, int sms_index) {
+}
+
+// --- Multipart SMS Assembly Functions ---
+
+// 發布單則 SMS (非分段)，回傳是否已交給 MQTT
+static bool publish_single_sms(const char *sender, const char *message, int sms_index) {
+    bool published = false;
     ESP_LOGI(TAG, "Publishing single SMS from %s: %s", sender, message);
     
     if (mqtt_client && g_app_state == APP_STATE_MQTT_CONNECTED) {
@@ -197,9 +350,11 @@ static void publish_single_sms(const char *sender, const char *message, int sms_
                 free(json_str);
                 
                 if (msg_id != -1) {
-                    // 加入延遲刪除佇列 (而非立即刪除)
-                    mark_index_processed(sms_index);
-                    queue_delete_sms(sms_index);
+                    published = true;
+                    // 加入延遲刪除佇列 (而非立即刪除)；+CMT 直送的不在 SIM 上
+                    if (sms_index != SMS_INDEX_DIRECT) {
+                        report_result(SMS_RESULT_DELETE, sms_index);
+                    }
                 } else {
                     ESP_LOGE(TAG, "Failed to publish SMS, keeping in SIM");
                 }
@@ -209,33 +364,59 @@ static void publish_single_sms(const char *sender, const char *message, int sms_
     } else {
         ESP_LOGW(TAG, "MQTT not connected, keeping SMS in SIM");
     }
+    return published;
+}
+
+// 組合後的文字：解碼器每解完一段就交來，接在依長度加大的 heap 緩衝後面
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+} combined_text_t;
+
+static bool append_combined_text(const char *text, size_t len, void *ctx) {
+    combined_text_t *t = ctx;
+    if (t->len + len + 1 > t->cap) {
+        size_t cap = t->cap ? t->cap : SMS_COMBINED_MSG_CHUNK;
+        while (cap < t->len + len + 1) cap *= 2;
+        char *grown = realloc(t->buf, cap);
+        if (!grown) {
+            // 記憶體不足：發布已解出的部分並標記 truncated
+            ESP_LOGE(TAG, "No memory for %u bytes of assembled SMS", (unsigned)cap);
+            return false;
+        }
+        t->buf = grown;
+        t->cap = cap;
+    }
+    memcpy(t->buf + t->len, text, len);
+    t->len += len;
+    t->buf[t->len] = '\0';
+    return true;
 }
 
 // 發布組合後的完整訊息
-static void publish_assembled_sms(sms_assembly_buffer_t *buf) {
-    if (!buf || buf->received_parts == 0) return;
+static void publish_assembled_sms(sms_assembly_slot_t *slot) {
+    if (!slot || slot->received_parts == 0) return;
     
-    // 使用 static 避免 stack overflow (rx_task stack 有限)
-    static char combined_msg[SMS_COMBINED_MSG_SIZE];
-    memset(combined_msg, 0, sizeof(combined_msg));
+    combined_text_t text = { 0 };
+    bool truncated = false;
     
-    // 按正確順序組合所有片段 (part_num 是 1-indexed)
-    for (int i = 1; i <= buf->total_parts && i <= SMS_MAX_FRAGMENTS; i++) {
-        if (buf->part_received[i] && strlen(buf->fragments[i]) > 0) {
-            if (strlen(combined_msg) + strlen(buf->fragments[i]) < SMS_COMBINED_MSG_SIZE - 1) {
-                strcat(combined_msg, buf->fragments[i]);
-            }
-        }
-    }
+    // 按 part_num 順序把原始 UD 接起來解碼 (跨片段的代理對/跳脫字元也正確)，
+    // 一次一小段：255 段的長簡訊也不需要最壞情況大小的 static 緩衝
+    sms_assembly_text_stream(&s_assembly, slot, append_combined_text, &text, &truncated);
+    const char *combined_msg = text.buf ? text.buf : "";
     
     ESP_LOGI(TAG, "Publishing assembled SMS from %s (%d/%d parts): %s", 
-             buf->sender, buf->received_parts, buf->total_parts, combined_msg);
+             slot->sender, slot->received_parts, slot->total_parts, combined_msg);
     
     if (mqtt_client && g_app_state == APP_STATE_MQTT_CONNECTED) {
         cJSON *root = cJSON_CreateObject();
         if (root) {
-            cJSON_AddStringToObject(root, "sender", buf->sender);
+            cJSON_AddStringToObject(root, "sender", slot->sender);
             cJSON_AddStringToObject(root, "message", combined_msg);
+            if (truncated) {
+                cJSON_AddBoolToObject(root, "truncated", true);
+            }
             char *json_str = cJSON_PrintUnformatted(root);
             
             if (json_str) {
@@ -244,10 +425,10 @@ static void publish_assembled_sms(sms_assembly_buffer_t *buf) {
                 
                 if (msg_id != -1) {
                     // 標記所有分段為已處理，加入延遲刪除佇列
-                    for (int i = 1; i <= buf->total_parts && i <= SMS_MAX_FRAGMENTS; i++) {
-                        if (buf->part_received[i] && buf->indices[i] >= 0) {
-                            mark_index_processed(buf->indices[i]);
-                            queue_delete_sms(buf->indices[i]);
+                    for (const sms_assembly_part_t *part = sms_assembly_first_part(&s_assembly, slot);
+                         part; part = sms_assembly_next_part(&s_assembly, part)) {
+                        if (part->sim_index != SMS_INDEX_DIRECT) {
+                            report_result(SMS_RESULT_DELETE, part->sim_index);
                         }
                     }
                 } else {
@@ -260,88 +441,307 @@ static void publish_assembled_sms(sms_assembly_buffer_t *buf) {
         ESP_LOGW(TAG, "MQTT not connected, keeping assembled SMS in SIM");
     }
     
-    // 清空緩衝槽
-    memset(buf, 0, sizeof(sms_assembly_buffer_t));
+    free(text.buf);
+    sms_assembly_release(&s_assembly, slot);
 }
 
 // 檢查並處理逾時的片段緩衝
 static void check_assembly_timeouts(void) {
-    int64_t now = get_time_ms();
-    for (int i = 0; i < SMS_ASSEMBLY_SLOTS; i++) {
-        if (s_assembly_buffers[i].active) {
-            if ((now - s_assembly_buffers[i].first_fragment_time) > SMS_FRAGMENT_TIMEOUT_MS) {
-                ESP_LOGI(TAG, "Assembly timeout for ref=%d, publishing %d/%d fragments",
-                         s_assembly_buffers[i].ref_num,
-                         s_assembly_buffers[i].received_parts,
-                         s_assembly_buffers[i].total_parts);
-                publish_assembled_sms(&s_assembly_buffers[i]);
-            }
+    sms_assembly_slot_t *slot;
+    while ((slot = sms_assembly_expired(&s_assembly, get_time_ms(), SMS_FRAGMENT_TIMEOUT_MS)) != NULL) {
+        ESP_LOGI(TAG, "Assembly timeout for ref=%d, publishing %d/%d fragments",
+                 slot->ref_num, slot->received_parts, slot->total_parts);
+        publish_assembled_sms(slot);
+    }
+}
+
+// 處理一則 PDU SMS (view 只含欄位位置，文字在確定要用時才解碼)
+// 回傳是否已接手：單則已發布，或片段已存進組合槽
+static bool handle_sms_view(const pdu_sms_view_t *view, int sms_index) {
+    char sender[PDU_MAX_SENDER_LEN];
+    pdu_view_sender(view, sender, sizeof(sender));
+
+    if (!view->is_multipart) {
+        // 單則簡訊，解碼後直接發布 (static: 只在 publish_task 使用)
+        static char single_pool[SMS_SINGLE_TEXT_SIZE];
+        pdu_arena_t arena;
+        pdu_text_t text;
+        pdu_arena_init(&arena, single_pool, sizeof(single_pool));
+        if (!pdu_view_text_alloc(view, &arena, &text)) {
+            // 不發布截斷的內容，留在 SIM 卡
+            ESP_LOGE(TAG, "SMS at index %d too long to decode, keeping in SIM", sms_index);
+            return false;
         }
+        return publish_single_sms(sender, text.ptr, sms_index);
+    }
+
+    // 分段簡訊：只複製原始 UD 進共用片段池，不解碼
+    sms_assembly_slot_t *slot;
+    sms_assembly_result_t r;
+    while ((r = sms_assembly_add(&s_assembly, sender, view, sms_index, get_time_ms(), &slot)) ==
+           SMS_ASSEMBLY_EVICT) {
+        // 組合槽或片段池用完：最舊的一則先以現有分段發布 (同逾時處理)，騰出空間再存
+        ESP_LOGW(TAG, "Assembly full (%u evictions, %u/%d blocks free), publishing ref=%d early",
+                 (unsigned)s_assembly.evictions, (unsigned)s_assembly.blocks_free,
+                 SMS_ASSEMBLY_POOL_BLOCKS, slot->ref_num);
+        publish_assembled_sms(slot);
     }
+    switch (r) {
+    case SMS_ASSEMBLY_EVICT:
+    case SMS_ASSEMBLY_INVALID:
+        ESP_LOGE(TAG, "Invalid part number: %d", view->part_num);
+        return false;
+    case SMS_ASSEMBLY_DUPLICATE:
+        ESP_LOGW(TAG, "Duplicate fragment %d for ref=%d, ignoring",
+                 view->part_num, view->ref_num);
+        // 標記為已處理並加入刪除佇列
+        if (sms_index != SMS_INDEX_DIRECT) {
+            report_result(SMS_RESULT_DELETE, sms_index);
+        }
+        break;
+    case SMS_ASSEMBLY_STORED:
+        ESP_LOGI(TAG, "Stored fragment %d/%d for ref=%d",
+                 view->part_num, view->total_parts, view->ref_num);
+        break;
+    case SMS_ASSEMBLY_COMPLETE:
+        ESP_LOGI(TAG, "All parts received for ref=%d, assembling", view->ref_num);
+        publish_assembled_sms(slot);
+        break;
+    }
+    return true;
 }
 
-// 處理解碼後的 PDU SMS
-static void handle_decoded_sms(pdu_sms_t *sms, int sms_index) {
-    if (!sms->is_multipart) {
-        // 單則簡訊，直接發布
-        publish_single_sms(sms->sender, sms->message, sms_index);
-    } else {
-        // 分段簡訊，加入組合緩衝
-        if (sms->part_num < 1 || sms->part_num > SMS_MAX_FRAGMENTS) {
-            ESP_LOGE(TAG, "Invalid part number: %d", sms->part_num);
-            return;
+// --- publish_task ---
+// 逐筆取出 rx_task 解析好的記錄：解碼文字、組合、發布，再把結果送回
+#define CMGL_TIMEOUT_MS 30000   // 整張 SIM 卡的清單在 115200 baud 也只要數秒
+
+static void publish_record(pdu_cmgl_record_t *rec) {
+    if (rec->index == SMS_INDEX_DIRECT) {
+        // rx_task 交接時已確認 (模組的確認時限等不了發布)：這裡失敗就只剩日誌
+        if (!handle_sms_view(&rec->view, SMS_INDEX_DIRECT)) {
+            ESP_LOGE(TAG, "Direct SMS already acknowledged but not delivered");
         }
-        
-        sms_assembly_buffer_t *buf = get_or_create_assembly_buffer(
-            sms->sender, sms->ref_num, sms->total_parts);
-        
-        if (!buf) return;
-        
-        // 存入正確位置 (使用 part_num 作為索引)
-        if (!buf->part_received[sms->part_num]) {
-            buf->part_received[sms->part_num] = true;
-            strncpy(buf->fragments[sms->part_num], sms->message, 
-                    sizeof(buf->fragments[sms->part_num]) - 1);
-            buf->indices[sms->part_num] = sms_index;
-            buf->received_parts++;
-            
-            ESP_LOGI(TAG, "Stored fragment %d/%d for ref=%d", 
-                     sms->part_num, sms->total_parts, sms->ref_num);
-            
-            // 檢查是否收齊所有片段
-            if (buf->received_parts >= buf->total_parts) {
-                ESP_LOGI(TAG, "All parts received for ref=%d, assembling", sms->ref_num);
-                publish_assembled_sms(buf);
-            }
+        return;
+    }
+    handle_sms_view(&rec->view, rec->index);
+    // 發布時的 DELETE 已排在前面：索引不會有一刻看起來「未處理」
+    report_result(SMS_RESULT_DONE, rec->index);
+}
+
+static void publish_task(void *arg) {
+    if (esp_task_wdt_add(NULL) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to subscribe publish_task to Task WDT");
+    }
+
+    for (;;) {
+        esp_task_wdt_reset();
+        // rx_task 每送一筆就通知；逾時照樣檢查組合逾時
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        check_assembly_timeouts();
+
+        pdu_cmgl_record_t *rec;
+        while ((rec = spsc_ring_front(&s_records)) != NULL) {
+            // 就地處理：view 指向同一格裡的 PDU 副本
+            publish_record(rec);
+            spsc_ring_release(&s_records);
+            esp_task_wdt_reset();
+        }
+    }
+}
+
+// --- PDU 串流解碼 ---
+// 跨越多次 UART 讀取的 PDU 行不整行緩衝：+CMGR/+CMT 標頭一到就開始，
+// 後續位元組直接送進解碼器，解析完成後搬進記錄佇列的下一格交給 publish_task
+static pdu_stream_t s_pdu_stream;
+static int s_pdu_index = -1;    // 串流中 PDU 的 SIM 索引
+static int s_pdu_stat = -1;
+static bool s_pdu_direct = false;   // 串流中的是 +CMT 直送 PDU (沒有 SIM 索引)
+
+// --- +CMT 直送模式 ---
+// AT+CNMI=2,2 讓 PDU 直接跟在 +CMT 後面送來，不寫進 SIM：解碼後立即發布。
+// MQTT 斷線時切回 AT+CNMI=2,1 存 SIM，重連後再由 flush 讀回。
+#ifndef SIM_SMS_DIRECT_DELIVERY
+#define SIM_SMS_DIRECT_DELIVERY 0   // 1: 啟用 +CMT 直送
+#endif
+#ifndef SIM_SMS_DIRECT_ACK
+#define SIM_SMS_DIRECT_ACK 1        // 模組以 AT+CSMS=1 運作，每則 +CMT 需 AT+CNMA 確認
+#endif
+
+#define CNMI_STORE  "AT+CNMI=2,1,0,0,0"     // 存 SIM，以 +CMTI 通知
+#define CNMI_DIRECT "AT+CNMI=2,2,0,0,0"     // 以 +CMT 直送
+
+static bool s_direct_active = false;    // 模組目前是直送路由
+static bool s_routing_pending = false;  // AT+CNMI 已排入尚未完成
+static bool s_routing_lost = false;     // 確認失敗：模組可能已關閉 +CMT/+CMTI 路由
+
+static void on_routing_done(at_result_t result, int cms_error, void *ctx) {
+    bool direct = (bool)(intptr_t)ctx;
+    s_routing_pending = false;
+    if (result == AT_RESULT_OK) {
+        s_direct_active = direct;
+        s_routing_lost = false;
+        ESP_LOGI(TAG, "SMS routing: %s", direct ? "direct (+CMT)" : "SIM storage (+CMTI)");
+    } else {
+        ESP_LOGW(TAG, "AT+CNMI failed (result %d, CMS %d)", (int)result, cms_error);
+    }
+}
+
+// MQTT 連線時直送，斷線時存 SIM (主循環每圈呼叫)
+static void update_sms_routing(void) {
+#if SIM_SMS_DIRECT_DELIVERY
+    bool want_direct = (g_app_state == APP_STATE_MQTT_CONNECTED);
+    if ((want_direct == s_direct_active && !s_routing_lost) || s_routing_pending) return;
+
+    if (at_sched_submit(&s_at_sched, want_direct ? CNMI_DIRECT : CNMI_STORE, 0,
+                        NULL, on_routing_done, (void *)(intptr_t)want_direct, get_time_ms())) {
+        s_routing_pending = true;
+    }
+#endif
+}
+
+// 準備把下一行 PDU 解碼後交給發布端 (SIM 中 index 的記錄)
+static void begin_stored_pdu(int index, int stat) {
+    pdu_stream_begin(&s_pdu_stream);
+    s_pdu_index = -1;
+    s_pdu_direct = false;
+
+    // 檢查是否已處理過此索引
+    if (is_index_processed(index)) {
+        ESP_LOGI(TAG, "Skipping already processed SMS at index %d", index);
+        // 仍加入刪除佇列確保從 SIM 移除
+        queue_delete_sms(index);
+        pdu_stream_skip(&s_pdu_stream);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Parsing PDU [%d]", index);
+    s_pdu_index = index;
+    s_pdu_stat = stat;
+}
+
+// UART 溢位或記錄佇列滿後補讀：不等下一次定期對帳 (見 handle_rx_overflow)
+static bool s_reconcile_pending = false;
+static bool s_reconcile_all = false;    // 遺失的是讀取回應：那則已標為已讀，要列全部
+static uint32_t s_records_deferred = 0; // 記錄佇列滿，留給補讀的簡訊
+
+// 完整列舉 (AT+CMGL=4 或分頁讀取) 讀遍 SIM 且途中沒漏掉任何東西，才允許批次刪除：
+// AT+CMGD=1,1 連本次沒讀到的「已讀」簡訊也一起刪掉 (見 sim_storage.h)
+static bool s_enum_lost = false;
+
+static void begin_enumeration(void) {
+    s_enum_lost = false;
+    sim_storage_set_enumerated(&s_storage, false);
+}
+
+static void end_enumeration(bool complete) {
+    sim_storage_set_enumerated(&s_storage, complete && !s_enum_lost);
+}
+
+// 可能有一則已讀簡訊沒發布 (溢位、交接失敗、讀取失敗)：到下一次完整列舉前不用批次刪除
+static void lose_track(void) {
+    s_enum_lost = true;
+    sim_storage_set_enumerated(&s_storage, false);
+}
+
+// publish_task 跟不上：不等它 (UART 不能停)，SIM 中 index 這則留給補讀處理
+static void defer_stored_record(int index) {
+    s_records_deferred++;
+    ESP_LOGW(TAG, "Publish queue full, index %d left for reconcile", index);
+    // 已讀：擋住會連它一起刪掉的批次刪除，補讀時要列全部
+    sim_storage_mark_read(&s_storage, index);
+    lose_track();
+    s_reconcile_pending = true;
+    s_reconcile_all = true;
+}
+
+// 解析完成的記錄搬進佇列交給 publish_task (view 指向串流緩衝，下一行就會被覆寫)
+// 回傳是否已交出
+static bool hand_over_record(const pdu_sms_view_t *view, int index, int stat) {
+    pdu_cmgl_record_t *rec = spsc_ring_acquire(&s_records);
+    if (!rec) {
+        if (index != SMS_INDEX_DIRECT) {
+            defer_stored_record(index);
         } else {
-            ESP_LOGW(TAG, "Duplicate fragment %d for ref=%d, ignoring", 
-                     sms->part_num, sms->ref_num);
-            // 標記為已處理並加入刪除佇列
-            mark_index_processed(sms_index);
-            queue_delete_sms(sms_index);
+            // 直送的拒收，網路端會重送
+            s_records_deferred++;
+            ESP_LOGW(TAG, "Publish queue full, rejecting direct SMS");
         }
+        return false;
     }
+    memcpy(rec->pdu, view->pdu, (size_t)view->ud_pos + view->ud_len);
+    rec->view = *view;
+    rec->view.pdu = rec->pdu;
+    rec->index = index;
+    rec->stat = stat;
+    // 已讀、交給發布端：結果回來前不重讀，也擋住批次刪除
+    if (index != SMS_INDEX_DIRECT) sim_storage_mark_queued(&s_storage, index);
+    spsc_ring_commit(&s_records);
+    xTaskNotifyGive(s_publish_task);
+    return true;
 }
 
-// 解析 PDU Mode 的 +CMGL 回應
-static void parse_pdu_cmgl(char *data) {
-    // PDU Mode 格式: +CMGL: <index>,<stat>,[alpha],<length>\r\n<pdu>\r\n
-    char *cmgl_ptr = strstr(data, "+CMGL:");
-    if (!cmgl_ptr) return;
+// --- AT+CMGL 清單批次解碼 ---
+// 清單的標頭與 PDU 行原樣收進 s_listing_buf，再由 pdu_decode_batch() 一次解碼進
+// 記錄佇列的連續空格，整批提交後只叫醒 publish_task 一次。緩衝放不下下一筆或清單結束時送出；
+// 記錄佇列滿時留在緩衝，主循環等發布端騰出空位再送
+#define SMS_LISTING_BUF_SIZE    4096
+#define SMS_LISTING_PDU_LINE    (PDU_MAX_OCTETS * 2 + 2)   // 最長的 PDU 行 (含 \r\n)
 
+static char s_listing_buf[SMS_LISTING_BUF_SIZE];
+static size_t s_listing_len = 0;    // 完整記錄的位元組數
+static size_t s_listing_fill = 0;   // 再加上收到一半的那筆
+static int s_listing_index = -1;    // 收到一半的那筆的 SIM 索引；-1：這一行 PDU 不收
+
+// 緩衝裡的完整記錄解碼進記錄佇列，回傳交出的筆數
+static size_t flush_listing(void) {
+    size_t handed = 0;
+
+    while (s_listing_len > 0) {
+        uint32_t room;
+        pdu_cmgl_record_t *span = spsc_ring_acquire_span(&s_records, &room);
+        if (!span) break;
+
+        size_t used = 0;
+        size_t n = pdu_decode_batch(s_listing_buf, s_listing_len, span, room, &used);
+        if (used == 0) {
+            // 緩衝裡只放清單記錄，不會發生；真的發生就整批丟掉，不要卡住
+            ESP_LOGE(TAG, "Listing buffer not decodable, dropped");
+            used = s_listing_len;
+        }
+
+        // 解碼期間 +CMTI 的 AT+CMGR 可能已交出同一則：不重複發布
+        uint32_t kept = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (is_index_processed(span[i].index)) continue;
+            if (kept != i) {
+                span[kept] = span[i];
+                span[kept].view.pdu = span[kept].pdu;
+            }
+            // 已讀、交給發布端：結果回來前不重讀，也擋住批次刪除
+            sim_storage_mark_queued(&s_storage, span[kept].index);
+            kept++;
+        }
+        spsc_ring_commit_n(&s_records, kept);
+        handed += kept;
+
+        memmove(s_listing_buf, s_listing_buf + used, s_listing_fill - used);
+        s_listing_len -= used;
+        s_listing_fill -= used;
+    }
+    if (handed > 0) xTaskNotifyGive(s_publish_task);
+    return handed;
+}
+
+// +CMGL: <index>,<stat>,[alpha],<length>：收下標頭，下一行 PDU 接在後面
+static void begin_listing_record(const char *line, size_t len) {
     int index = -1;
     int stat = -1;
-    int pdu_len = -1;
-    
-    // 解析標頭 — 嘗試多種格式
-    if (sscanf(cmgl_ptr, "+CMGL: %d,%d,,%d", &index, &stat, &pdu_len) < 2) {
-        // 可能有 alpha 欄位: +CMGL: 0,1,"",25
-        if (sscanf(cmgl_ptr, "+CMGL: %d,%d,", &index, &stat) < 2) {
-            ESP_LOGW(TAG, "Failed to parse CMGL header");
-            return;
-        }
+
+    s_listing_index = -1;
+    if (sscanf(line, "+CMGL: %d,%d", &index, &stat) < 2) {
+        ESP_LOGW(TAG, "Failed to parse CMGL header");
+        return;
     }
-    
     // 檢查是否已處理過此索引
     if (is_index_processed(index)) {
         ESP_LOGI(TAG, "Skipping already processed SMS at index %d", index);
@@ -349,37 +749,522 @@ static void parse_pdu_cmgl(char *data) {
         queue_delete_sms(index);
         return;
     }
-    
-    // 找 PDU 內容 (在 \r\n 之後)
-    char *pdu_start = strchr(cmgl_ptr, '\n');
-    if (!pdu_start) return;
-    pdu_start++; // Skip \n
-    
-    // 複製 PDU hex 字串
-    char pdu_hex[768] = {0};
-    int i = 0;
-    while (pdu_start[i] && pdu_start[i] != '\r' && pdu_start[i] != '\n' && i < (int)sizeof(pdu_hex) - 1) {
-        pdu_hex[i] = pdu_start[i];
-        i++;
-    }
-    pdu_hex[i] = '\0';
-    
-    if (strlen(pdu_hex) < 20) {
-        ESP_LOGW(TAG, "PDU too short: %s", pdu_hex);
+
+    // 放不下這一筆就先把已收的整批送出；佇列也滿就留給補讀
+    size_t need = len + 2 + SMS_LISTING_PDU_LINE;
+    if (sizeof(s_listing_buf) - s_listing_fill < need) flush_listing();
+    if (sizeof(s_listing_buf) - s_listing_fill < need) {
+        defer_stored_record(index);
         return;
     }
-    
-    ESP_LOGI(TAG, "Parsing PDU [%d]: %s", index, pdu_hex);
-    
-    // 解碼 PDU
-    pdu_sms_t sms;
-    if (pdu_decode(pdu_hex, &sms)) {
-        handle_decoded_sms(&sms, index);
-    } else {
-        ESP_LOGE(TAG, "Failed to decode PDU at index %d", index);
+
+    // 模組列出時已標為已讀：解不開而被批次丟掉的留著，擋住會連它一起刪掉的批次刪除
+    sim_storage_mark_read(&s_storage, index);
+    memcpy(s_listing_buf + s_listing_fill, line, len);
+    memcpy(s_listing_buf + s_listing_fill + len, "\r\n", 2);
+    s_listing_fill += len + 2;
+    s_listing_index = index;
+}
+
+// PDU 行：原樣分段接在標頭後面，行尾到了才算一筆完整記錄
+static void on_listing_pdu_line(const char *data, size_t len, bool end, void *ctx) {
+    if (s_listing_index < 0) return;
+
+    if (len > sizeof(s_listing_buf) - s_listing_fill) {
+        // 比任何合法 PDU 都長：丟掉這一筆 (已標為已讀)
+        ESP_LOGE(TAG, "PDU line too long at index %d", s_listing_index);
+        s_listing_fill = s_listing_len;
+        s_listing_index = -1;
+        return;
+    }
+    memcpy(s_listing_buf + s_listing_fill, data, len);
+    s_listing_fill += len;
+    if (end) {
+        s_listing_len = s_listing_fill;
+        s_listing_index = -1;
+    }
+}
+
+// publish_task 送回的結果 (rx_task 主循環每圈呼叫)
+static void process_results(void) {
+    sms_result_t r;
+    while (spsc_ring_pop(&s_results, &r)) {
+        switch (r.kind) {
+        case SMS_RESULT_DELETE:
+            queue_delete_sms(r.index);
+            break;
+        case SMS_RESULT_DONE:
+            sim_storage_unqueue(&s_storage, r.index);
+            break;
+        }
+    }
+}
+
+// 確認等不到或失敗時，模組依 27.005 把 AT+CNMI 的 <mt> 歸零：新簡訊只存 SIM、不再通知。
+// 不論目前要哪種路由都重送 AT+CNMI，並列一次未讀補上這段期間存進 SIM 的
+static void on_direct_ack_done(at_result_t result, int cms_error, void *ctx) {
+    if (result == AT_RESULT_OK) return;
+    ESP_LOGW(TAG, "AT+CNMA failed (result %d, CMS %d), re-enabling SMS routing",
+             (int)result, cms_error);
+    s_routing_lost = true;
+    s_reconcile_pending = true;
+}
+
+// +CMT 確認：rx_task 交接當下就送，插在排程佇列最前面，
+// 不排在刪除與分頁讀取後面錯過模組的確認時限 (通常只有數秒)
+static void ack_direct_sms(bool accepted) {
+#if SIM_SMS_DIRECT_ACK
+    const char *cmd = accepted ? "AT+CNMA" : "AT+CNMA=2";   // =2：拒收，網路端稍後重送
+    if (!at_sched_submit_front(&s_at_sched, cmd, 0, NULL, on_direct_ack_done, NULL,
+                               get_time_ms())) {
+        on_direct_ack_done(AT_RESULT_CANCELLED, -1, NULL);
+    }
+#else
+    (void)accepted;
+#endif
+}
+
+// 把 PDU 行的位元組交給串流解碼器，回傳消費的位元組數 (行尾留給一般解析)
+static size_t feed_pdu_stream(const char *data, size_t len) {
+    size_t total = 0;
+
+    while (total < len && pdu_stream_busy(&s_pdu_stream)) {
+        size_t used = 0;
+        pdu_sms_view_t view;
+        pdu_stream_result_t r = pdu_stream_feed(&s_pdu_stream, data + total, len - total,
+                                                &used, &view);
+        total += used;
+
+        if (s_pdu_direct) {
+            if (r == PDU_STREAM_DECODED) {
+                // 發布端接手才確認；MQTT 已斷線時拒收，重送時已切回存 SIM
+                bool accepted = g_app_state == APP_STATE_MQTT_CONNECTED &&
+                                hand_over_record(&view, SMS_INDEX_DIRECT, -1);
+                ack_direct_sms(accepted);
+            } else if (r == PDU_STREAM_FAILED) {
+                // 重送也一樣解不開：仍然確認，避免網路端反覆重送
+                ESP_LOGE(TAG, "Failed to decode direct PDU");
+                ack_direct_sms(true);
+            }
+            continue;
+        }
+        if (s_pdu_index < 0) continue;
+        if (r == PDU_STREAM_DECODED) {
+            hand_over_record(&view, s_pdu_index, s_pdu_stat);
+        } else if (r == PDU_STREAM_FAILED) {
+            ESP_LOGE(TAG, "Failed to decode PDU at index %d", s_pdu_index);
+            // 模組已把它標為已讀：留著，擋住會連它一起刪掉的批次刪除
+            sim_storage_mark_read(&s_storage, s_pdu_index);
+        }
+    }
+    return total;
+}
+
+
+// --- 接收端：環形緩衝 + 行切割，URC/回應依前綴分派 (見 at_parser.h) ---
+static at_parser_t s_at;
+static bool s_modem_ready = false;  // 啟動設定指令都已完成 (見下方「模組啟動」)
+
+// PDU 行：原樣分段送進串流解碼器，不經過行緩衝
+static void on_pdu_line(const char *data, size_t len, bool end, void *ctx) {
+    feed_pdu_stream(data, len);
+}
+
+// AT+CMGL 回應：+CMGL: <index>,<stat>,[alpha],<length>，下一行是 PDU
+static void on_cmgl_response(const char *line, size_t len, void *ctx) {
+    if (len < 6 || memcmp(line, "+CMGL:", 6) != 0) return;
+    begin_listing_record(line, len);
+    at_parser_expect_raw(&s_at, on_listing_pdu_line, NULL);
+}
+
+static bool s_listing = false;  // AT+CMGL 已排入或進行中
+
+// 清單結束 (OK/ERROR/逾時)：收齊的記錄整批交給 publish_task
+static void on_cmgl_done(at_result_t result, int cms_error, void *ctx) {
+    bool full = (bool)(intptr_t)ctx;     // AT+CMGL=4：列舉整張 SIM
+    s_listing = false;
+    if (result != AT_RESULT_OK) {
+        ESP_LOGW(TAG, "AT+CMGL failed (result %d, CMS %d)", (int)result, cms_error);
+    }
+    // 收到一半的那筆 (逾時、溢位取消) 丟掉：已標為已讀，補讀會再列出
+    s_listing_fill = s_listing_len;
+    s_listing_index = -1;
+    flush_listing();
+    if (full) end_enumeration(result == AT_RESULT_OK);
+    request_storage_status();
+}
+
+// 定期對帳：+CMTI 漏掉 (線路溢位、指令佇列滿) 的未讀簡訊由這裡補上
+#define SMS_RECONCILE_INTERVAL_MS (10 * 60 * 1000)
+static int64_t s_last_listing_time = 0;
+
+// 排入一次讀取；排在已送出的刪除之後，不必等刪除佇列清空
+// unread_only: AT+CMGL=0 只列未讀 (定期對帳)；否則 AT+CMGL=4 全部 (開機/重連)
+static bool request_listing(bool unread_only) {
+    if (s_listing) return true;
+
+    if (!at_sched_submit(&s_at_sched, unread_only ? "AT+CMGL=0" : "AT+CMGL=4", CMGL_TIMEOUT_MS,
+                         on_cmgl_response, on_cmgl_done, (void *)(intptr_t)!unread_only, get_time_ms())) {
+        return false;
+    }
+    if (!unread_only) begin_enumeration();
+    ESP_LOGI(TAG, "%s", unread_only ? "Reconciling unread messages..." : "Flushing stored messages...");
+    s_listing = true;
+    s_last_listing_time = get_time_ms();
+    return true;
+}
+
+// AT+CMGR 回應：+CMGR: <stat>,[alpha],<length>，下一行是 PDU
+static void on_cmgr_response(const char *line, size_t len, void *ctx) {
+    int stat = -1;
+    if (len < 6 || memcmp(line, "+CMGR:", 6) != 0) return;
+    sscanf(line, "+CMGR: %d,", &stat);
+    begin_stored_pdu((int)(intptr_t)ctx, stat);
+    at_parser_expect_raw(&s_at, on_pdu_line, NULL);
+}
+
+// 單筆讀取結束 (記錄在解析時就已交給 publish_task)
+static void on_cmgr_done(at_result_t result, int cms_error, void *ctx) {
+    if (result != AT_RESULT_OK) {
+        ESP_LOGW(TAG, "AT+CMGR=%d failed (result %d, CMS %d)", (int)(intptr_t)ctx, (int)result, cms_error);
+        // 回應可能只收到一半：那則在 SIM 上也許已是「已讀」
+        if (result != AT_RESULT_CMS_ERROR) lose_track();
+    }
+}
+
+// --- 積存分頁讀取 (開機/重連) ---
+// 依 SIM 容量逐一 AT+CMGR，每頁 DRAIN_PAGE_SIZE 個索引：讀到的記錄逐筆交給 publish_task，
+// 一頁結束就把已回報的刪除排入、餵 WDT、回報進度。記錄佇列的空位也限制頁面大小，
+// 發布端跟不上時讀取自然放慢。找到的筆數達到開始時的用量就提早結束，
+// 所以耗時跟積存量成正比；每個索引只掃一次，不會重讀。容量未知時退回 AT+CMGL=4
+#define DRAIN_PAGE_SIZE 8
+
+static struct {
+    bool active;
+    bool waiting;           // 排程佇列沒空位，主循環稍後再送這一頁
+    int next;               // 下一個要讀的索引
+    int last;
+    int found;              // 讀到的記錄 + 已處理而跳過的索引
+    int expected;           // 開始時的用量
+    int page;
+    int page_left;          // 這一頁還沒完成的 AT+CMGR
+    int64_t started_ms;
+} s_drain;
+
+static void drain_next_page(void);
+
+static void on_drain_line(const char *line, size_t len, void *ctx) {
+    if (len >= 6 && memcmp(line, "+CMGR:", 6) == 0) s_drain.found++;
+    on_cmgr_response(line, len, ctx);
+}
+
+static void on_drain_done(at_result_t result, int cms_error, void *ctx) {
+    // 空索引回 OK 或 +CMS ERROR 321，都只是「沒有簡訊」
+    if (result != AT_RESULT_OK && result != AT_RESULT_CMS_ERROR) {
+        ESP_LOGW(TAG, "AT+CMGR=%d failed (result %d)", (int)(intptr_t)ctx, (int)result);
+        lose_track();
+    }
+    if (--s_drain.page_left > 0) return;
+
+    // 一頁結束：已發布的排入刪除 (排在下一頁的讀取之前)
+    process_results();
+    process_delete_queue();
+    esp_task_wdt_reset();
+    ESP_LOGI(TAG, "Drain page %d: %d/%d stored messages", s_drain.page, s_drain.found, s_drain.expected);
+    drain_next_page();
+}
+
+static void drain_next_page(void) {
+    s_drain.waiting = false;
+    if (s_drain.next > s_drain.last || s_drain.found >= s_drain.expected) {
+        s_drain.active = false;
+        end_enumeration(true);
+        ESP_LOGI(TAG, "Drain done: %d messages in %d pages, %lld ms", s_drain.found, s_drain.page,
+                 (long long)(get_time_ms() - s_drain.started_ms));
+        request_storage_status();
+        return;
+    }
+
+    // 保留一格給 +CMTI 的 AT+CMGR；沒空位就等主循環 (刪除完成、發布端消化後) 再來
+    int room = (int)at_sched_free(&s_at_sched) - 1;
+    int ring_room = (int)spsc_ring_free(&s_records) - 1;
+    if (ring_room < room) room = ring_room;
+    if (room <= 0) {
+        s_drain.waiting = true;
+        return;
+    }
+    if (room > DRAIN_PAGE_SIZE) room = DRAIN_PAGE_SIZE;
+
+    int64_t now = get_time_ms();
+    s_drain.page++;
+    s_drain.page_left = 0;
+    while (s_drain.page_left < room && s_drain.next <= s_drain.last) {
+        int index = s_drain.next++;
+        char cmd[24];
+        if (is_index_processed(index)) {
+            s_drain.found++;
+            continue;
+        }
+        snprintf(cmd, sizeof(cmd), "AT+CMGR=%d", index);
+        at_sched_submit(&s_at_sched, cmd, 0, on_drain_line, on_drain_done, (void *)(intptr_t)index, now);
+        s_drain.page_left++;
+    }
+    // 整頁都是已處理的索引：直接看下一頁
+    if (s_drain.page_left == 0) drain_next_page();
+}
+
+// 讀出 SIM 上所有簡訊 (開機/重連)：斷線期間讀過但沒發布的已是「已讀」，所以不能只列未讀
+static bool request_backlog_drain(void) {
+    if (s_drain.active) return true;
+    if (s_storage.total <= 0 || s_storage.used < 0) return request_listing(false);
+
+    memset(&s_drain, 0, sizeof(s_drain));
+    s_drain.active = true;
+    begin_enumeration();
+    // 多數模組索引從 1 起算，少數從 0：兩者都涵蓋
+    s_drain.next = 0;
+    s_drain.last = s_storage.total;
+    s_drain.expected = s_storage.used;
+    s_drain.started_ms = get_time_ms();
+    s_last_listing_time = s_drain.started_ms;
+    ESP_LOGI(TAG, "Draining %d stored messages (capacity %d)", s_drain.expected, s_storage.total);
+    drain_next_page();
+    return true;
+}
+
+// +CMT: [<alpha>],<length>，下一行是直送的 PDU
+static void on_cmt_line(const char *line, size_t len, void *ctx) {
+    ESP_LOGI(TAG, "Direct SMS delivery");
+    pdu_stream_begin(&s_pdu_stream);
+    s_pdu_index = SMS_INDEX_DIRECT;
+    s_pdu_direct = true;
+    at_parser_expect_raw(&s_at, on_pdu_line, NULL);
+}
+
+// +CMTI: "SM",<index> 新訊息通知：直接 AT+CMGR 讀這一筆
+static void on_cmti_line(const char *line, size_t len, void *ctx) {
+    int index = -1;
+    char cmd[24];
+
+    sim_storage_note_stored(&s_storage);
+    check_storage_level();
+
+    // MQTT 未連線或設定未完成時留在 SIM，之後的完整讀取會處理
+    if (!s_modem_ready || g_app_state != APP_STATE_MQTT_CONNECTED) return;
+
+    if (sscanf(line, "+CMTI: \"%*[^\"]\",%d", &index) != 1 || index < 0) {
+        ESP_LOGW(TAG, "Unparsed CMTI, listing unread: %s", line);
+        request_listing(true);
+        return;
+    }
+    if (is_index_processed(index)) return;
+
+    ESP_LOGI(TAG, "New message at index %d", index);
+    snprintf(cmd, sizeof(cmd), "AT+CMGR=%d", index);
+    if (!at_sched_submit(&s_at_sched, cmd, 0, on_cmgr_response, on_cmgr_done,
+                         (void *)(intptr_t)index, get_time_ms())) {
+        // 排程佇列滿：交給下一次對帳
+        ESP_LOGW(TAG, "Command queue full, index %d left for reconcile", index);
+        s_last_listing_time = 0;
+    }
+}
+
+static void on_ignored_line(const char *line, size_t len, void *ctx) {
+    ESP_LOGD(TAG, "Ignored: %s", line);
+}
+
+// URC 以外的行都是指令回應，交給排程器對應到進行中的指令
+static void on_response_line(const char *line, size_t len, void *ctx) {
+    if (!at_sched_on_line(&s_at_sched, line, len, get_time_ms())) {
+        ESP_LOGD(TAG, "Unsolicited: %s", line);
+    }
+}
+
+// --- 模組啟動 (readiness 驅動) ---
+// 不再用固定延遲猜模組好了沒：設定指令經排程器一個接一個送，前一個完成就送下一個。
+// SIM 或簡訊子系統還沒好 (ERROR / +CMS ERROR) 就稍後重試，+CPIN: READY、SMS DONE 一到立刻重試
+#define SETUP_RETRY_MS          1000
+#define SETUP_MAX_ATTEMPTS      20
+
+static const struct {
+    const char *cmd;
+    at_cmd_line_fn_t on_line;
+    bool needs_sim;                 // OK 之外還要看到 +CPIN: READY
+} s_setup_steps[] = {
+    { "ATE0",                           NULL,          false },
+    { "AT+CPIN?",                       NULL,          true  },  // +CPIN: 由 URC 表處理
+    { "AT+CPMS=\"SM\",\"SM\",\"SM\"",     on_cpms_line,  false },  // 儲存在 SIM，順便取得用量
+    { "AT+CMGF=0",                      NULL,          false },  // PDU Mode
+#if SIM_SMS_DIRECT_DELIVERY && SIM_SMS_DIRECT_ACK
+    { "AT+CSMS=1",                      NULL,          false },  // 直送的 +CMT 由我們以 AT+CNMA 確認
+#endif
+    { CNMI_STORE,                       NULL,          false },  // 直送模式在 MQTT 連上後才切換
+};
+#define SETUP_STEP_COUNT (sizeof(s_setup_steps) / sizeof(s_setup_steps[0]))
+
+static size_t s_setup_step = 0;
+static int s_setup_attempts = 0;
+static int s_setup_failures = 0;
+static bool s_setup_waiting = false;    // 等 s_setup_retry_at 再送目前這一步
+static int64_t s_setup_retry_at = 0;
+static bool s_sim_ready = false;        // 看到 +CPIN: READY
+
+static void on_setup_done(at_result_t result, int cms_error, void *ctx);
+
+static void submit_setup_step(void) {
+    s_setup_waiting = false;
+
+    if (s_setup_step >= SETUP_STEP_COUNT) {
+        s_modem_ready = true;
+        if (s_setup_failures > 0) {
+            ESP_LOGE(TAG, "SIM Init finished with %d failed step(s)", s_setup_failures);
+        }
+        ESP_LOGI(TAG, "SIM Init Done (PDU Mode, %d baud) at %lld ms. Waiting for messages...",
+                 s_uart_baud, (long long)get_time_ms());
+        // Initial flush if already connected
+        if (g_app_state == APP_STATE_MQTT_CONNECTED) {
+            sim_modem_trigger_flush();
+        }
+        return;
+    }
+
+    if (!at_sched_submit(&s_at_sched, s_setup_steps[s_setup_step].cmd, 0,
+                         s_setup_steps[s_setup_step].on_line, on_setup_done, NULL, get_time_ms())) {
+        s_setup_waiting = true;
+        s_setup_retry_at = get_time_ms() + SETUP_RETRY_MS;
+    }
+}
+
+static void on_setup_done(at_result_t result, int cms_error, void *ctx) {
+    const char *cmd = s_setup_steps[s_setup_step].cmd;
+    bool ok = (result == AT_RESULT_OK) && (!s_setup_steps[s_setup_step].needs_sim || s_sim_ready);
+
+    if (!ok) {
+        if (++s_setup_attempts < SETUP_MAX_ATTEMPTS) {
+            ESP_LOGW(TAG, "%s not ready (result %d, CMS %d), retrying", cmd, (int)result, cms_error);
+            s_setup_waiting = true;
+            s_setup_retry_at = get_time_ms() + SETUP_RETRY_MS;
+            return;
+        }
+        // 明確回報後繼續下一步：剩下的設定仍可能讓收簡訊部分可用
+        ESP_LOGE(TAG, "Modem setup failed at %s (result %d, CMS %d) after %d attempts",
+                 cmd, (int)result, cms_error, s_setup_attempts);
+        s_setup_failures++;
+    }
+    s_setup_step++;
+    s_setup_attempts = 0;
+    submit_setup_step();
+}
+
+// 主循環每圈呼叫：時間到就重送目前這一步
+static void poll_setup(int64_t now) {
+    if (s_setup_waiting && now >= s_setup_retry_at) {
+        submit_setup_step();
+    }
+}
+
+// 模組回報就緒：正在等重試的那一步不必等滿 SETUP_RETRY_MS
+static void retry_setup_now(void) {
+    if (s_setup_waiting) submit_setup_step();
+}
+
+// +CPIN: READY / SIM PIN / ... (AT+CPIN? 的回應或開機 URC)
+static void on_cpin_line(const char *line, size_t len, void *ctx) {
+    s_sim_ready = (strstr(line, "READY") != NULL);
+    ESP_LOGI(TAG, "%s", line);
+    if (s_sim_ready) retry_setup_now();
+}
+
+// SMS DONE / PB DONE：模組的簡訊與電話簿初始化完成
+static void on_modem_ready_line(const char *line, size_t len, void *ctx) {
+    ESP_LOGI(TAG, "%s", line);
+    retry_setup_now();
+}
+
+// URC 表：新增 +CMT、+CDS… 只要在這裡加一列
+static const struct {
+    const char *prefix;
+    at_line_fn_t fn;
+} s_line_handlers[] = {
+    { "+CMTI:",      on_cmti_line },
+    { "+CMT:",       on_cmt_line },
+    { "+CPIN:",      on_cpin_line },
+    { "SMS DONE",    on_modem_ready_line },
+    { "PB DONE",     on_modem_ready_line },
+    { "RING",        on_ignored_line },
+};
+
+static void init_line_parser(void) {
+    at_parser_init(&s_at, on_response_line, NULL);
+    at_sched_init(&s_at_sched, at_write, NULL);
+    for (size_t i = 0; i < sizeof(s_line_handlers) / sizeof(s_line_handlers[0]); i++) {
+        at_parser_register(&s_at, s_line_handlers[i].prefix, s_line_handlers[i].fn, NULL);
+    }
+}
+
+
+// 從驅動緩衝讀 len bytes 直接進環形緩衝並切行分派 (每個位元組只掃一次)
+static void read_uart_lines(size_t len) {
+    while (len > 0) {
+        size_t room;
+        char *dst = at_parser_rx_space(&s_at, &room);
+        if (room > len) room = len;
+        int read_len = uart_read_bytes(EX_UART_NUM, dst, room, pdMS_TO_TICKS(100));
+        if (read_len <= 0) break;
+        at_parser_rx_commit(&s_at, (size_t)read_len);
+        len -= (size_t)read_len;
+    }
+    at_parser_poll(&s_at);
+}
+
+// --- UART 溢位復原 ---
+static uint32_t s_rx_fifo_overflows = 0;
+static uint32_t s_rx_buffer_full = 0;
+
+// 硬體 FIFO 或驅動緩衝溢位：中間掉了一段資料，位置不明。
+// 清掉驅動緩衝讓缺口落在已知位置，剖析器跳到下一個行首重新對齊，
+// 進行中的指令回應已不完整，取消後由補讀把可能漏掉的簡訊找回來。
+static void handle_rx_overflow(bool fifo) {
+    if (fifo) s_rx_fifo_overflows++;
+    else s_rx_buffer_full++;
+
+    uart_flush_input(EX_UART_NUM);
+    uart_pattern_queue_reset(EX_UART_NUM, UART_PATTERN_QUEUE_LEN);
+    xQueueReset(uart0_queue);
+
+    // 進行中的 PDU 已缺資料：解碼器丟棄，原始資料通道保留到行尾再交回
+    at_parser_resync(&s_at);
+    lose_track();
+    if (pdu_stream_busy(&s_pdu_stream)) {
+        pdu_stream_skip(&s_pdu_stream);
     }
+
+    // 讀取類指令的回應可能只收到一半：被讀過的簡訊在 SIM 上已是「已讀」
+    const char *cmd = at_sched_current(&s_at_sched);
+    if (cmd && (strncmp(cmd, "AT+CMGR", 7) == 0 || strncmp(cmd, "AT+CMGL", 7) == 0)) {
+        s_reconcile_all = true;
+    }
+    // 被取消指令的 OK 可能還在路上：排程器以 AT 哨兵重新同步後才送下一個
+    at_sched_cancel(&s_at_sched, get_time_ms());
+    // 遺失的也可能是 +CMTI 通知
+    s_reconcile_pending = true;
+
+    ESP_LOGW(TAG, "UART %s overflow (cancelled %s), resyncing",
+             fifo ? "FIFO" : "buffer", cmd ? cmd : "nothing");
 }
 
+void sim_modem_get_rx_stats(sim_modem_rx_stats_t *out) {
+    out->fifo_overflows = s_rx_fifo_overflows;
+    out->buffer_full = s_rx_buffer_full;
+    out->resyncs = s_at.resyncs;
+    out->cancelled = s_at_sched.cancelled;
+    out->dropped_lines = s_at.dropped_lines;
+    out->records_deferred = s_records_deferred;
+    // publish_task 更新、health task 讀取：各自是對齊的單一存取，只做顯示
+    out->assembly_blocks = SMS_ASSEMBLY_POOL_BLOCKS;
+    out->assembly_blocks_free_min = s_assembly.blocks_free_min;
+    out->assembly_evictions = s_assembly.evictions;
+}
 
 void sim_modem_trigger_flush(void)
 {
@@ -391,59 +1276,23 @@ void sim_modem_trigger_flush(void)
 static void rx_task(void *arg)
 {
     uart_event_t event;
-    uint8_t *dtmp = (uint8_t *)malloc(RD_BUF_SIZE);
-    static char uart_buffer[4096] = {0};
-    static int uart_buffer_pos = 0;
-    
-    // Debounce: 收到 +CMTI 後延遲一段時間再 flush，讓所有分段到齊
-    static int64_t cmti_pending_time = 0;  // 0 = 沒有 pending
-    static const int CMTI_DEBOUNCE_MS = 2000; // 等 2 秒讓後續分段到達
-    
-    // 上次處理刪除佇列的時間
-    static int64_t last_delete_time = 0;
-    static const int DELETE_INTERVAL_MS = 500; // 每 500ms 處理一個刪除
     
-    if (!dtmp) {
-        vTaskDelete(NULL);
-        return;
-    }
-
+    init_line_parser();
     flush_sem = xSemaphoreCreateBinary();
 
     // --- Initialization ---
-    vTaskDelay(pdMS_TO_TICKS(2000));
-    
-    // Auto-baud
-    for(int i=0; i<10; i++) {
-        send_at_command("AT");
-        vTaskDelay(pdMS_TO_TICKS(200));
-    }
+    // Auto-baud (探測到模組回應為止) + 速率協商 + 流量控制
+    negotiate_uart();
+    enable_flow_control();
+    // 協商期間直接讀過 UART，清掉對應的事件與行尾位置
+    uart_flush_input(EX_UART_NUM);
+    uart_pattern_queue_reset(EX_UART_NUM, UART_PATTERN_QUEUE_LEN);
+    xQueueReset(uart0_queue);
 
-    send_at_command("ATE0"); 
-    vTaskDelay(pdMS_TO_TICKS(500));
-    send_at_command("AT+CPIN?"); 
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    
-    // 設定訊息儲存位置為 SIM 卡
-    send_at_command("AT+CPMS=\"SM\",\"SM\",\"SM\"");
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    
-    // *** PDU Mode ***
-    send_at_command("AT+CMGF=0");
-    vTaskDelay(pdMS_TO_TICKS(1000));
-
-    // Store messages in SIM (SM), notify with +CMTI
-    send_at_command("AT+CNMI=2,1,0,0,0"); 
-    vTaskDelay(pdMS_TO_TICKS(1000));
-
-    ESP_LOGI(TAG, "SIM Init Done (PDU Mode). Waiting for messages...");
-
-    // Initial flush if already connected
-    if (g_app_state == APP_STATE_MQTT_CONNECTED) {
-        sim_modem_trigger_flush();
-    }
+    // 其餘設定交給排程器，在主循環裡依回應推進
+    submit_setup_step();
 
-    // 訂閱 Task WDT：初始化已完成（前面的 vTaskDelay 累計 >5s，所以必須在這裡才加）。
+    // 訂閱 Task WDT：探測模組期間可能等上 SIM_MODEM_BOOT_TIMEOUT_MS，所以在這之後才加。
     // 之後每圈 reset；若 rx_task 真的卡在某個 blocking call >timeout，硬體會 panic 重啟。
     if (esp_task_wdt_add(NULL) != ESP_OK) {
         ESP_LOGW(TAG, "Failed to subscribe rx_task to Task WDT");
@@ -456,239 +1305,82 @@ static void rx_task(void *arg)
         esp_task_wdt_reset();
         health_notify_sim_alive();
         
-        // 檢查分段簡訊組合逾時
-        check_assembly_timeouts();
+        // publish_task 的結果、指令逾時檢查，再把待刪除的索引交給排程器
+        process_results();
+        at_sched_poll(&s_at_sched, now);
+        process_delete_queue();
+        poll_setup(now);
+        if (s_drain.waiting) drain_next_page();
+        if (s_listing_len > 0) flush_listing();
+        if (s_modem_ready) update_sms_routing();
         
-        // 處理延遲刪除佇列（每次只刪一個，避免指令衝突）
-        if (s_delete_queue_count > 0 && (now - last_delete_time) >= DELETE_INTERVAL_MS) {
-            process_delete_queue();
-            last_delete_time = now;
+        // 定期對帳：只列未讀，正常情況下 +CMTI 已經逐筆讀完
+        if (s_modem_ready && !s_drain.active && g_app_state == APP_STATE_MQTT_CONNECTED &&
+            (now - s_last_listing_time) >= SMS_RECONCILE_INTERVAL_MS) {
+            request_listing(true);
         }
-        
-        // CMTI debounce: 等待一段時間後再觸發 flush
-        // 但如果有刪除佇列未完成，延後 flush (避免 CMGD 和 CMGL 衝突)
-        if (cmti_pending_time > 0 && s_delete_queue_count == 0) {
-            if ((now - cmti_pending_time) >= CMTI_DEBOUNCE_MS) {
-                cmti_pending_time = 0;
-                if (g_app_state == APP_STATE_MQTT_CONNECTED) {
-                    // 確保 flush cooldown
-                    if ((now - s_last_flush_time) >= FLUSH_COOLDOWN_MS) {
-                        ESP_LOGI(TAG, "CMTI debounce expired, flushing stored messages...");
-                        clear_processed_ring();
-                        send_at_command("AT+CMGL=4");
-                        s_last_flush_time = now;
-                    } else {
-                        // cooldown 尚未到，延後
-                        cmti_pending_time = now;
-                    }
-                }
-            }
+        // 溢位或記錄佇列滿後補讀
+        if (s_reconcile_pending && s_modem_ready && !s_drain.active &&
+            g_app_state == APP_STATE_MQTT_CONNECTED && request_listing(!s_reconcile_all)) {
+            s_reconcile_pending = false;
+            s_reconcile_all = false;
         }
         
         // Check if we need to flush messages (from MQTT connect or external trigger)
-        // 同樣需要等刪除佇列清空
-        if (xSemaphoreTake(flush_sem, 0) == pdTRUE) {
-             if (g_app_state == APP_STATE_MQTT_CONNECTED && s_delete_queue_count == 0) {
-                 if ((now - s_last_flush_time) >= FLUSH_COOLDOWN_MS) {
-                     ESP_LOGI(TAG, "Flushing stored messages...");
-                     clear_processed_ring();
-                     send_at_command("AT+CMGL=4");
-                     s_last_flush_time = now;
-                 } else {
-                     // 重新排程
-                     xSemaphoreGive(flush_sem);
-                 }
-             } else if (s_delete_queue_count > 0) {
-                 // 刪除佇列未清，重新排程
-                 xSemaphoreGive(flush_sem);
-             }
+        // 斷線期間讀過但沒發布的簡訊已是「已讀」，所以這裡列全部
+        // 設定完成前不讀 (還不是 PDU Mode)；完成時會自己觸發一次
+        if (s_modem_ready && xSemaphoreTake(flush_sem, 0) == pdTRUE) {
+            if (g_app_state == APP_STATE_MQTT_CONNECTED && !request_backlog_drain()) {
+                // 排程佇列滿，重新排程
+                xSemaphoreGive(flush_sem);
+            }
         }
 
 
-        if (xQueueReceive(uart0_queue, (void *)&event, (TickType_t)100)) {
+        // 等待上限配合排程器的重新同步：安靜期要靠 at_sched_poll 量
+        if (xQueueReceive(uart0_queue, (void *)&event, pdMS_TO_TICKS(AT_SCHED_QUIET_MS / 2))) {
             switch (event.type) {
+            case UART_PATTERN_DET:
+                {
+                    // 一個事件 = 一個完整的行：讀到 '\n' 為止
+                    int pos = uart_pattern_pop_pos(EX_UART_NUM);
+                    if (pos < 0) {
+                        // 位置佇列滿而漏記：把緩衝中的全部讀走，行切割照樣正確
+                        size_t buffered = 0;
+                        uart_get_buffered_data_len(EX_UART_NUM, &buffered);
+                        read_uart_lines(buffered);
+                    } else {
+                        read_uart_lines((size_t)pos + 1);
+                    }
+                }
+                break;
             case UART_DATA:
                 {
-                    memset(dtmp, 0, RD_BUF_SIZE);
-                    int read_len = uart_read_bytes(EX_UART_NUM, dtmp, event.size, pdMS_TO_TICKS(100));
-                    
-                    if (read_len > 0) {
-                        if (uart_buffer_pos + read_len < (int)sizeof(uart_buffer) - 1) {
-                            memcpy(uart_buffer + uart_buffer_pos, dtmp, read_len);
-                            uart_buffer_pos += read_len;
-                            uart_buffer[uart_buffer_pos] = 0;
-                            
-                            // === 最優先：先處理 +CMGL 回應 (PDU Mode) ===
-                            while (1) {
-                                char *cmgl_start = strstr(uart_buffer, "+CMGL:");
-                                if (!cmgl_start) break;
-
-                                // 找標頭後的換行 (PDU 在下一行)
-                                char *header_end = strchr(cmgl_start, '\n');
-                                if (!header_end) break;
-
-                                // 找 PDU 結尾
-                                char *pdu_start = header_end + 1;
-                                char *pdu_end = strstr(pdu_start, "\r\n");
-                                
-                                if (pdu_end) {
-                                    // 安全地 null-terminate：計算 pdu_end+2 是否在 buffer 範圍內
-                                    int end_offset = (pdu_end + 2) - uart_buffer;
-                                    if (end_offset <= uart_buffer_pos) {
-                                        char saved = uart_buffer[end_offset];
-                                        uart_buffer[end_offset] = 0;
-                                        
-                                        parse_pdu_cmgl(cmgl_start);
-                                        
-                                        uart_buffer[end_offset] = saved;
-                                        
-                                        // Shift buffer: 消費掉已處理的部分
-                                        int remain = uart_buffer_pos - end_offset;
-                                        if (remain > 0) {
-                                            memmove(uart_buffer, uart_buffer + end_offset, remain);
-                                            uart_buffer_pos = remain;
-                                            uart_buffer[uart_buffer_pos] = 0;
-                                        } else {
-                                            uart_buffer_pos = 0;
-                                            uart_buffer[0] = 0;
-                                        }
-                                        continue; // 繼續找更多 +CMGL
-                                    }
-                                }
-                                break; // PDU 還沒完全收到，等下次
-                            }
-                            
-                            // === 處理 +CMTI (新訊息通知) ===
-                            while (1) {
-                                char *cmti_start = strstr(uart_buffer, "+CMTI:");
-                                if (!cmti_start) break;
-                                
-                                // 找到 +CMTI 行的結尾
-                                char *cmti_end = strstr(cmti_start, "\r\n");
-                                if (!cmti_end) {
-                                    cmti_end = strchr(cmti_start, '\n');
-                                    if (!cmti_end) break;
-                                }
-                                
-                                ESP_LOGI(TAG, "New Message Indication received");
-                                
-                                // 設定 debounce timer (用最後一次 +CMTI 的時間)
-                                cmti_pending_time = get_time_ms();
-                                
-                                // 從 buffer 裡移除這行 +CMTI
-                                char *consume_end = cmti_end;
-                                if (consume_end[0] == '\r') consume_end++;
-                                if (consume_end[0] == '\n') consume_end++;
-                                
-                                int consumed = consume_end - uart_buffer;
-                                int remain = uart_buffer_pos - consumed;
-                                if (remain > 0) {
-                                    memmove(uart_buffer, uart_buffer + consumed, remain);
-                                    uart_buffer_pos = remain;
-                                    uart_buffer[uart_buffer_pos] = 0;
-                                } else {
-                                    uart_buffer_pos = 0;
-                                    uart_buffer[0] = 0;
-                                }
-                            }
-                            
-                            // === 清理：移除已知的非重要回應 ===
-                            while (1) {
-                                // 清除開頭的空白和換行
-                                while (uart_buffer_pos > 0 && 
-                                       (uart_buffer[0] == '\r' || uart_buffer[0] == '\n' || uart_buffer[0] == ' ')) {
-                                    memmove(uart_buffer, uart_buffer + 1, uart_buffer_pos - 1);
-                                    uart_buffer_pos--;
-                                    uart_buffer[uart_buffer_pos] = 0;
-                                }
-                                
-                                char *ok_str = strstr(uart_buffer, "OK\r\n");
-                                if (ok_str) {
-                                    char *after = ok_str + 4;
-                                    int consumed = after - uart_buffer;
-                                    int remain = uart_buffer_pos - consumed;
-                                    if (remain > 0) {
-                                        memmove(uart_buffer, after, remain);
-                                        uart_buffer_pos = remain;
-                                        uart_buffer[uart_buffer_pos] = 0;
-                                    } else {
-                                        uart_buffer_pos = 0;
-                                        uart_buffer[0] = 0;
-                                    }
-                                    continue;
-                                }
-                                
-                                char *err_str = strstr(uart_buffer, "ERROR\r\n");
-                                if (err_str) {
-                                    char *after = err_str + 7;
-                                    int consumed = after - uart_buffer;
-                                    int remain = uart_buffer_pos - consumed;
-                                    if (remain > 0) {
-                                        memmove(uart_buffer, after, remain);
-                                        uart_buffer_pos = remain;
-                                        uart_buffer[uart_buffer_pos] = 0;
-                                    } else {
-                                        uart_buffer_pos = 0;
-                                        uart_buffer[0] = 0;
-                                    }
-                                    continue;
-                                }
-                                
-                                // 清理 +CPMS 回應等 (AT+CPMS 回應格式: +CPMS: ...)
-                                char *cpms_str = strstr(uart_buffer, "+CPMS:");
-                                if (cpms_str) {
-                                    char *cpms_end = strstr(cpms_str, "\r\n");
-                                    if (cpms_end) {
-                                        char *after = cpms_end + 2;
-                                        int consumed = after - uart_buffer;
-                                        int remain = uart_buffer_pos - consumed;
-                                        if (remain > 0) {
-                                            memmove(uart_buffer, after, remain);
-                                            uart_buffer_pos = remain;
-                                            uart_buffer[uart_buffer_pos] = 0;
-                                        } else {
-                                            uart_buffer_pos = 0;
-                                            uart_buffer[0] = 0;
-                                        }
-                                        continue;
-                                    }
-                                }
-                                
-                                break;
-                            }
-                            
-                            // 防止 buffer 累積過多
-                            if (uart_buffer_pos > 2048) {
-                                ESP_LOGW(TAG, "UART buffer overflow, resetting (%d bytes)", uart_buffer_pos);
-                                uart_buffer_pos = 0;
-                                uart_buffer[0] = 0;
-                            }
-                        } else {
-                            ESP_LOGW(TAG, "UART buffer full, resetting");
-                            uart_buffer_pos = 0;
-                        }
+                    // 沒有行尾的資料留在驅動緩衝等 UART_PATTERN_DET；
+                    // 只有遲遲沒有行尾、快塞滿驅動緩衝時才先搬走
+                    size_t buffered = 0;
+                    uart_get_buffered_data_len(EX_UART_NUM, &buffered);
+                    if (buffered >= UART_RX_DRAIN_LEVEL) {
+                        read_uart_lines(buffered);
                     }
                 }
                 break;
             case UART_FIFO_OVF:
             case UART_BUFFER_FULL:
-                uart_flush_input(EX_UART_NUM);
-                xQueueReset(uart0_queue);
-                uart_buffer_pos = 0;
+                handle_rx_overflow(event.type == UART_FIFO_OVF);
                 break;
             default:
                 break;
             }
         }
     }
-    free(dtmp);
     vTaskDelete(NULL);
 }
 
 void sim_modem_init_uart(void)
 {
     uart_config_t uart_config = {
-        .baud_rate = 115200,
+        .baud_rate = SIM_UART_BAUD,
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
@@ -698,12 +1390,24 @@ void sim_modem_init_uart(void)
     
     ESP_ERROR_CHECK(uart_driver_install(EX_UART_NUM, BUF_SIZE * 2, BUF_SIZE * 2, 20, &uart0_queue, 0));
     ESP_ERROR_CHECK(uart_param_config(EX_UART_NUM, &uart_config));
-    ESP_ERROR_CHECK(uart_set_pin(EX_UART_NUM, TXD_PIN, RXD_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+    ESP_ERROR_CHECK(uart_set_pin(EX_UART_NUM, TXD_PIN, RXD_PIN, SIM_UART_RTS_PIN, SIM_UART_CTS_PIN));
+
+    // 行尾 '\n' 觸發 UART_PATTERN_DET (單一字元，不需要前後閒置時間)
+    ESP_ERROR_CHECK(uart_enable_pattern_det_baud_intr(EX_UART_NUM, '\n', 1, 9, 0, 0));
+    ESP_ERROR_CHECK(uart_pattern_queue_reset(EX_UART_NUM, UART_PATTERN_QUEUE_LEN));
 }
 
 void sim_modem_start_task(void)
 {
-    // 增加 stack 到 8192 (publish_assembled_sms 使用 static combined_msg,
-    // 但 cJSON + pdu_decode call chain 仍需足夠 stack)
-    xTaskCreate(rx_task, "uart_rx_task", 8192, NULL, 5, NULL);
+    sms_assembly_init(&s_assembly);
+    sim_storage_init(&s_storage);
+    spsc_ring_init(&s_records, s_record_buf, sizeof(s_record_buf[0]), SMS_RECORD_RING_LEN);
+    spsc_ring_init(&s_results, s_result_buf, sizeof(s_result_buf[0]), SMS_RESULT_RING_LEN);
+
+    // 發布端先建立：rx_task 第一筆記錄就要通知它
+    xTaskCreatePinnedToCore(publish_task, "sms_publish_task", SIM_PUBLISH_TASK_STACK, NULL,
+                            SIM_PUBLISH_TASK_PRIORITY, &s_publish_task, SIM_PUBLISH_TASK_CORE);
+    // rx_task 不再做 cJSON/文字解碼，stack 只需容納 PDU 解析與 AT 回應處理
+    xTaskCreatePinnedToCore(rx_task, "uart_rx_task", SIM_RX_TASK_STACK, NULL,
+                            SIM_RX_TASK_PRIORITY, NULL, SIM_RX_TASK_CORE);
 }
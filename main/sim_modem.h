@@ -1,7 +1,29 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
 void sim_modem_init_uart(void);
 void sim_modem_start_task(void);
 
 // 當 MQTT 連線建立時呼叫此函式，觸發讀取滯留的簡訊
 void sim_modem_trigger_flush(void);
+
+// SIM 簡訊儲存用量 (來自 AT+CPMS，收到/刪除時即時更新)；尚未查到時回傳 false
+bool sim_modem_get_storage(int *used, int *total);
+
+// 接收端統計：UART 溢位次數與復原動作 (累計自開機)
+typedef struct {
+    uint32_t fifo_overflows;    // 硬體 FIFO 溢位
+    uint32_t buffer_full;       // 驅動環形緩衝滿
+    uint32_t resyncs;           // 剖析器重新對齊行首
+    uint32_t cancelled;         // 因溢位取消的進行中指令
+    uint32_t dropped_lines;     // 超長而丟棄的行
+    uint32_t records_deferred;  // 發布端跟不上、留給補讀的簡訊
+    // 長簡訊組合區塊池 (publish_task 更新)
+    uint16_t assembly_blocks;           // 區塊總數
+    uint16_t assembly_blocks_free_min;  // 開機以來最少的空閒區塊
+    uint32_t assembly_evictions;        // 為騰出空間提早發布的長簡訊
+} sim_modem_rx_stats_t;
+
+void sim_modem_get_rx_stats(sim_modem_rx_stats_t *out);
@@ -0,0 +1,197 @@
+/**
+ * @file sim_storage.c
+ * @brief SIM storage bookkeeping and deletion planner (see header)
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "sim_storage.h"
+
+_Static_assert(SIM_STORAGE_MAX_INDEX % 32 == 0, "SIM_STORAGE_MAX_INDEX must be a multiple of 32");
+
+static bool in_range(const sim_storage_t *st, int index) {
+    return index >= 0 && index < st->words * 32;
+}
+
+static void set_bit(uint32_t *map, int index) {
+    map[index >> 5] |= 1u << (index & 31);
+}
+
+static void clear_bit(uint32_t *map, int index) {
+    map[index >> 5] &= ~(1u << (index & 31));
+}
+
+static bool test_bit(const uint32_t *map, int index) {
+    return (map[index >> 5] >> (index & 31)) & 1u;
+}
+
+static bool map_empty(const sim_storage_t *st, const uint32_t *map) {
+    for (int w = 0; w < st->words; w++) {
+        if (map[w]) return false;
+    }
+    return true;
+}
+
+static size_t map_count(const sim_storage_t *st, const uint32_t *map) {
+    size_t n = 0;
+    for (int w = 0; w < st->words; w++) {
+        for (uint32_t bits = map[w]; bits; bits &= bits - 1) n++;
+    }
+    return n;
+}
+
+/**
+ * @brief @p n messages left the SIM
+ */
+static void note_freed(sim_storage_t *st, size_t n) {
+    if (st->used < 0) return;
+    st->used = (int16_t)((size_t)st->used > n ? (size_t)st->used - n : 0);
+}
+
+void sim_storage_init(sim_storage_t *st) {
+    memset(st, 0, sizeof(*st));
+    st->words = SIM_STORAGE_WORDS;
+    st->used = -1;
+    st->total = -1;
+}
+
+bool sim_storage_mark_read(sim_storage_t *st, int index) {
+    if (!in_range(st, index)) return false;
+    set_bit(st->read, index);
+    return true;
+}
+
+bool sim_storage_mark_queued(sim_storage_t *st, int index) {
+    if (!in_range(st, index)) return false;
+    set_bit(st->queued, index);
+    set_bit(st->read, index);
+    return true;
+}
+
+void sim_storage_unqueue(sim_storage_t *st, int index) {
+    if (in_range(st, index)) clear_bit(st->queued, index);
+}
+
+bool sim_storage_mark_delete(sim_storage_t *st, int index) {
+    if (!in_range(st, index)) return false;
+    // Already on its way out: nothing to add
+    if (!test_bit(st->in_flight, index)) set_bit(st->pending, index);
+    set_bit(st->read, index);
+    return true;
+}
+
+bool sim_storage_is_processed(const sim_storage_t *st, int index) {
+    if (!in_range(st, index)) return false;
+    return test_bit(st->pending, index) || test_bit(st->in_flight, index) ||
+           test_bit(st->queued, index);
+}
+
+size_t sim_storage_pending_count(const sim_storage_t *st) {
+    return map_count(st, st->pending);
+}
+
+/**
+ * @brief True if every read message is already queued for deletion
+ */
+static bool nothing_held(const sim_storage_t *st) {
+    for (int w = 0; w < st->words; w++) {
+        if (st->read[w] & ~(st->pending[w] | st->in_flight[w])) return false;
+    }
+    return true;
+}
+
+void sim_storage_set_enumerated(sim_storage_t *st, bool complete) {
+    st->enumerated = complete;
+}
+
+bool sim_storage_next_delete(sim_storage_t *st, bool modem_idle, int *index, char *cmd, size_t cmd_size) {
+    if (st->bulk_in_flight) return false;
+
+    size_t pending = sim_storage_pending_count(st);
+    if (pending == 0) return false;
+
+    // Everything read can go: AT+CMGD=<any>,1 deletes all read messages in one round trip.
+    // Only from a quiet state, so everything in flight belongs to the bulk command,
+    // and only when no read message on the SIM can be one we have not published
+    if (!st->bulk_unsupported && st->enumerated && modem_idle && pending >= SIM_STORAGE_BULK_MIN &&
+        map_empty(st, st->in_flight) && nothing_held(st)) {
+        for (int w = 0; w < st->words; w++) {
+            st->in_flight[w] |= st->pending[w];
+            st->pending[w] = 0;
+        }
+        st->bulk_in_flight = true;
+        *index = SIM_STORAGE_BULK;
+        snprintf(cmd, cmd_size, "AT+CMGD=1,1");
+        return true;
+    }
+
+    for (int w = 0; w < st->words; w++) {
+        if (st->pending[w] == 0) continue;
+        int i = w * 32;
+        while (!test_bit(st->pending, i)) i++;
+        clear_bit(st->pending, i);
+        set_bit(st->in_flight, i);
+        *index = i;
+        snprintf(cmd, cmd_size, "AT+CMGD=%d", i);
+        return true;
+    }
+    return false;
+}
+
+void sim_storage_delete_done(sim_storage_t *st, int index, sim_delete_status_t status) {
+    if (index == SIM_STORAGE_BULK) {
+        st->bulk_in_flight = false;
+        if (status == SIM_DELETE_OK) {
+            // Only the indices the command covered: anything read since is still unpublished
+            note_freed(st, map_count(st, st->in_flight));
+            for (int w = 0; w < st->words; w++) {
+                st->read[w] &= ~st->in_flight[w];
+                st->in_flight[w] = 0;
+            }
+            st->bulk_deletes++;
+            return;
+        }
+        if (status == SIM_DELETE_FAILED) st->bulk_unsupported = true;
+        for (int w = 0; w < st->words; w++) {
+            st->pending[w] |= st->in_flight[w];
+            st->in_flight[w] = 0;
+        }
+        return;
+    }
+
+    if (!in_range(st, index)) return;
+    clear_bit(st->in_flight, index);
+    if (status == SIM_DELETE_RETRY) {
+        set_bit(st->pending, index);
+        return;
+    }
+    clear_bit(st->read, index);
+    if (status == SIM_DELETE_OK) note_freed(st, 1);
+}
+
+bool sim_storage_parse_cpms(const char *line, int *used, int *total) {
+    if (sscanf(line, "+CPMS: \"%*[^\"]\",%d,%d", used, total) == 2) return true;
+    return sscanf(line, "+CPMS: %d,%d", used, total) == 2;
+}
+
+void sim_storage_set_usage(sim_storage_t *st, int used, int total) {
+    if (total < 0 || used < 0) return;
+
+    // Indices run 1..total on most modules, 0..total-1 on some: cover both
+    int words = (total + 1 + 31) / 32;
+    if (words > SIM_STORAGE_WORDS) words = SIM_STORAGE_WORDS;
+    // Never shrink below an index that is still tracked
+    for (int w = SIM_STORAGE_WORDS - 1; w >= words; w--) {
+        if (st->read[w] | st->pending[w] | st->in_flight[w] | st->queued[w]) {
+            words = w + 1;
+            break;
+        }
+    }
+    st->words = (uint16_t)words;
+    st->total = (int16_t)total;
+    st->used = (int16_t)(used < total ? used : total);
+}
+
+void sim_storage_note_stored(sim_storage_t *st) {
+    if (st->used >= 0 && st->used < st->total) st->used++;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file sim_storage.h
+ * @brief SIM message storage bookkeeping and deletion planner
+ *
+ * Tracks, per SIM index, which messages have been read (decoded) and which
+ * are waiting to be deleted, in fixed bitmaps. The pending-delete set is
+ * deduplicated and never drops an index. A message queued for deletion
+ * counts as processed until the delete completes, so a listing that runs
+ * in between skips it instead of publishing it twice; the state lives
+ * across listings and is cleared only when the index is actually freed.
+ * A message handed to another task for publishing is "queued": it counts as
+ * processed until that task reports back, so it is never read twice.
+ *
+ * sim_storage_next_delete() picks the cheapest command. AT+CMGD=1,1
+ * removes every message the SIM has marked read, including ones this
+ * session never saw, so it is only used when the SIM's whole content is
+ * accounted for: a complete enumeration (sim_storage_set_enumerated())
+ * with nothing lost since, every message read so far waiting for deletion
+ * (nothing unpublished, e.g. a fragment held for reassembly), and no other
+ * command queued ahead of it. Otherwise indices are handed out one by one
+ * for individual AT+CMGD=<idx>, which the caller pipelines back to back.
+ *
+ * Storage usage from +CPMS bounds the scans to the card's capacity and is
+ * kept up to date as messages arrive and are deleted.
+ *
+ * Pure C with no ESP-IDF dependencies; host tested.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIM_STORAGE_MAX_INDEX   256     // Indices 0..255 (SIM cards hold far fewer)
+#define SIM_STORAGE_BULK_MIN    2       // Fewer pending deletes than this go out individually
+#define SIM_STORAGE_BULK        (-1)    // Index of a bulk delete
+
+#define SIM_STORAGE_WORDS       (SIM_STORAGE_MAX_INDEX / 32)
+
+typedef enum {
+    SIM_DELETE_OK = 0,          // Gone from the SIM
+    SIM_DELETE_FAILED,          // Rejected; not retried (a bulk reject disables bulk deletes)
+    SIM_DELETE_RETRY,           // No answer; back to pending
+} sim_delete_status_t;
+
+typedef struct {
+    uint32_t read[SIM_STORAGE_WORDS];       // Decoded from the SIM, still stored there
+    uint32_t pending[SIM_STORAGE_WORDS];    // Processed, waiting for a delete command
+    uint32_t in_flight[SIM_STORAGE_WORDS];  // Processed, delete command submitted
+    uint32_t queued[SIM_STORAGE_WORDS];     // Read, handed to the publisher, no outcome yet
+    uint16_t words;                         // Bitmap words in use (from the capacity)
+    int16_t used;                           // Messages stored, -1 until known
+    int16_t total;                          // Capacity, -1 until known
+    bool enumerated;                        // Every stored message has been read this session
+    bool bulk_in_flight;
+    bool bulk_unsupported;                  // Modem rejected AT+CMGD=<idx>,1
+    uint32_t bulk_deletes;                  // Bulk commands that succeeded
+} sim_storage_t;
+
+void sim_storage_init(sim_storage_t *st);
+
+/**
+ * @brief Note that the message at @p index has been read from the SIM
+ * @return false if @p index is out of range
+ */
+bool sim_storage_mark_read(sim_storage_t *st, int index);
+
+/**
+ * @brief Note that @p index was read and handed over for publishing
+ *
+ * Counts as processed until sim_storage_unqueue(); stays read afterwards.
+ * @return false if @p index is out of range
+ */
+bool sim_storage_mark_queued(sim_storage_t *st, int index);
+
+/**
+ * @brief The publisher is done with @p index (published or not)
+ */
+void sim_storage_unqueue(sim_storage_t *st, int index);
+
+/**
+ * @brief Mark @p index processed and queue it for deletion (idempotent)
+ * @return false if @p index is out of range
+ */
+bool sim_storage_mark_delete(sim_storage_t *st, int index);
+
+/**
+ * @brief True if @p index was processed and has not been freed yet (O(1))
+ */
+bool sim_storage_is_processed(const sim_storage_t *st, int index);
+
+/**
+ * @brief Plan the next delete command and move its indices in flight
+ *
+ * @param modem_idle No other command is queued or on the wire (a bulk delete
+ *                   must not run after a read that is still pending)
+ * @param index      Set to the SIM index, or SIM_STORAGE_BULK
+ * @param cmd        Receives the command text
+ * @return false if there is nothing to delete (or a bulk delete is in flight)
+ */
+bool sim_storage_next_delete(sim_storage_t *st, bool modem_idle, int *index, char *cmd, size_t cmd_size);
+
+/**
+ * @brief Whether every message on the SIM is known to this session
+ *
+ * Set after a listing or drain that covered the whole SIM and lost nothing;
+ * cleared when one starts, or when input that may have carried a message
+ * was lost (UART overflow, unpublished hand-over). Bulk deletes need it.
+ */
+void sim_storage_set_enumerated(sim_storage_t *st, bool complete);
+
+/**
+ * @brief Record the outcome of a command from sim_storage_next_delete()
+ */
+void sim_storage_delete_done(sim_storage_t *st, int index, sim_delete_status_t status);
+
+/**
+ * @brief Number of indices waiting for a delete command
+ */
+size_t sim_storage_pending_count(const sim_storage_t *st);
+
+/**
+ * @brief Parse the first storage's usage from a +CPMS response line
+ *
+ * Accepts the query form (+CPMS: "SM",3,30,...) and the set form
+ * (+CPMS: 3,30,...).
+ */
+bool sim_storage_parse_cpms(const char *line, int *used, int *total);
+
+/**
+ * @brief Record usage reported by the modem; the capacity sizes the bitmaps
+ */
+void sim_storage_set_usage(sim_storage_t *st, int used, int total);
+
+/**
+ * @brief A new message was stored (+CMTI)
+ */
+void sim_storage_note_stored(sim_storage_t *st);
@@ -0,0 +1,308 @@
+/**
+ * @file sms_assembly.c
+ * @brief Concatenated SMS reassembly (see header)
+ */
+
+#include <string.h>
+#include "sms_assembly.h"
+#include "sms_codec.h"
+#include "esp_log.h"
+
+static const char *TAG = "SMS_ASSEMBLY";
+
+_Static_assert(SMS_ASSEMBLY_POOL_BLOCKS < SMS_ASSEMBLY_NO_BLOCK, "Block indices are 8-bit");
+
+void sms_assembly_init(sms_assembly_t *as) {
+    memset(as->slots, 0, sizeof(as->slots));
+    for (int i = 0; i < SMS_ASSEMBLY_POOL_BLOCKS; i++) {
+        as->pool[i].next = (uint8_t)(i + 1 < SMS_ASSEMBLY_POOL_BLOCKS ? i + 1 : SMS_ASSEMBLY_NO_BLOCK);
+    }
+    as->free_block = 0;
+    as->blocks_free = SMS_ASSEMBLY_POOL_BLOCKS;
+    as->blocks_free_min = SMS_ASSEMBLY_POOL_BLOCKS;
+    as->evictions = 0;
+}
+
+static bool has_part(const sms_assembly_slot_t *slot, int part_num) {
+    return (slot->part_map[part_num >> 5] >> (part_num & 31)) & 1u;
+}
+
+static sms_assembly_slot_t *find_slot(sms_assembly_t *as, const char *sender, uint16_t ref_num) {
+    for (int i = 0; i < SMS_ASSEMBLY_SLOTS; i++) {
+        sms_assembly_slot_t *slot = &as->slots[i];
+        if (slot->active && slot->ref_num == ref_num && strcmp(slot->sender, sender) == 0) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+static sms_assembly_slot_t *oldest_slot(sms_assembly_t *as) {
+    sms_assembly_slot_t *oldest = NULL;
+    for (int i = 0; i < SMS_ASSEMBLY_SLOTS; i++) {
+        sms_assembly_slot_t *slot = &as->slots[i];
+        if (slot->active && (!oldest || slot->first_fragment_time < oldest->first_fragment_time)) {
+            oldest = slot;
+        }
+    }
+    return oldest;
+}
+
+static sms_assembly_slot_t *claim_slot(sms_assembly_t *as, const char *sender, uint16_t ref_num,
+                                       uint8_t total_parts, int64_t now_ms) {
+    for (int i = 0; i < SMS_ASSEMBLY_SLOTS; i++) {
+        sms_assembly_slot_t *slot = &as->slots[i];
+        if (slot->active) continue;
+
+        memset(slot, 0, sizeof(*slot));
+        slot->active = true;
+        slot->ref_num = ref_num;
+        slot->total_parts = total_parts;
+        slot->first_fragment_time = now_ms;
+        slot->first_block = SMS_ASSEMBLY_NO_BLOCK;
+        strncpy(slot->sender, sender, sizeof(slot->sender) - 1);
+        ESP_LOGI(TAG, "Created assembly buffer for ref=%d, total=%d", ref_num, total_parts);
+        return slot;
+    }
+    return NULL;
+}
+
+/**
+ * @brief No room for this part: name the oldest message for eviction
+ */
+static sms_assembly_result_t evict(sms_assembly_t *as, sms_assembly_slot_t **slot) {
+    *slot = oldest_slot(as);
+    as->evictions++;
+    ESP_LOGW(TAG, "Assembly %s exhausted, evicting ref=%d (%d/%d parts)",
+             as->blocks_free == 0 ? "pool" : "slots",
+             (*slot)->ref_num, (*slot)->received_parts, (*slot)->total_parts);
+    return SMS_ASSEMBLY_EVICT;
+}
+
+/**
+ * @brief Take a block off the free list and link it into the slot in part order
+ */
+static sms_assembly_part_t *alloc_part(sms_assembly_t *as, sms_assembly_slot_t *slot, uint8_t part_num) {
+    uint8_t b = as->free_block;
+    sms_assembly_part_t *part = &as->pool[b];
+    as->free_block = part->next;
+    as->blocks_free--;
+    if (as->blocks_free < as->blocks_free_min) as->blocks_free_min = as->blocks_free;
+
+    uint8_t *link = &slot->first_block;
+    while (*link != SMS_ASSEMBLY_NO_BLOCK && as->pool[*link].part_num < part_num) {
+        link = &as->pool[*link].next;
+    }
+    part->part_num = part_num;
+    part->next = *link;
+    *link = b;
+    return part;
+}
+
+sms_assembly_result_t sms_assembly_add(sms_assembly_t *as, const char *sender,
+                                       const pdu_sms_view_t *view, int sim_index,
+                                       int64_t now_ms, sms_assembly_slot_t **slot) {
+    *slot = NULL;
+    // Checked before anything is stored: part_num indexes part_map
+    if (!view->is_multipart || view->part_num == 0 || view->part_num > view->total_parts) {
+        return SMS_ASSEMBLY_INVALID;
+    }
+
+    sms_assembly_slot_t *s = find_slot(as, sender, view->ref_num);
+    if (s && view->part_num > s->total_parts) return SMS_ASSEMBLY_INVALID;
+    if (s && has_part(s, view->part_num)) {
+        *slot = s;
+        return SMS_ASSEMBLY_DUPLICATE;
+    }
+    // Check both before claiming, so an eviction never leaves an empty slot behind
+    if (as->blocks_free == 0) return evict(as, slot);
+    if (!s) {
+        s = claim_slot(as, sender, view->ref_num, view->total_parts, now_ms);
+        if (!s) return evict(as, slot);
+    }
+    *slot = s;
+
+    // Keep the user data as it came off the air; decoding waits for the rest
+    pdu_payload_t payload;
+    pdu_view_payload(view, &payload);
+
+    sms_assembly_part_t *part = alloc_part(as, s, view->part_num);
+    size_t len = payload.len;
+    size_t units = payload.units;
+    size_t max_units = payload.ucs2 ? SMS_ASSEMBLY_PART_OCTETS : SMS_ASSEMBLY_PART_SEPTETS;
+    if (len > SMS_ASSEMBLY_PART_OCTETS || units > max_units) {
+        ESP_LOGW(TAG, "Fragment %d for ref=%d too long, cutting", view->part_num, view->ref_num);
+        if (len > SMS_ASSEMBLY_PART_OCTETS) len = SMS_ASSEMBLY_PART_OCTETS;
+        if (units > max_units) units = max_units;
+        s->truncated = true;
+    }
+    memcpy(part->data, payload.data, len);
+    part->len = (uint8_t)len;
+    part->units = (uint8_t)units;
+    part->fill_bits = payload.fill_bits;
+    part->ucs2 = payload.ucs2;
+    part->nl_locking = view->nl_locking;
+    part->nl_single = view->nl_single;
+    part->sim_index = sim_index;
+
+    s->part_map[view->part_num >> 5] |= 1u << (view->part_num & 31);
+    s->received_parts++;
+
+    return s->received_parts >= s->total_parts ? SMS_ASSEMBLY_COMPLETE : SMS_ASSEMBLY_STORED;
+}
+
+sms_assembly_slot_t *sms_assembly_expired(sms_assembly_t *as, int64_t now_ms, int64_t timeout_ms) {
+    for (int i = 0; i < SMS_ASSEMBLY_SLOTS; i++) {
+        sms_assembly_slot_t *slot = &as->slots[i];
+        if (slot->active && (now_ms - slot->first_fragment_time) > timeout_ms) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+const sms_assembly_part_t *sms_assembly_first_part(const sms_assembly_t *as,
+                                                   const sms_assembly_slot_t *slot) {
+    return slot->first_block == SMS_ASSEMBLY_NO_BLOCK ? NULL : &as->pool[slot->first_block];
+}
+
+const sms_assembly_part_t *sms_assembly_next_part(const sms_assembly_t *as,
+                                                  const sms_assembly_part_t *part) {
+    return part->next == SMS_ASSEMBLY_NO_BLOCK ? NULL : &as->pool[part->next];
+}
+
+const sms_assembly_part_t *sms_assembly_part(const sms_assembly_t *as,
+                                             const sms_assembly_slot_t *slot, int part_num) {
+    if (part_num < 1 || part_num > SMS_ASSEMBLY_MAX_PARTS || !has_part(slot, part_num)) return NULL;
+    const sms_assembly_part_t *part = sms_assembly_first_part(as, slot);
+    while (part->part_num != part_num) part = sms_assembly_next_part(as, part);
+    return part;
+}
+
+/**
+ * @brief Parts that can be joined into one decode run
+ */
+static bool same_run(const sms_assembly_part_t *a, const sms_assembly_part_t *b) {
+    return a->ucs2 == b->ucs2 && a->nl_locking == b->nl_locking && a->nl_single == b->nl_single;
+}
+
+/**
+ * @brief Convert @p n joined units in @p fmt's encoding and hand them to the sink
+ * @return false if the sink asked to stop
+ */
+static bool emit_units(sms_assembly_t *as, const sms_assembly_part_t *fmt, size_t n,
+                       sms_assembly_sink_fn sink, void *ctx, size_t *total) {
+    // text[] holds the worst case (see SMS_ASSEMBLY_CHUNK_TEXT), so nothing is cut here
+    size_t len;
+    if (fmt->ucs2) {
+        len = ucs2_to_utf8(as->joined, n, as->text, sizeof(as->text));
+    } else {
+        len = gsm7_to_utf8_lang(as->joined, n, fmt->nl_locking, fmt->nl_single,
+                                as->text, sizeof(as->text));
+    }
+    if (len == 0) return true;
+    if (!sink(as->text, len, ctx)) return false;
+    *total += len;
+    return true;
+}
+
+/**
+ * @brief Units at the end of a chunk that only decode with what follows
+ *
+ * A GSM 7-bit escape, or an odd UCS2 octet / high surrogate.
+ */
+static size_t held_back(const sms_assembly_part_t *fmt, const uint8_t *units, size_t n) {
+    if (n == 0) return 0;
+    if (!fmt->ucs2) return units[n - 1] == 0x1B ? 1 : 0;
+    if (n & 1) return 1;
+    return (units[n - 2] & 0xFC) == 0xD8 ? 2 : 0;
+}
+
+size_t sms_assembly_text_stream(sms_assembly_t *as, const sms_assembly_slot_t *slot,
+                                sms_assembly_sink_fn sink, void *ctx, bool *truncated) {
+    bool go = true;
+    size_t total = 0;
+    size_t n = 0;                               // Units waiting in joined[]
+    const sms_assembly_part_t *first = NULL;    // Encoding of the current run
+    int prev = 0;
+
+    for (const sms_assembly_part_t *part = sms_assembly_first_part(as, slot); go;
+         part = sms_assembly_next_part(as, part)) {
+        if (part && part->part_num > slot->total_parts) part = NULL;
+
+        // A gap (missing part) or a change of encoding ends the run
+        if (first && (!part || part->part_num != prev + 1 || !same_run(first, part))) {
+            go = emit_units(as, first, n, sink, ctx, &total);
+            n = 0;
+            first = NULL;
+        }
+        if (!part || !go) break;
+        if (!first) first = part;
+
+        // Chunk full: decode it, keeping a split escape/surrogate for the next one
+        if (n + SMS_ASSEMBLY_PART_SEPTETS > sizeof(as->joined)) {
+            size_t keep = held_back(first, as->joined, n);
+            go = emit_units(as, first, n - keep, sink, ctx, &total);
+            memmove(as->joined, as->joined + n - keep, keep);
+            n = keep;
+        }
+        if (part->ucs2) {
+            memcpy(as->joined + n, part->data, part->units);
+            n += part->units;
+        } else {
+            n += gsm7_unpack(part->data, part->len, part->fill_bits, as->joined + n, part->units);
+        }
+        prev = part->part_num;
+    }
+
+    if (truncated) *truncated = slot->truncated || !go;
+    return total;
+}
+
+typedef struct {
+    char *out;
+    size_t size;
+    size_t len;
+} text_buf_t;
+
+static bool append_text(const char *text, size_t len, void *ctx) {
+    text_buf_t *buf = ctx;
+    size_t room = buf->size - 1 - buf->len;
+    size_t take = len < room ? len : room;
+
+    // Never end on half a UTF-8 sequence
+    if (take < len) {
+        while (take > 0 && ((uint8_t)text[take] & 0xC0) == 0x80) take--;
+    }
+    memcpy(buf->out + buf->len, text, take);
+    buf->len += take;
+    buf->out[buf->len] = '\0';
+    return take == len;
+}
+
+size_t sms_assembly_text(sms_assembly_t *as, const sms_assembly_slot_t *slot,
+                         char *out, size_t out_size, bool *truncated) {
+    text_buf_t buf = { out, out_size, 0 };
+
+    if (out_size == 0) {
+        if (truncated) *truncated = true;
+        return 0;
+    }
+    out[0] = '\0';
+    sms_assembly_text_stream(as, slot, append_text, &buf, truncated);
+    return buf.len;
+}
+
+void sms_assembly_release(sms_assembly_t *as, sms_assembly_slot_t *slot) {
+    // Hand the blocks back, then forget the message
+    uint8_t b = slot->first_block;
+    while (slot->active && b != SMS_ASSEMBLY_NO_BLOCK) {
+        uint8_t next = as->pool[b].next;
+        as->pool[b].next = as->free_block;
+        as->free_block = b;
+        as->blocks_free++;
+        b = next;
+    }
+    memset(slot, 0, sizeof(*slot));
+    slot->first_block = SMS_ASSEMBLY_NO_BLOCK;
+}
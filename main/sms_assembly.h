@@ -0,0 +1,185 @@
+/**
+ * @file sms_assembly.h
+ * @brief Concatenated SMS reassembly from raw user data
+ *
+ * Each part keeps its user-data bytes exactly as received (UDH stripped)
+ * and the text is decoded once over the joined payload when the message is
+ * complete or has timed out. A UCS2 surrogate pair or GSM 7-bit escape
+ * that the sender split across two parts therefore decodes correctly.
+ *
+ * Part payloads live in one fixed pool of blocks shared by every message
+ * being assembled; a message holds only the blocks of the parts that have
+ * arrived (linked in part order) plus a bitmap of which parts it has, so
+ * one long message or many short ones fit in the same RAM. When no slot
+ * or block is left, the add call names the oldest message as the victim
+ * instead of overwriting it: the caller publishes what it has, releases it
+ * and adds again (SMS_ASSEMBLY_EVICT); evictions and the pool's low-water
+ * mark are counted. A message with more parts than the pool holds (the UDH
+ * field allows 255) therefore goes out in pieces the same way.
+ *
+ * The text is decoded a bounded chunk at a time and handed to a sink
+ * (sms_assembly_text_stream()), so no buffer is sized for the longest
+ * message.
+ *
+ * Free of ESP-IDF / FreeRTOS dependencies (time is passed in) so it can be
+ * unit tested on the host; publishing and SIM deletion stay in sim_modem.c.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pdu_decoder.h"
+
+#define SMS_ASSEMBLY_MAX_PARTS      255     // Parts per message (8-bit UDH field)
+#define SMS_ASSEMBLY_PART_OCTETS    140     // UD is at most 140 octets (UDH included)
+#define SMS_ASSEMBLY_PART_SEPTETS   160     // ... which holds at most 160 septets
+#define SMS_ASSEMBLY_SLOTS          8       // Messages assembled at once
+#define SMS_ASSEMBLY_POOL_BLOCKS    40      // Parts held at once, across all messages
+#define SMS_ASSEMBLY_JOIN_PARTS     4       // Parts decoded per converter call
+
+#define SMS_ASSEMBLY_MAP_WORDS      ((SMS_ASSEMBLY_MAX_PARTS + 1 + 31) / 32)
+#define SMS_ASSEMBLY_NO_BLOCK       0xFF
+
+/** Decoded text of one converter call: 3 UTF-8 bytes per septet (locking
+ *  shift), plus the converter headroom */
+#define SMS_ASSEMBLY_CHUNK_TEXT     (SMS_ASSEMBLY_JOIN_PARTS * SMS_ASSEMBLY_PART_SEPTETS * 3 + 5)
+
+/**
+ * @brief One pool block: a stored part's raw user data, UDH stripped
+ */
+typedef struct {
+    int sim_index;                          // SIM storage index (for AT+CMGD)
+    uint8_t part_num;
+    uint8_t next;                           // Next part of the message, or next free block
+    uint8_t len;                            // Octets in data
+    uint8_t units;                          // Septets (GSM 7-bit) or octets (UCS2)
+    uint8_t fill_bits;                      // GSM 7-bit: padding before the first septet
+    bool ucs2;
+    uint8_t nl_locking;                     // National language shift IDs of this part
+    uint8_t nl_single;
+    uint8_t data[SMS_ASSEMBLY_PART_OCTETS];
+} sms_assembly_part_t;
+
+/**
+ * @brief One message being reassembled (sender + reference number)
+ */
+typedef struct {
+    char sender[PDU_MAX_SENDER_LEN];
+    uint16_t ref_num;                       // Concatenation reference number
+    uint8_t total_parts;
+    uint8_t received_parts;
+    bool active;
+    bool truncated;                         // A part's UD was cut to fit data[]
+    uint8_t first_block;                    // Parts held, ascending part_num
+    int64_t first_fragment_time;
+    uint32_t part_map[SMS_ASSEMBLY_MAP_WORDS];  // Bit n set: part n held
+} sms_assembly_slot_t;
+
+typedef struct {
+    sms_assembly_slot_t slots[SMS_ASSEMBLY_SLOTS];
+    sms_assembly_part_t pool[SMS_ASSEMBLY_POOL_BLOCKS];
+    uint8_t free_block;                     // Free list head
+    uint16_t blocks_free;
+    uint16_t blocks_free_min;               // Low-water mark since init
+    uint32_t evictions;                     // Messages given up early to make room
+    // Joined payload of one converter call: septets or UCS2 octets
+    uint8_t joined[SMS_ASSEMBLY_JOIN_PARTS * SMS_ASSEMBLY_PART_SEPTETS];
+    char text[SMS_ASSEMBLY_CHUNK_TEXT];     // ... and its UTF-8, handed to the sink
+} sms_assembly_t;
+
+typedef enum {
+    SMS_ASSEMBLY_STORED,        // Part kept, message still incomplete
+    SMS_ASSEMBLY_COMPLETE,      // Part kept and every part is now present
+    SMS_ASSEMBLY_DUPLICATE,     // That part is already held; nothing changed
+    SMS_ASSEMBLY_INVALID,       // Not multipart, or part number out of range
+    SMS_ASSEMBLY_EVICT,         // No room: nothing kept, *slot is the oldest message to give up
+} sms_assembly_result_t;
+
+void sms_assembly_init(sms_assembly_t *as);
+
+/**
+ * @brief Copy one part's raw user data into its message's slot
+ *
+ * Finds the slot for (sender, ref_num) or claims a free one and takes a
+ * block from the pool. Nothing is decoded here.
+ *
+ * With every slot busy (new message) or the pool empty, nothing is stored
+ * and SMS_ASSEMBLY_EVICT returns the oldest message in @p slot, which may
+ * be the one this part belongs to. The caller publishes it as it stands,
+ * calls sms_assembly_release() and adds the part again.
+ *
+ * @param sender    Decoded sender (identifies the message with ref_num)
+ * @param view      Parsed multipart PDU
+ * @param sim_index SIM storage index of this part
+ * @param now_ms    Current time, starts the timeout of a new slot
+ * @param slot      Output, the slot the part belongs to (NULL if INVALID,
+ *                  the victim if EVICT)
+ */
+sms_assembly_result_t sms_assembly_add(sms_assembly_t *as, const char *sender,
+                                       const pdu_sms_view_t *view, int sim_index,
+                                       int64_t now_ms, sms_assembly_slot_t **slot);
+
+/**
+ * @brief Next active slot older than @p timeout_ms, or NULL
+ */
+sms_assembly_slot_t *sms_assembly_expired(sms_assembly_t *as, int64_t now_ms, int64_t timeout_ms);
+
+/**
+ * @brief First part held by @p slot (lowest part number), or NULL
+ */
+const sms_assembly_part_t *sms_assembly_first_part(const sms_assembly_t *as,
+                                                   const sms_assembly_slot_t *slot);
+
+/**
+ * @brief Part held after @p part in part-number order, or NULL
+ */
+const sms_assembly_part_t *sms_assembly_next_part(const sms_assembly_t *as,
+                                                  const sms_assembly_part_t *part);
+
+/**
+ * @brief Part @p part_num of @p slot, or NULL if it has not arrived
+ */
+const sms_assembly_part_t *sms_assembly_part(const sms_assembly_t *as,
+                                             const sms_assembly_slot_t *slot, int part_num);
+
+/**
+ * @brief Receives the next piece of a message's UTF-8 text (not NUL-terminated)
+ * @return false to stop decoding; the text is then reported truncated
+ */
+typedef bool (*sms_assembly_sink_fn)(const char *text, size_t len, void *ctx);
+
+/**
+ * @brief Decode the received parts of a slot, in order, to UTF-8 pieces
+ *
+ * Consecutive parts with the same encoding are decoded as one run, a
+ * bounded chunk at a time; an escape or high surrogate at the end of a
+ * chunk is carried into the next one. A missing part (timeout) or a
+ * change of encoding starts a new run. Each chunk's text (at most
+ * SMS_ASSEMBLY_CHUNK_TEXT bytes, whole characters only) goes to @p sink
+ * as soon as it is decoded.
+ *
+ * @param truncated Set when the sink stopped early or a part was cut when
+ *                  stored (may be NULL)
+ * @return Number of bytes the sink took
+ */
+size_t sms_assembly_text_stream(sms_assembly_t *as, const sms_assembly_slot_t *slot,
+                                sms_assembly_sink_fn sink, void *ctx, bool *truncated);
+
+/**
+ * @brief sms_assembly_text_stream() into one buffer
+ *
+ * @param out       Output buffer (always NUL-terminated when out_size > 0);
+ *                  text that does not fit is cut at a character boundary
+ * @param truncated Set when the text did not fit in @p out, or a part was
+ *                  cut when stored (may be NULL)
+ * @return Number of bytes written, excluding the terminator
+ */
+size_t sms_assembly_text(sms_assembly_t *as, const sms_assembly_slot_t *slot,
+                         char *out, size_t out_size, bool *truncated);
+
+/**
+ * @brief Free a slot and its blocks after it was published (or given up)
+ */
+void sms_assembly_release(sms_assembly_t *as, sms_assembly_slot_t *slot);
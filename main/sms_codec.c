@@ -0,0 +1,361 @@
+/**
+ * @file sms_codec.c
+ * @brief SMS user-data codecs (see header)
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "sms_codec.h"
+
+// --- GSM 7-bit unpacking ---
+
+static inline uint64_t load_le64(const uint8_t *p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+static inline void store_le64(uint8_t *p, uint64_t w) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    w = __builtin_bswap64(w);
+#endif
+    memcpy(p, &w, sizeof(w));
+}
+
+static inline void store_le32(uint8_t *p, uint32_t w) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    w = __builtin_bswap32(w);
+#endif
+    memcpy(p, &w, sizeof(w));
+}
+
+/**
+ * @brief Spread the low 56 bits of w into 8 septets, one per byte
+ *
+ * 56 -> 2 x 28 -> 4 x 14 -> 8 x 7: each step moves the upper half of every
+ * field left so it starts on the next wider boundary.
+ */
+static inline uint64_t spread_septets(uint64_t w) {
+    w = (w & 0x000000000FFFFFFFULL) | ((w & 0x00FFFFFFF0000000ULL) << 4);
+    w = (w & 0x00003FFF00003FFFULL) | ((w & 0x0FFFC0000FFFC000ULL) << 2);
+    w = (w & 0x007F007F007F007FULL) | ((w & 0x3F803F803F803F80ULL) << 1);
+    return w;
+}
+
+size_t gsm7_unpack(const uint8_t *packed, size_t packed_len, unsigned bit_offset,
+                   uint8_t *septets, size_t num_septets) {
+    bit_offset &= 7;
+
+    // Never read beyond the septets the packed octets can actually hold
+    size_t avail = (packed_len * 8 > bit_offset) ? (packed_len * 8 - bit_offset) / 7 : 0;
+    if (num_septets > avail) num_septets = avail;
+
+    size_t k = 0;
+    size_t byte = 0;
+
+    // Bulk: 8 septets (56 bits) from the 8 octets at 7 * group, shifted by
+    // the fill bits. Needs the 8th octet only when bit_offset > 0, but
+    // requiring it keeps the load a single unconditional 64-bit read.
+    while (k + 8 <= num_septets && byte + 8 <= packed_len) {
+        uint64_t w = load_le64(packed + byte) >> bit_offset;
+        store_le64(septets + k, spread_septets(w));
+        k += 8;
+        byte += 7;
+    }
+
+    // Tail: per-septet extraction for the last (< 8) septets
+    for (; k < num_septets; k++) {
+        size_t bit_pos = bit_offset + k * 7;
+        size_t byte_idx = bit_pos / 8;
+        unsigned shift = bit_pos % 8;
+        unsigned v = packed[byte_idx] >> shift;
+        if (shift > 1 && byte_idx + 1 < packed_len) {
+            v |= (unsigned)packed[byte_idx + 1] << (8 - shift);
+        }
+        septets[k] = (uint8_t)(v & 0x7F);
+    }
+
+    return num_septets;
+}
+
+// --- GSM 03.38 -> UTF-8 ---
+
+// Each entry packs the UTF-8 bytes of one code point (bits 0-23, first byte
+// lowest) and its length (bits 24-25). Entries are built from code points by
+// the preprocessor, so the table is a plain constant in flash and the decode
+// loop needs no per-character branch chain.
+#define U8_LEN(cp)   ((cp) < 0x80 ? 1u : (cp) < 0x800 ? 2u : 3u)
+#define U8_BYTES(cp) ((cp) < 0x80  ? (uint32_t)(cp) :                              \
+                      (cp) < 0x800 ? ((0xC0u | ((cp) >> 6)) |                      \
+                                      ((0x80u | ((cp) & 0x3F)) << 8)) :            \
+                                     ((0xE0u | ((cp) >> 12)) |                     \
+                                      ((0x80u | (((cp) >> 6) & 0x3F)) << 8) |      \
+                                      ((0x80u | ((cp) & 0x3F)) << 16)))
+#define G(cp)        (U8_BYTES(cp) | (U8_LEN(cp) << 24))
+#define GSM7_ESC     0u   // 0x1B: never emitted, the decode loop switches to the extension table
+
+static const uint32_t gsm7_utf8[2][128] = {
+    // Basic character set
+    {
+        G(0x0040), G(0x00A3), G(0x0024), G(0x00A5), G(0x00E8), G(0x00E9), G(0x00F9), G(0x00EC),
+        G(0x00F2), G(0x00C7), G(0x000A), G(0x00D8), G(0x00F8), G(0x000D), G(0x00C5), G(0x00E5),
+        G(0x0394), G(0x005F), G(0x03A6), G(0x0393), G(0x039B), G(0x03A9), G(0x03A0), G(0x03A8),
+        G(0x03A3), G(0x0398), G(0x039E), GSM7_ESC,  G(0x00C6), G(0x00E6), G(0x00DF), G(0x00C9),
+        G(0x0020), G(0x0021), G(0x0022), G(0x0023), G(0x00A4), G(0x0025), G(0x0026), G(0x0027),
+        G(0x0028), G(0x0029), G(0x002A), G(0x002B), G(0x002C), G(0x002D), G(0x002E), G(0x002F),
+        G(0x0030), G(0x0031), G(0x0032), G(0x0033), G(0x0034), G(0x0035), G(0x0036), G(0x0037),
+        G(0x0038), G(0x0039), G(0x003A), G(0x003B), G(0x003C), G(0x003D), G(0x003E), G(0x003F),
+        G(0x00A1), G(0x0041), G(0x0042), G(0x0043), G(0x0044), G(0x0045), G(0x0046), G(0x0047),
+        G(0x0048), G(0x0049), G(0x004A), G(0x004B), G(0x004C), G(0x004D), G(0x004E), G(0x004F),
+        G(0x0050), G(0x0051), G(0x0052), G(0x0053), G(0x0054), G(0x0055), G(0x0056), G(0x0057),
+        G(0x0058), G(0x0059), G(0x005A), G(0x00C4), G(0x00D6), G(0x00D1), G(0x00DC), G(0x00A7),
+        G(0x00BF), G(0x0061), G(0x0062), G(0x0063), G(0x0064), G(0x0065), G(0x0066), G(0x0067),
+        G(0x0068), G(0x0069), G(0x006A), G(0x006B), G(0x006C), G(0x006D), G(0x006E), G(0x006F),
+        G(0x0070), G(0x0071), G(0x0072), G(0x0073), G(0x0074), G(0x0075), G(0x0076), G(0x0077),
+        G(0x0078), G(0x0079), G(0x007A), G(0x00E4), G(0x00F6), G(0x00F1), G(0x00FC), G(0x00E0),
+    },
+    // Extension table (after 0x1B). Unassigned codes repeat the basic
+    // character; 1B 1B (reserved for a further table) shows as a space.
+    {
+        G(0x0040), G(0x00A3), G(0x0024), G(0x00A5), G(0x00E8), G(0x00E9), G(0x00F9), G(0x00EC),
+        G(0x00F2), G(0x00C7), G(0x000C), G(0x00D8), G(0x00F8), G(0x000D), G(0x00C5), G(0x00E5),
+        G(0x0394), G(0x005F), G(0x03A6), G(0x0393), G(0x005E), G(0x03A9), G(0x03A0), G(0x03A8),
+        G(0x03A3), G(0x0398), G(0x039E), G(0x0020), G(0x00C6), G(0x00E6), G(0x00DF), G(0x00C9),
+        G(0x0020), G(0x0021), G(0x0022), G(0x0023), G(0x00A4), G(0x0025), G(0x0026), G(0x0027),
+        G(0x007B), G(0x007D), G(0x002A), G(0x002B), G(0x002C), G(0x002D), G(0x002E), G(0x005C),
+        G(0x0030), G(0x0031), G(0x0032), G(0x0033), G(0x0034), G(0x0035), G(0x0036), G(0x0037),
+        G(0x0038), G(0x0039), G(0x003A), G(0x003B), G(0x005B), G(0x007E), G(0x005D), G(0x003F),
+        G(0x007C), G(0x0041), G(0x0042), G(0x0043), G(0x0044), G(0x0045), G(0x0046), G(0x0047),
+        G(0x0048), G(0x0049), G(0x004A), G(0x004B), G(0x004C), G(0x004D), G(0x004E), G(0x004F),
+        G(0x0050), G(0x0051), G(0x0052), G(0x0053), G(0x0054), G(0x0055), G(0x0056), G(0x0057),
+        G(0x0058), G(0x0059), G(0x005A), G(0x00C4), G(0x00D6), G(0x00D1), G(0x00DC), G(0x00A7),
+        G(0x00BF), G(0x0061), G(0x0062), G(0x0063), G(0x0064), G(0x20AC), G(0x0066), G(0x0067),
+        G(0x0068), G(0x0069), G(0x006A), G(0x006B), G(0x006C), G(0x006D), G(0x006E), G(0x006F),
+        G(0x0070), G(0x0071), G(0x0072), G(0x0073), G(0x0074), G(0x0075), G(0x0076), G(0x0077),
+        G(0x0078), G(0x0079), G(0x007A), G(0x00E4), G(0x00F6), G(0x00F1), G(0x00FC), G(0x00E0),
+    },
+};
+
+// National language tables (3GPP TS 23.038 A.2 / A.3), selected by the UDH
+// shift IEs (0x24 locking, 0x25 single). Only the languages below are
+// carried; any other ID falls back to the default tables, which is what a
+// phone without that language does.
+
+// Turkish locking shift: replaces the basic set
+static const uint32_t gsm7_turkish_locking[128] = {
+    G(0x0040), G(0x00A3), G(0x0024), G(0x00A5), G(0x20AC), G(0x00E9), G(0x00F9), G(0x0131),
+    G(0x00F2), G(0x00C7), G(0x000A), G(0x011E), G(0x011F), G(0x000D), G(0x00C5), G(0x00E5),
+    G(0x0394), G(0x005F), G(0x03A6), G(0x0393), G(0x039B), G(0x03A9), G(0x03A0), G(0x03A8),
+    G(0x03A3), G(0x0398), G(0x039E), GSM7_ESC,  G(0x015E), G(0x015F), G(0x00DF), G(0x00C9),
+    G(0x0020), G(0x0021), G(0x0022), G(0x0023), G(0x00A4), G(0x0025), G(0x0026), G(0x0027),
+    G(0x0028), G(0x0029), G(0x002A), G(0x002B), G(0x002C), G(0x002D), G(0x002E), G(0x002F),
+    G(0x0030), G(0x0031), G(0x0032), G(0x0033), G(0x0034), G(0x0035), G(0x0036), G(0x0037),
+    G(0x0038), G(0x0039), G(0x003A), G(0x003B), G(0x003C), G(0x003D), G(0x003E), G(0x003F),
+    G(0x0130), G(0x0041), G(0x0042), G(0x0043), G(0x0044), G(0x0045), G(0x0046), G(0x0047),
+    G(0x0048), G(0x0049), G(0x004A), G(0x004B), G(0x004C), G(0x004D), G(0x004E), G(0x004F),
+    G(0x0050), G(0x0051), G(0x0052), G(0x0053), G(0x0054), G(0x0055), G(0x0056), G(0x0057),
+    G(0x0058), G(0x0059), G(0x005A), G(0x00C4), G(0x00D6), G(0x00D1), G(0x00DC), G(0x00A7),
+    G(0x00E7), G(0x0061), G(0x0062), G(0x0063), G(0x0064), G(0x0065), G(0x0066), G(0x0067),
+    G(0x0068), G(0x0069), G(0x006A), G(0x006B), G(0x006C), G(0x006D), G(0x006E), G(0x006F),
+    G(0x0070), G(0x0071), G(0x0072), G(0x0073), G(0x0074), G(0x0075), G(0x0076), G(0x0077),
+    G(0x0078), G(0x0079), G(0x007A), G(0x00E4), G(0x00F6), G(0x00F1), G(0x00FC), G(0x00E0),
+};
+
+// Turkish single shift: replaces the extension table
+static const uint32_t gsm7_turkish_single[128] = {
+    G(0x0040), G(0x00A3), G(0x0024), G(0x00A5), G(0x00E8), G(0x00E9), G(0x00F9), G(0x00EC),
+    G(0x00F2), G(0x00C7), G(0x000C), G(0x00D8), G(0x00F8), G(0x000D), G(0x00C5), G(0x00E5),
+    G(0x0394), G(0x005F), G(0x03A6), G(0x0393), G(0x005E), G(0x03A9), G(0x03A0), G(0x03A8),
+    G(0x03A3), G(0x0398), G(0x039E), G(0x0020), G(0x00C6), G(0x00E6), G(0x00DF), G(0x00C9),
+    G(0x0020), G(0x0021), G(0x0022), G(0x0023), G(0x00A4), G(0x0025), G(0x0026), G(0x0027),
+    G(0x007B), G(0x007D), G(0x002A), G(0x002B), G(0x002C), G(0x002D), G(0x002E), G(0x005C),
+    G(0x0030), G(0x0031), G(0x0032), G(0x0033), G(0x0034), G(0x0035), G(0x0036), G(0x0037),
+    G(0x0038), G(0x0039), G(0x003A), G(0x003B), G(0x005B), G(0x007E), G(0x005D), G(0x003F),
+    G(0x007C), G(0x0041), G(0x0042), G(0x0043), G(0x0044), G(0x0045), G(0x0046), G(0x011E),
+    G(0x0048), G(0x0130), G(0x004A), G(0x004B), G(0x004C), G(0x004D), G(0x004E), G(0x004F),
+    G(0x0050), G(0x0051), G(0x0052), G(0x015E), G(0x0054), G(0x0055), G(0x0056), G(0x0057),
+    G(0x0058), G(0x0059), G(0x005A), G(0x00C4), G(0x00D6), G(0x00D1), G(0x00DC), G(0x00A7),
+    G(0x00BF), G(0x0061), G(0x0062), G(0x00E7), G(0x0064), G(0x20AC), G(0x0066), G(0x011F),
+    G(0x0068), G(0x0131), G(0x006A), G(0x006B), G(0x006C), G(0x006D), G(0x006E), G(0x006F),
+    G(0x0070), G(0x0071), G(0x0072), G(0x015F), G(0x0074), G(0x0075), G(0x0076), G(0x0077),
+    G(0x0078), G(0x0079), G(0x007A), G(0x00E4), G(0x00F6), G(0x00F1), G(0x00FC), G(0x00E0),
+};
+
+// Spanish single shift (Spanish has no locking shift table)
+static const uint32_t gsm7_spanish_single[128] = {
+    G(0x0040), G(0x00A3), G(0x0024), G(0x00A5), G(0x00E8), G(0x00E9), G(0x00F9), G(0x00EC),
+    G(0x00F2), G(0x00E7), G(0x000C), G(0x00D8), G(0x00F8), G(0x000D), G(0x00C5), G(0x00E5),
+    G(0x0394), G(0x005F), G(0x03A6), G(0x0393), G(0x005E), G(0x03A9), G(0x03A0), G(0x03A8),
+    G(0x03A3), G(0x0398), G(0x039E), G(0x0020), G(0x00C6), G(0x00E6), G(0x00DF), G(0x00C9),
+    G(0x0020), G(0x0021), G(0x0022), G(0x0023), G(0x00A4), G(0x0025), G(0x0026), G(0x0027),
+    G(0x007B), G(0x007D), G(0x002A), G(0x002B), G(0x002C), G(0x002D), G(0x002E), G(0x005C),
+    G(0x0030), G(0x0031), G(0x0032), G(0x0033), G(0x0034), G(0x0035), G(0x0036), G(0x0037),
+    G(0x0038), G(0x0039), G(0x003A), G(0x003B), G(0x005B), G(0x007E), G(0x005D), G(0x003F),
+    G(0x007C), G(0x00C1), G(0x0042), G(0x0043), G(0x0044), G(0x0045), G(0x0046), G(0x0047),
+    G(0x0048), G(0x00CD), G(0x004A), G(0x004B), G(0x004C), G(0x004D), G(0x004E), G(0x00D3),
+    G(0x0050), G(0x0051), G(0x0052), G(0x0053), G(0x0054), G(0x00DA), G(0x0056), G(0x0057),
+    G(0x0058), G(0x0059), G(0x005A), G(0x00C4), G(0x00D6), G(0x00D1), G(0x00DC), G(0x00A7),
+    G(0x00BF), G(0x00E1), G(0x0062), G(0x0063), G(0x0064), G(0x20AC), G(0x0066), G(0x0067),
+    G(0x0068), G(0x00ED), G(0x006A), G(0x006B), G(0x006C), G(0x006D), G(0x006E), G(0x00F3),
+    G(0x0070), G(0x0071), G(0x0072), G(0x0073), G(0x0074), G(0x00FA), G(0x0076), G(0x0077),
+    G(0x0078), G(0x0079), G(0x007A), G(0x00E4), G(0x00F6), G(0x00F1), G(0x00FC), G(0x00E0),
+};
+
+static const uint32_t *gsm7_basic_table(uint8_t locking) {
+    return (locking == GSM7_LANG_TURKISH) ? gsm7_turkish_locking : gsm7_utf8[0];
+}
+
+static const uint32_t *gsm7_ext_table(uint8_t single) {
+    switch (single) {
+    case GSM7_LANG_TURKISH: return gsm7_turkish_single;
+    case GSM7_LANG_SPANISH: return gsm7_spanish_single;
+    default:                return gsm7_utf8[1];
+    }
+}
+
+size_t gsm7_to_utf8(const uint8_t *septets, size_t n, char *out, size_t out_size) {
+    return gsm7_to_utf8_lang(septets, n, GSM7_LANG_DEFAULT, GSM7_LANG_DEFAULT, out, out_size);
+}
+
+size_t gsm7_to_utf8_lang(const uint8_t *septets, size_t n, uint8_t locking, uint8_t single,
+                         char *out, size_t out_size) {
+    if (out_size == 0) return 0;
+
+    const uint32_t *basic = gsm7_basic_table(locking);
+    const uint32_t *ext = gsm7_ext_table(single);
+    size_t j = 0;
+
+    // Always store 4 bytes and advance by the real length; the loop bound
+    // leaves room for that plus the terminator. Escapes are rare, so they
+    // take a predictable side branch instead of threading an escape state
+    // through every table lookup.
+    for (size_t i = 0; i < n && j + 3 < out_size; i++) {
+        unsigned s = septets[i] & 0x7F;
+        uint32_t e = basic[s];
+        if (__builtin_expect(s == 0x1B, 0)) {
+            if (++i >= n) break; // dangling escape at the end: drop it
+            e = ext[septets[i] & 0x7F];
+        }
+        store_le32((uint8_t *)out + j, e);
+        j += (e >> 24) & 0x03;
+    }
+
+    out[j] = '\0';
+    return j;
+}
+
+// --- UCS2 (UTF-16BE) -> UTF-8 ---
+
+#define ASCII4_MASK 0x80FF80FF80FF80FFULL   // high octets zero, low octets < 0x80
+
+static inline bool is_surrogate(uint32_t wc) {
+    return (wc & 0xF800u) == 0xD800u;
+}
+
+/**
+ * @brief One code unit (plus its low surrogate, if paired) the general way
+ */
+static size_t ucs2_slow(const uint8_t *be, size_t len, size_t *i, char *out) {
+    uint32_t wc = ((uint32_t)be[*i] << 8) | be[*i + 1];
+    *i += 2;
+
+    // High surrogate: try to pair with the following low surrogate.
+    if (wc >= 0xD800 && wc <= 0xDBFF && *i + 1 < len) {
+        uint32_t lo = ((uint32_t)be[*i] << 8) | be[*i + 1];
+        if (lo >= 0xDC00 && lo <= 0xDFFF) {
+            wc = 0x10000u + ((wc - 0xD800u) << 10) + (lo - 0xDC00u);
+            *i += 2; // consume the low surrogate too
+        }
+    }
+
+    // Any leftover (unpaired) surrogate is not a valid scalar value.
+    if (is_surrogate(wc)) {
+        wc = 0xFFFD;
+    }
+
+    if (wc < 0x80) {
+        out[0] = (char)wc;
+        return 1;
+    }
+    if (wc < 0x800) {
+        out[0] = (char)(0xC0 | (wc >> 6));
+        out[1] = (char)(0x80 | (wc & 0x3F));
+        return 2;
+    }
+    if (wc < 0x10000) {
+        out[0] = (char)(0xE0 | (wc >> 12));
+        out[1] = (char)(0x80 | ((wc >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (wc & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (wc >> 18));
+    out[1] = (char)(0x80 | ((wc >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((wc >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (wc & 0x3F));
+    return 4;
+}
+
+size_t ucs2_to_utf8(const uint8_t *be, size_t len, char *out, size_t out_size) {
+    if (out_size == 0) return 0;
+
+    size_t i = 0;
+    size_t j = 0;
+
+    // Every path emits a character only while j + 4 < out_size, so the
+    // output is cut at exactly the same place whichever path runs.
+    while (i + 1 < len && j + 4 < out_size) {
+        // ASCII: 4 code units (8 octets) -> 4 bytes per step
+        while (i + 8 <= len && j + 7 < out_size) {
+            uint64_t w = load_le64(be + i);
+            if (w & ASCII4_MASK) break;
+            // Keep the low octets (odd positions) and pack them together
+            w = (w >> 8) & 0x00FF00FF00FF00FFULL;
+            w = (w | (w >> 8)) & 0x0000FFFF0000FFFFULL;
+            w = (w | (w >> 16)) & 0x00000000FFFFFFFFULL;
+            store_le32((uint8_t *)out + j, (uint32_t)w);
+            i += 8;
+            j += 4;
+        }
+        if (i + 1 >= len || j + 4 >= out_size) break;
+
+        uint32_t wc = ((uint32_t)be[i] << 8) | be[i + 1];
+        if (wc < 0x80) {
+            out[j++] = (char)wc;
+            i += 2;
+            continue;
+        }
+
+        // BMP run (CJK, kana, hangul, fullwidth punctuation): always 3 bytes,
+        // and a non-surrogate unit never needs pairing. Both bounds are
+        // hoisted: at most `run` units fit the input and the output.
+        if (wc >= 0x800 && !is_surrogate(wc)) {
+            size_t run = (len - i) / 2;
+            size_t room = (out_size - j - 5) / 3 + 1;
+            if (run > room) run = room;
+            const uint8_t *src = be + i;
+            uint8_t *dst = (uint8_t *)out + j;
+            size_t k = 0;
+            do {
+                store_le32(dst, (0xE0u | (wc >> 12)) |
+                                ((0x80u | ((wc >> 6) & 0x3F)) << 8) |
+                                ((0x80u | (wc & 0x3F)) << 16));
+                dst += 3;
+                src += 2;
+                if (++k == run) break;
+                wc = ((uint32_t)src[0] << 8) | src[1];
+            } while (wc >= 0x800 && !is_surrogate(wc));
+            i += k * 2;
+            j += k * 3;
+            continue;
+        }
+
+        // Latin-1 supplement, Greek, Cyrillic... and surrogates
+        j += ucs2_slow(be, len, &i, out + j);
+    }
+
+    out[j] = '\0';
+    return j;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file sms_codec.h
+ * @brief SMS user-data codecs shared by the PDU decoder
+ *
+ * Pure functions with no ESP-IDF dependencies, host tested and benchmarked
+ * (see test/bench_codec.c).
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GSM7_MAX_SEPTETS  256   // UDL is one octet, so never more than 255
+
+// National language identifiers (3GPP TS 23.038 6.2.1.2.4) with tables here
+#define GSM7_LANG_DEFAULT   0
+#define GSM7_LANG_TURKISH   1
+#define GSM7_LANG_SPANISH   2
+
+/**
+ * @brief Unpack GSM 7-bit packed octets into one septet per byte
+ *
+ * Expands 7 packed octets into 8 septets per step using 64-bit shifts and
+ * masks; a per-septet tail handles whatever is left.
+ *
+ * @param packed        Packed octets
+ * @param packed_len    Number of octets available in @p packed
+ * @param bit_offset    Fill bits to skip before the first septet (0-7,
+ *                      e.g. the UDH alignment padding)
+ * @param septets       Output, one septet (0x00-0x7F) per byte
+ * @param num_septets   Number of septets wanted
+ * @return Number of septets written (less than requested if @p packed ends)
+ */
+size_t gsm7_unpack(const uint8_t *packed, size_t packed_len, unsigned bit_offset,
+                   uint8_t *septets, size_t num_septets);
+
+/**
+ * @brief Map GSM 03.38 septets to UTF-8
+ *
+ * Covers the full default alphabet and its extension table (0x1B escape
+ * sequences such as '{', '[', '~', '|' and the euro sign) with one table
+ * load per septet. Unassigned extension codes fall back to the basic
+ * character, as 03.38 requires.
+ *
+ * @param septets   One septet per byte (e.g. from gsm7_unpack())
+ * @param n         Number of septets
+ * @param out       Output buffer (always NUL-terminated when out_size > 0)
+ * @param out_size  Output buffer size
+ * @return Number of bytes written, excluding the terminator
+ */
+size_t gsm7_to_utf8(const uint8_t *septets, size_t n, char *out, size_t out_size);
+
+/**
+ * @brief gsm7_to_utf8() with national language shift tables
+ *
+ * @param locking   Locking shift language (UDH IE 0x24): replaces the basic set
+ * @param single    Single shift language (UDH IE 0x25): replaces the extension table
+ *
+ * Turkish (locking and single) and Spanish (single) are supported; other
+ * IDs use the default tables. A locking shift table can map a single
+ * septet to 3 bytes of UTF-8 (e.g. the Turkish euro sign).
+ */
+size_t gsm7_to_utf8_lang(const uint8_t *septets, size_t n, uint8_t locking, uint8_t single,
+                         char *out, size_t out_size);
+
+/**
+ * @brief Transcode UCS2 / UTF-16BE octets to UTF-8
+ *
+ * Three paths: runs of ASCII are converted four code units per step, BMP
+ * runs from U+0800 up (CJK and friends) are emitted as 3-byte sequences
+ * without surrogate handling, and everything else goes through the
+ * general path. That path combines a high surrogate with the low surrogate
+ * after it into one 4-byte sequence (emoji), and replaces an unpaired
+ * surrogate with U+FFFD, since emitting the halves raw (0xED 0xA0..) is
+ * invalid UTF-8.
+ *
+ * @param be        UTF-16BE octets (an odd trailing octet is ignored)
+ * @param len       Number of octets
+ * @param out       Output buffer (always NUL-terminated when out_size > 0)
+ * @param out_size  Output buffer size; stops before a character that could
+ *                  need more than the space left (4 bytes + terminator)
+ * @return Number of bytes written, excluding the terminator
+ */
+size_t ucs2_to_utf8(const uint8_t *be, size_t len, char *out, size_t out_size);
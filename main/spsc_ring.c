@@ -0,0 +1,81 @@
+/**
+ * @file spsc_ring.c
+ * @brief Lock-free SPSC ring (see header)
+ */
+
+#include <string.h>
+#include "spsc_ring.h"
+
+bool spsc_ring_init(spsc_ring_t *r, void *buf, size_t elem_size, uint32_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) return false;
+    r->buf = buf;
+    r->elem_size = elem_size;
+    r->mask = capacity - 1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    return true;
+}
+
+void *spsc_ring_acquire(spsc_ring_t *r) {
+    // Own index: nobody else writes it. The other side's needs acquire so
+    // its reads of the slot we are about to reuse are finished.
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head - tail > r->mask) return NULL;
+    return r->buf + (size_t)(head & r->mask) * r->elem_size;
+}
+
+void spsc_ring_commit(spsc_ring_t *r) {
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+void *spsc_ring_acquire_span(spsc_ring_t *r, uint32_t *n) {
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    uint32_t free = r->mask + 1 - (head - tail);
+    uint32_t to_end = r->mask + 1 - (head & r->mask);
+
+    *n = free < to_end ? free : to_end;
+    if (*n == 0) return NULL;
+    return r->buf + (size_t)(head & r->mask) * r->elem_size;
+}
+
+void spsc_ring_commit_n(spsc_ring_t *r, uint32_t n) {
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    atomic_store_explicit(&r->head, head + n, memory_order_release);
+}
+
+bool spsc_ring_push(spsc_ring_t *r, const void *elem) {
+    void *slot = spsc_ring_acquire(r);
+    if (!slot) return false;
+    memcpy(slot, elem, r->elem_size);
+    spsc_ring_commit(r);
+    return true;
+}
+
+void *spsc_ring_front(spsc_ring_t *r) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (head == tail) return NULL;
+    return r->buf + (size_t)(tail & r->mask) * r->elem_size;
+}
+
+void spsc_ring_release(spsc_ring_t *r) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+}
+
+bool spsc_ring_pop(spsc_ring_t *r, void *out) {
+    void *slot = spsc_ring_front(r);
+    if (!slot) return false;
+    memcpy(out, slot, r->elem_size);
+    spsc_ring_release(r);
+    return true;
+}
+
+uint32_t spsc_ring_count(spsc_ring_t *r) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    return head - tail;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file spsc_ring.h
+ * @brief Lock-free single-producer/single-consumer ring of fixed-size slots
+ *
+ * One task pushes, one task pops; neither ever blocks or takes a lock, so
+ * the producer can run at high priority on one core while the consumer
+ * works at its own pace on the other. Storage is supplied by the caller
+ * (capacity must be a power of two).
+ *
+ * Slots are filled and drained in place: the producer gets a pointer to the
+ * next free slot, writes it, then commits; the consumer gets a pointer to
+ * the oldest slot, uses it, then releases. Indices are free-running C11
+ * atomics: a commit is a release store the consumer's acquire load pairs
+ * with, so the slot contents are visible before the slot is.
+ *
+ * Pure C11 with no ESP-IDF dependencies; host tested.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint8_t *buf;
+    size_t elem_size;
+    uint32_t mask;                      // capacity - 1
+    _Atomic uint32_t head;              // Next slot to write (producer only)
+    _Atomic uint32_t tail;              // Next slot to read (consumer only)
+} spsc_ring_t;
+
+/**
+ * @brief Set up a ring over @p buf (@p capacity slots of @p elem_size bytes)
+ * @return false if @p capacity is not a power of two
+ */
+bool spsc_ring_init(spsc_ring_t *r, void *buf, size_t elem_size, uint32_t capacity);
+
+/**
+ * @brief Producer: next free slot, or NULL if the ring is full
+ *
+ * The slot is not visible to the consumer until spsc_ring_commit().
+ */
+void *spsc_ring_acquire(spsc_ring_t *r);
+
+/** @brief Producer: publish the slot from spsc_ring_acquire() */
+void spsc_ring_commit(spsc_ring_t *r);
+
+/**
+ * @brief Producer: run of free slots that does not wrap, or NULL if full
+ *
+ * For filling several slots in one go (e.g. straight from a decoder):
+ * @p n is set to how many contiguous slots start at the result. Publish
+ * the ones actually written with spsc_ring_commit_n().
+ */
+void *spsc_ring_acquire_span(spsc_ring_t *r, uint32_t *n);
+
+/** @brief Producer: publish the first @p n slots from spsc_ring_acquire_span() */
+void spsc_ring_commit_n(spsc_ring_t *r, uint32_t n);
+
+/** @brief Producer: copy @p elem into the ring; false if full */
+bool spsc_ring_push(spsc_ring_t *r, const void *elem);
+
+/**
+ * @brief Consumer: oldest committed slot, or NULL if the ring is empty
+ *
+ * The slot stays owned by the consumer until spsc_ring_release().
+ */
+void *spsc_ring_front(spsc_ring_t *r);
+
+/** @brief Consumer: hand the slot from spsc_ring_front() back to the producer */
+void spsc_ring_release(spsc_ring_t *r);
+
+/** @brief Consumer: copy the oldest slot into @p out and release it; false if empty */
+bool spsc_ring_pop(spsc_ring_t *r, void *out);
+
+/**
+ * @brief Committed slots not yet released (either side; a snapshot)
+ */
+uint32_t spsc_ring_count(spsc_ring_t *r);
+
+/**
+ * @brief Slots the producer can still acquire (either side; a snapshot)
+ */
+static inline uint32_t spsc_ring_free(spsc_ring_t *r) {
+    return r->mask + 1 - spsc_ring_count(r);
+}
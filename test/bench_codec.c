@@ -0,0 +1,290 @@
+/**
+ * @file bench_codec.c
+ * @brief Host microbenchmark for the SMS user-data codecs in sms_codec.c
+ *
+ * Not part of run_tests: build the `codec_bench` target and run it directly.
+ * Each case first checks the optimized kernel against a straightforward
+ * reference implementation, then times both on the same input.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "sms_codec.h"
+
+#define BENCH_ITERATIONS 20000
+
+static volatile uint32_t g_sink; /* keeps the optimizer from dropping work */
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* ====================================================================== */
+/* GSM 7-bit unpack: 10 parts x 153 septets, 6-octet concat UDH (1 fill bit) */
+/* ====================================================================== */
+
+#define GSM7_PARTS          10
+#define GSM7_PART_SEPTETS   153
+#define GSM7_FILL_BITS      1
+#define GSM7_PART_OCTETS    ((GSM7_FILL_BITS + GSM7_PART_SEPTETS * 7 + 7) / 8)
+
+/* The original per-septet extraction from decode_gsm7bit() */
+static size_t gsm7_unpack_reference(const uint8_t *bytes, size_t byte_count, unsigned bit_offset,
+                                    uint8_t *septets, size_t num_septets) {
+    size_t out = 0;
+    int bit_pos = (int)bit_offset;
+    for (size_t sept = 0; sept < num_septets; sept++) {
+        int byte_idx = bit_pos / 8;
+        int bit_in_byte = bit_pos % 8;
+        if ((size_t)byte_idx >= byte_count) break;
+        uint8_t septet;
+        if (bit_in_byte <= 1) {
+            septet = (bytes[byte_idx] >> bit_in_byte) & 0x7F;
+        } else {
+            septet = (bytes[byte_idx] >> bit_in_byte);
+            if ((size_t)(byte_idx + 1) < byte_count) {
+                septet |= (bytes[byte_idx + 1] << (8 - bit_in_byte));
+            }
+            septet &= 0x7F;
+        }
+        septets[out++] = septet;
+        bit_pos += 7;
+    }
+    return out;
+}
+
+static void gsm7_pack(const uint8_t *septets, size_t n, unsigned fill, uint8_t *out, size_t out_len) {
+    memset(out, 0, out_len);
+    for (size_t k = 0; k < n; k++) {
+        size_t bit = fill + k * 7;
+        out[bit / 8] |= (uint8_t)(septets[k] << (bit % 8));
+        if (bit % 8 > 1) out[bit / 8 + 1] |= (uint8_t)(septets[k] >> (8 - bit % 8));
+    }
+}
+
+static bool bench_gsm7_unpack(void) {
+    static uint8_t packed[GSM7_PARTS][GSM7_PART_OCTETS];
+    uint8_t text[GSM7_PART_SEPTETS];
+    uint8_t a[GSM7_MAX_SEPTETS], b[GSM7_MAX_SEPTETS];
+
+    for (int p = 0; p < GSM7_PARTS; p++) {
+        for (int k = 0; k < GSM7_PART_SEPTETS; k++) text[k] = (uint8_t)((p * 31 + k * 7 + 32) & 0x7F);
+        gsm7_pack(text, GSM7_PART_SEPTETS, GSM7_FILL_BITS, packed[p], GSM7_PART_OCTETS);
+    }
+
+    for (int p = 0; p < GSM7_PARTS; p++) {
+        size_t n1 = gsm7_unpack_reference(packed[p], GSM7_PART_OCTETS, GSM7_FILL_BITS, a, GSM7_PART_SEPTETS);
+        size_t n2 = gsm7_unpack(packed[p], GSM7_PART_OCTETS, GSM7_FILL_BITS, b, GSM7_PART_SEPTETS);
+        if (n1 != n2 || memcmp(a, b, n1) != 0) {
+            printf("gsm7_unpack MISMATCH (part %d)\n", p);
+            return false;
+        }
+    }
+
+    double t0 = now_ns();
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        for (int p = 0; p < GSM7_PARTS; p++) {
+            gsm7_unpack_reference(packed[p], GSM7_PART_OCTETS, GSM7_FILL_BITS, a, GSM7_PART_SEPTETS);
+            g_sink += a[it % GSM7_PART_SEPTETS];
+        }
+    }
+    double t_ref = (now_ns() - t0) / BENCH_ITERATIONS;
+
+    t0 = now_ns();
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        for (int p = 0; p < GSM7_PARTS; p++) {
+            gsm7_unpack(packed[p], GSM7_PART_OCTETS, GSM7_FILL_BITS, b, GSM7_PART_SEPTETS);
+            g_sink += b[it % GSM7_PART_SEPTETS];
+        }
+    }
+    double t_new = (now_ns() - t0) / BENCH_ITERATIONS;
+
+    printf("gsm7_unpack (%d x %d septets): reference %8.1f ns/msg, word-at-a-time %8.1f ns/msg, %.2fx\n",
+           GSM7_PARTS, GSM7_PART_SEPTETS, t_ref, t_new, t_ref / t_new);
+    return true;
+}
+
+/* ====================================================================== */
+/* GSM 7-bit septets -> UTF-8: old branch chain vs. precomputed table      */
+/* ====================================================================== */
+
+/* The original ASCII-only mapping from decode_gsm7bit() (lossy: '?') */
+static size_t gsm7_map_reference(const uint8_t *septets, size_t n, char *out, size_t out_size) {
+    size_t j = 0;
+    for (size_t i = 0; i < n && j < out_size - 1; i++) {
+        uint8_t septet = septets[i];
+        if (septet >= 32 && septet < 127) {
+            out[j++] = (char)septet;
+        } else if (septet == 0x0A) {
+            out[j++] = '\n';
+        } else if (septet == 0x0D) {
+            out[j++] = '\r';
+        } else {
+            out[j++] = '?';
+        }
+    }
+    out[j] = '\0';
+    return j;
+}
+
+static bool bench_gsm7_to_utf8(void) {
+    uint8_t septets[GSM7_PARTS][GSM7_PART_SEPTETS];
+    char out[GSM7_PART_SEPTETS * 3 + 1];
+
+    /* Mostly printable text with the odd accented letter, like bank SMS */
+    for (int p = 0; p < GSM7_PARTS; p++) {
+        for (int k = 0; k < GSM7_PART_SEPTETS; k++) {
+            septets[p][k] = (k % 17 == 0) ? 0x7B : (uint8_t)(0x20 + (p * 13 + k) % 0x5B);
+        }
+    }
+
+    double t0 = now_ns();
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        for (int p = 0; p < GSM7_PARTS; p++) {
+            g_sink += (uint32_t)gsm7_map_reference(septets[p], GSM7_PART_SEPTETS, out, sizeof(out));
+        }
+    }
+    double t_ref = (now_ns() - t0) / BENCH_ITERATIONS;
+
+    t0 = now_ns();
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        for (int p = 0; p < GSM7_PARTS; p++) {
+            g_sink += (uint32_t)gsm7_to_utf8(septets[p], GSM7_PART_SEPTETS, out, sizeof(out));
+        }
+    }
+    double t_new = (now_ns() - t0) / BENCH_ITERATIONS;
+
+    printf("gsm7_to_utf8 (%d x %d septets): branch chain %8.1f ns/msg, table lookup %8.1f ns/msg, %.2fx\n",
+           GSM7_PARTS, GSM7_PART_SEPTETS, t_ref, t_new, t_ref / t_new);
+    return true;
+}
+
+/* ====================================================================== */
+/* UCS2 -> UTF-8: unit-at-a-time vs. ASCII / BMP fast paths               */
+/* ====================================================================== */
+
+#define UCS2_PARTS          10
+#define UCS2_PART_UNITS     67      /* 134 octets: a full concatenated UCS2 part */
+#define UCS2_OUT_SIZE       512     /* pdu_sms_t.message */
+
+/* The original decode_ucs2() from pdu_decoder.c */
+static size_t ucs2_reference(const uint8_t *data, size_t data_len, char *out, size_t out_size) {
+    size_t j = 0;
+    size_t i = 0;
+    while (i + 1 < data_len && j + 4 < out_size) {
+        uint32_t wc = ((uint32_t)data[i] << 8) | data[i + 1];
+        i += 2;
+        if (wc >= 0xD800 && wc <= 0xDBFF && i + 1 < data_len) {
+            uint32_t lo = ((uint32_t)data[i] << 8) | data[i + 1];
+            if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                wc = 0x10000u + ((wc - 0xD800u) << 10) + (lo - 0xDC00u);
+                i += 2;
+            }
+        }
+        if (wc >= 0xD800 && wc <= 0xDFFF) wc = 0xFFFD;
+        if (wc < 0x80) {
+            out[j++] = (char)wc;
+        } else if (wc < 0x800) {
+            out[j++] = (char)(0xC0 | (wc >> 6));
+            out[j++] = (char)(0x80 | (wc & 0x3F));
+        } else if (wc < 0x10000) {
+            out[j++] = (char)(0xE0 | (wc >> 12));
+            out[j++] = (char)(0x80 | ((wc >> 6) & 0x3F));
+            out[j++] = (char)(0x80 | (wc & 0x3F));
+        } else {
+            out[j++] = (char)(0xF0 | (wc >> 18));
+            out[j++] = (char)(0x80 | ((wc >> 12) & 0x3F));
+            out[j++] = (char)(0x80 | ((wc >> 6) & 0x3F));
+            out[j++] = (char)(0x80 | (wc & 0x3F));
+        }
+    }
+    out[j] = '\0';
+    return j;
+}
+
+typedef enum { UCS2_CJK, UCS2_ASCII, UCS2_MIXED } ucs2_corpus_t;
+
+static void ucs2_fill(ucs2_corpus_t kind, int part, uint8_t *be) {
+    for (int k = 0; k < UCS2_PART_UNITS; k++) {
+        uint16_t u;
+        switch (kind) {
+        case UCS2_CJK:      /* Chinese text, fullwidth comma, the odd digit run */
+            u = (k % 23 == 22) ? 0xFF0C : (k % 31 < 3) ? (uint16_t)('0' + k % 10)
+                                        : (uint16_t)(0x4E00 + (part * 97 + k * 37) % 0x5000);
+            break;
+        case UCS2_ASCII:    /* English text sent as UCS2 (e.g. one emoji forced it) */
+            u = (uint16_t)(0x20 + (part * 13 + k) % 0x5F);
+            break;
+        default:            /* CJK with emoji (surrogate pairs) and Latin-1 */
+            u = (k % 11 == 0) ? 0xD83D : (k % 11 == 1) ? 0xDCE9
+              : (k % 7 == 3) ? 0x00E9 : (uint16_t)(0x4E00 + k * 37);
+            break;
+        }
+        be[k * 2] = (uint8_t)(u >> 8);
+        be[k * 2 + 1] = (uint8_t)u;
+    }
+}
+
+static bool bench_ucs2_corpus(ucs2_corpus_t kind, const char *name) {
+    static uint8_t be[UCS2_PARTS][UCS2_PART_UNITS * 2];
+    char a[UCS2_OUT_SIZE], b[UCS2_OUT_SIZE];
+
+    for (int p = 0; p < UCS2_PARTS; p++) {
+        ucs2_fill(kind, p, be[p]);
+        size_t na = ucs2_reference(be[p], sizeof(be[p]), a, sizeof(a));
+        size_t nb = ucs2_to_utf8(be[p], sizeof(be[p]), b, sizeof(b));
+        if (na != nb || memcmp(a, b, na) != 0) {
+            printf("ucs2_to_utf8 MISMATCH (%s, part %d)\n", name, p);
+            return false;
+        }
+    }
+
+    double t0 = now_ns();
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        for (int p = 0; p < UCS2_PARTS; p++) {
+            g_sink += (uint32_t)ucs2_reference(be[p], sizeof(be[p]), a, sizeof(a));
+        }
+    }
+    double t_ref = (now_ns() - t0) / BENCH_ITERATIONS;
+
+    t0 = now_ns();
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        for (int p = 0; p < UCS2_PARTS; p++) {
+            g_sink += (uint32_t)ucs2_to_utf8(be[p], sizeof(be[p]), b, sizeof(b));
+        }
+    }
+    double t_new = (now_ns() - t0) / BENCH_ITERATIONS;
+
+    /* Input MB/s: octets of UCS2 consumed per second */
+    double mb = (double)(UCS2_PARTS * UCS2_PART_UNITS * 2) / 1e6;
+    printf("ucs2_to_utf8 %-6s (%d x %d units): reference %8.1f ns/msg (%6.1f MB/s), "
+           "fast paths %8.1f ns/msg (%6.1f MB/s), %.2fx\n",
+           name, UCS2_PARTS, UCS2_PART_UNITS, t_ref, mb / (t_ref * 1e-9),
+           t_new, mb / (t_new * 1e-9), t_ref / t_new);
+    return true;
+}
+
+static bool bench_ucs2_to_utf8(void) {
+    bool ok = bench_ucs2_corpus(UCS2_CJK, "cjk");
+    ok = bench_ucs2_corpus(UCS2_ASCII, "ascii") && ok;
+    ok = bench_ucs2_corpus(UCS2_MIXED, "mixed") && ok;
+    return ok;
+}
+
+int main(void) {
+    printf("========================================\n");
+    printf("  SMS Codec Benchmarks\n");
+    printf("========================================\n");
+
+    bool ok = bench_gsm7_unpack();
+    ok = bench_gsm7_to_utf8() && ok;
+    ok = bench_ucs2_to_utf8() && ok;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+/**
+ * @file bench_pdu.c
+ * @brief Host microbenchmark for the whole PDU decode path
+ *
+ * Not part of run_tests: build the `pdu_bench` target and run it directly.
+ * Replays a fixed corpus of SMS-DELIVER PDUs (GSM 7-bit and UCS2, numeric
+ * and alphanumeric senders, 8- and 16-bit concat UDH) through pdu_decode()
+ * and the binary view path, and reports ns/PDU, MB/s of input consumed
+ * (hex text or binary PDU) and heap allocations per PDU. Logging is compiled out (MOCK_ESP_LOG_QUIET)
+ * so the numbers are the decoder's, not printf's.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "pdu_decoder.h"
+#include "pdu_hex.h"
+
+#define BENCH_ITERATIONS 20000
+
+static volatile uint32_t g_sink; /* keeps the optimizer from dropping work */
+
+/* ====================================================================== */
+/* Allocation counting: the target links with -Wl,--wrap=malloc,... when  */
+/* the linker supports it and defines PDU_BENCH_COUNT_ALLOCS              */
+/* ====================================================================== */
+
+static unsigned long g_allocs;
+
+#ifdef PDU_BENCH_COUNT_ALLOCS
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t n);
+
+void *__wrap_malloc(size_t n) { g_allocs++; return __real_malloc(n); }
+void *__wrap_calloc(size_t n, size_t size) { g_allocs++; return __real_calloc(n, size); }
+void *__wrap_realloc(void *p, size_t n) { g_allocs++; return __real_realloc(p, n); }
+#endif
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* ====================================================================== */
+/* Corpus                                                                 */
+/* ====================================================================== */
+
+typedef struct {
+    const char *name;
+    const char *hex;
+} bench_pdu_t;
+
+static const bench_pdu_t s_corpus[] = {
+    { "gsm7 160 chars, international sender",
+      "00040C91889621436587000042015121436523A054741914AFA7C76B9058FEBEBB41E637"
+      "1EA4AEB7E173D0DB5E9683E8E832881DD6E741E4F719048BC966B49AED86CB81A8E83228"
+      "5E4F8FD720B1FC7D7783CC6F3C485D6FC3E7A0B7BD2C07D1D165103BACCF83C8EF330816"
+      "93CD6835DB0D970351D16550BC9E1EAF4162F9FBEE0699DF7890BADE86CF416F7B590EA2"
+      "A3CB2076589F0791DF67102C269BD16A" },
+    { "gsm7 alphanumeric sender",
+      "00040DD0C3B05C9E2ECB0100004201512143652332D9775D0EB297E569737A1CA6A7DF6E"
+      "D0F84D2E83D273100D27CBC5602E10F10D72BFE9A0393A2C2F83D27417" },
+    { "ucs2 70 CJK chars",
+      "00040C918896214365870008420151214365238C4F60597D4E16754C9019662F4E005247"
+      "6E2C8A667C218A0A4F60597D4E16754C9019662F4E0052476E2C8A667C218A0A4F60597D"
+      "4E16754C9019662F4E0052476E2C8A667C218A0A4F60597D4E16754C9019662F4E005247"
+      "6E2C8A667C218A0A4F60597D4E16754C9019662F4E0052476E2C8A667C218A0A4F60597D"
+      "4E16754C9019662F4E0052476E2C8A66" },
+    { "gsm7 8-bit concat part 1/2",
+      "00440C91889621436587000042015121436523A0050003420201A8E832285E4F8FD720B1"
+      "FC7D7783CC6F3C485D6FC3E7A0B7BD2C07D1D165103BACCF83C8EF33081693CD6835DB0D"
+      "970351D16550BC9E1EAF4162F9FBEE0699DF7890BADE86CF416F7B590EA2A3CB2076589F"
+      "0791DF67102C269BD16AB61B2E07A2A2CBA0783D3D5E83C4F2F7DD0D32BFF12075BD0D9F"
+      "83DEF6B21C44479741ECB03E0F22BFCF" },
+    { "ucs2 16-bit concat part 2/3",
+      "00440C918896214365870008420151214365238D060804123403024F60597D4E16754C00"
+      "410042004300444F60597D4E16754C00410042004300444F60597D4E16754C0041004200"
+      "4300444F60597D4E16754C00410042004300444F60597D4E16754C00410042004300444F"
+      "60597D4E16754C00410042004300444F60597D4E16754C00410042004300444F60597D4E"
+      "16754C00410042004300444F60597D4E16" },
+    { "ucs2 emoji",
+      "00040C9188962143658700084201512143652328004F0054005000200031003200330034"
+      "003500360020D83DDE00D83DDC4D00200064006F006E0065" },
+};
+
+#define CORPUS_SIZE (sizeof(s_corpus) / sizeof(s_corpus[0]))
+
+static void report(const char *what, double ns_total, size_t input_bytes, unsigned long allocs) {
+    double per_pdu = ns_total / ((double)BENCH_ITERATIONS * CORPUS_SIZE);
+    double mb = (double)input_bytes * BENCH_ITERATIONS / 1e6;
+#ifdef PDU_BENCH_COUNT_ALLOCS
+    printf("%-28s %8.1f ns/PDU  %7.1f MB/s  %.2f allocs/PDU\n", what, per_pdu,
+           mb / (ns_total * 1e-9), (double)allocs / ((double)BENCH_ITERATIONS * CORPUS_SIZE));
+#else
+    (void)allocs;
+    printf("%-28s %8.1f ns/PDU  %7.1f MB/s  allocs/PDU n/a\n", what, per_pdu,
+           mb / (ns_total * 1e-9));
+#endif
+}
+
+int main(void) {
+    static uint8_t bin[CORPUS_SIZE][PDU_MAX_OCTETS];
+    size_t bin_len[CORPUS_SIZE];
+    size_t hex_bytes = 0;
+    pdu_sms_t sms;
+
+    printf("========================================\n");
+    printf("  PDU Decoder Benchmark (%d PDUs)\n", (int)CORPUS_SIZE);
+    printf("========================================\n");
+
+    /* Every corpus entry must decode before it is worth timing */
+    for (size_t i = 0; i < CORPUS_SIZE; i++) {
+        size_t len = strlen(s_corpus[i].hex);
+        if (!pdu_decode(s_corpus[i].hex, &sms) || !pdu_hex_decode(s_corpus[i].hex, len, bin[i], NULL)) {
+            printf("corpus entry '%s' does not decode\n", s_corpus[i].name);
+            return 1;
+        }
+        printf("  %-38s %-16s %3d bytes of text\n", s_corpus[i].name, sms.sender, (int)strlen(sms.message));
+        bin_len[i] = len / 2;
+        hex_bytes += len;
+    }
+
+    /* Hex text -> pdu_sms_t, as the AT+CMGR / single-record path does */
+    unsigned long a0 = g_allocs;
+    double t0 = now_ns();
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        for (size_t i = 0; i < CORPUS_SIZE; i++) {
+            g_sink += pdu_decode(s_corpus[i].hex, &sms);
+            g_sink += (uint8_t)sms.message[0];
+        }
+    }
+    report("pdu_decode (hex)", now_ns() - t0, hex_bytes, g_allocs - a0);
+
+    /* Binary PDU -> view -> sender + text, as the CMGL batch path does */
+    char sender[PDU_MAX_SENDER_LEN];
+    char text[PDU_MAX_MESSAGE_LEN];
+    a0 = g_allocs;
+    t0 = now_ns();
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        for (size_t i = 0; i < CORPUS_SIZE; i++) {
+            pdu_sms_view_t view;
+            g_sink += pdu_view_parse(bin[i], bin_len[i], &view);
+            g_sink += (uint32_t)pdu_view_sender(&view, sender, sizeof(sender));
+            g_sink += (uint32_t)pdu_view_text(&view, text, sizeof(text));
+        }
+    }
+    report("pdu_view_parse + text (bin)", now_ns() - t0, hex_bytes / 2, g_allocs - a0);
+
+    return 0;
+}
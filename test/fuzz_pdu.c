@@ -0,0 +1,291 @@
+/**
+ * @file fuzz_pdu.c
+ * @brief Fuzz entry point for the PDU decoder and multipart reassembly
+ *
+ * Not part of run_tests: the `pdu_fuzz` target is built with AddressSanitizer
+ * and UBSan. With clang it links libFuzzer:
+ *
+ *     ./pdu_fuzz -max_len=800 corpus_dir/
+ *
+ * Elsewhere PDU_FUZZ_STANDALONE supplies a main() that runs each file given
+ * on the command line (or stdin) once, which is what AFL and corpus replay
+ * need:
+ *
+ *     afl-fuzz -i seeds -o findings -- ./pdu_fuzz @@
+ *
+ * The first input byte picks the target, the next two steer it (chunk
+ * sizes, arena size); the rest is the payload:
+ *
+ *   0  PDU hex text through pdu_decode() (the AT+CMGR line path), then the
+ *      raw payload through the view accessors
+ *   1  PDU hex text through pdu_stream_feed() in fuzzer-chosen chunks; the
+ *      outcome must match feeding the same line in one piece
+ *   2  Raw PDU through pdu_view_text_alloc() into an arena of chosen size
+ *   3  A sequence of length-prefixed raw PDUs through sms_assembly_add(),
+ *      publishing (decoding) and releasing messages as sim_modem.c does
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "pdu_decoder.h"
+#include "sms_assembly.h"
+
+#define FUZZ_HEADER     3
+#define FUZZ_TARGETS    4
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+/* Exact-size heap copy so ASan flags any read past it */
+static void *copy_of(const uint8_t *data, size_t size) {
+    uint8_t *p = malloc(size ? size : 1);
+    if (p) memcpy(p, data, size);
+    return p;
+}
+
+static void check_view(const pdu_sms_view_t *view, size_t size) {
+    char sender[PDU_MAX_SENDER_LEN];
+    char text[PDU_MAX_MESSAGE_LEN];
+    pdu_timestamp_t ts;
+
+    if (pdu_view_sender(view, sender, sizeof(sender)) >= sizeof(sender)) abort();
+    if (pdu_view_text(view, text, sizeof(text)) >= sizeof(text)) abort();
+    pdu_view_timestamp(view, &ts);
+    for (uint8_t i = 0; i < view->udh.count; i++) {
+        const pdu_udh_ie_t *ie = &view->udh.ie[i];
+        if ((size_t)ie->offset + ie->len > size) abort();
+    }
+}
+
+static void fuzz_decode(const uint8_t *data, size_t size) {
+    char *hex = malloc(size + 1);
+    if (!hex) return;
+    memcpy(hex, data, size);
+    hex[size] = '\0';
+
+    pdu_sms_t sms;
+    if (pdu_decode(hex, &sms)) {
+        // Everything the caller reads must be terminated and in bounds
+        if (strlen(sms.sender) >= sizeof(sms.sender)) abort();
+        if (strlen(sms.message) >= sizeof(sms.message)) abort();
+    }
+    free(hex);
+
+    uint8_t *pdu = copy_of(data, size);
+    if (!pdu) return;
+    pdu_sms_view_t view;
+    if (pdu_view_parse(pdu, size, &view)) check_view(&view, size);
+    free(pdu);
+}
+
+typedef struct {
+    pdu_stream_result_t result;
+    size_t consumed;
+    char text[PDU_MAX_MESSAGE_LEN];
+} stream_outcome_t;
+
+/**
+ * Feed one line, @p chunk_a and @p chunk_b bytes at a time in turn (0 means
+ * all at once), until the stream lets go of it or the input runs out.
+ */
+static void run_stream(const uint8_t *data, size_t size, size_t chunk_a, size_t chunk_b,
+                       stream_outcome_t *out) {
+    static pdu_stream_t stream;
+    size_t pos = 0;
+    bool odd = false;
+
+    memset(out, 0, sizeof(*out));
+    pdu_stream_begin(&stream);
+    while (pos < size && pdu_stream_busy(&stream)) {
+        size_t n = odd ? chunk_b : chunk_a;
+        if (n == 0 || n > size - pos) n = size - pos;
+        odd = !odd;
+
+        char *chunk = copy_of(data + pos, n);
+        if (!chunk) return;
+        size_t off = 0;
+        while (off < n && pdu_stream_busy(&stream)) {
+            size_t used = 0;
+            pdu_sms_view_t view;
+            pdu_stream_result_t r = pdu_stream_feed(&stream, chunk + off, n - off, &used, &view);
+            if (used > n - off) abort();
+            off += used;
+            if (r == PDU_STREAM_DECODED) {
+                check_view(&view, (size_t)view.ud_pos + view.ud_len);
+                if (out->result == PDU_STREAM_MORE) pdu_view_text(&view, out->text, sizeof(out->text));
+            }
+            if (r != PDU_STREAM_MORE && out->result == PDU_STREAM_MORE) out->result = r;
+            if (used == 0 && r == PDU_STREAM_MORE) break;
+        }
+        pos += off;
+        free(chunk);
+    }
+    out->consumed = pos;
+}
+
+static void fuzz_stream(const uint8_t *data, size_t size, uint8_t a, uint8_t b) {
+    static stream_outcome_t whole, split;
+
+    run_stream(data, size, 0, 0, &whole);
+    run_stream(data, size, (size_t)(a % 64) + 1, (size_t)(b % 64) + 1, &split);
+
+    // Where the chunks fall must not change what is decoded
+    if (whole.result != split.result || whole.consumed != split.consumed) abort();
+    if (strcmp(whole.text, split.text) != 0) abort();
+}
+
+static void fuzz_arena(const uint8_t *data, size_t size, uint8_t a, uint8_t b) {
+    size_t arena_size = ((size_t)a << 2) | (b & 3);
+    char *buf = malloc(arena_size ? arena_size : 1);
+    uint8_t *pdu = copy_of(data, size);
+    pdu_sms_view_t view;
+
+    if (buf && pdu && pdu_view_parse(pdu, size, &view)) {
+        pdu_arena_t arena;
+        pdu_text_t t1, t2;
+        pdu_arena_init(&arena, buf, arena_size);
+
+        // Twice: the second slice starts where the first one ended
+        for (int i = 0; i < 2; i++) {
+            size_t used = arena.used;
+            pdu_text_t *t = i ? &t2 : &t1;
+            if (pdu_view_text_alloc(&view, &arena, t)) {
+                if (t->len + 1 > pdu_view_text_bound(&view)) abort();
+                if (t->ptr != buf + used || arena.used != used + t->len + 1) abort();
+                if (arena.used > arena_size || t->ptr[t->len] != '\0') abort();
+            } else if (arena.used != used || t->len != 0) {
+                abort();
+            }
+        }
+    }
+    free(pdu);
+    free(buf);
+}
+
+/* Every block of the pool, 3 bytes per septet: no slot can decode to more */
+#define FUZZ_TEXT_MAX   (SMS_ASSEMBLY_POOL_BLOCKS * SMS_ASSEMBLY_PART_SEPTETS * 3 + 1)
+
+typedef struct {
+    char text[FUZZ_TEXT_MAX];
+    size_t len;
+} fuzz_text_t;
+
+static bool collect(const char *text, size_t len, void *ctx) {
+    fuzz_text_t *t = ctx;
+    if (len > SMS_ASSEMBLY_CHUNK_TEXT || len >= sizeof(t->text) - t->len) abort();
+    memcpy(t->text + t->len, text, len);
+    t->len += len;
+    return true;
+}
+
+static void publish(sms_assembly_t *as, sms_assembly_slot_t *slot) {
+    static fuzz_text_t whole;
+    static char cut[512];
+    bool truncated = false;
+
+    whole.len = 0;
+    if (sms_assembly_text_stream(as, slot, collect, &whole, &truncated) != whole.len) abort();
+    // The chunks are sized never to cut
+    if (truncated && !slot->truncated) abort();
+
+    // Into a small buffer: a terminated prefix of the streamed text
+    size_t len = sms_assembly_text(as, slot, cut, sizeof(cut), &truncated);
+    // UCS2 U+0000 decodes to a NUL byte, so check the terminator, not strlen()
+    if (len >= sizeof(cut) || cut[len] != '\0') abort();
+    if (len > whole.len || memcmp(cut, whole.text, len) != 0) abort();
+    if (len < whole.len && !truncated) abort();
+    sms_assembly_release(as, slot);
+}
+
+static void fuzz_assembly(const uint8_t *data, size_t size, uint8_t a) {
+    static sms_assembly_t as;
+    size_t pos = 0;
+    int64_t now = 0;
+
+    sms_assembly_init(&as);
+    while (pos < size) {
+        size_t n = data[pos++];
+        if (n > size - pos) n = size - pos;
+        uint8_t *pdu = copy_of(data + pos, n);
+        pos += n;
+        if (!pdu) break;
+
+        pdu_sms_view_t view;
+        if (pdu_view_parse(pdu, n, &view) && view.is_multipart) {
+            char sender[PDU_MAX_SENDER_LEN];
+            sms_assembly_slot_t *slot;
+            sms_assembly_result_t r;
+            int evictions = 0;
+
+            pdu_view_sender(&view, sender, sizeof(sender));
+            while ((r = sms_assembly_add(&as, sender, &view, (int)pos, now, &slot)) ==
+                   SMS_ASSEMBLY_EVICT) {
+                if (!slot || !slot->active || ++evictions > SMS_ASSEMBLY_SLOTS) abort();
+                publish(&as, slot);
+            }
+            if (r == SMS_ASSEMBLY_INVALID && slot) abort();
+            if (r == SMS_ASSEMBLY_COMPLETE) publish(&as, slot);
+        }
+        free(pdu);
+
+        // The second header byte sets how fast time passes
+        now += a;
+        sms_assembly_slot_t *expired;
+        while ((expired = sms_assembly_expired(&as, now, 1000)) != NULL) publish(&as, expired);
+    }
+
+    // Whatever is left times out; every block must come back
+    sms_assembly_slot_t *slot;
+    while ((slot = sms_assembly_expired(&as, INT64_MAX / 2, 0)) != NULL) publish(&as, slot);
+    if (as.blocks_free != SMS_ASSEMBLY_POOL_BLOCKS) abort();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (size < FUZZ_HEADER) {
+        fuzz_decode(data, size);
+        return 0;
+    }
+
+    const uint8_t *body = data + FUZZ_HEADER;
+    size_t len = size - FUZZ_HEADER;
+    switch (data[0] % FUZZ_TARGETS) {
+    case 0:
+        fuzz_decode(body, len);
+        break;
+    case 1:
+        fuzz_stream(body, len, data[1], data[2]);
+        break;
+    case 2:
+        fuzz_arena(body, len, data[1], data[2]);
+        break;
+    default:
+        fuzz_assembly(body, len, data[1]);
+        break;
+    }
+    return 0;
+}
+
+#ifdef PDU_FUZZ_STANDALONE
+static int run_file(FILE *f) {
+    static uint8_t buf[4096];
+    size_t n = fread(buf, 1, sizeof(buf), f);
+    return LLVMFuzzerTestOneInput(buf, n);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) return run_file(stdin);
+
+    for (int i = 1; i < argc; i++) {
+        FILE *f = fopen(argv[i], "rb");
+        if (!f) {
+            perror(argv[i]);
+            return 1;
+        }
+        run_file(f);
+        fclose(f);
+    }
+    return 0;
+}
+#endif
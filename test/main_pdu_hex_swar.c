@@ -0,0 +1,30 @@
+/**
+ * @file main_pdu_hex_swar.c
+ * @brief Runner for test_pdu_hex.c alone (pdu_hex_swar_tests: pdu_hex.c
+ *        built with PDU_HEX_FORCE_SWAR)
+ */
+
+#include <setjmp.h>
+
+/* Unity global counters (extern'd in unity.h) */
+int unity_tests_run = 0;
+int unity_tests_passed = 0;
+int unity_tests_failed = 0;
+jmp_buf unity_jmp;
+const char *unity_current_test = "";
+
+#include "unity.h"
+
+extern void run_pdu_hex_tests(void);
+
+int main(void) {
+    printf("========================================\n");
+    printf("  pdu_hex Tests (SWAR kernel)\n");
+    printf("========================================\n");
+
+    run_pdu_hex_tests();
+
+    unity_print_summary();
+
+    return unity_tests_failed > 0 ? 1 : 0;
+}
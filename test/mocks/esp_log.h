@@ -2,8 +2,15 @@
 // Mock esp_log.h for host-based testing
 #include <stdio.h>
 
+#ifdef MOCK_ESP_LOG_QUIET
+// Benchmarks and the fuzzer: arguments still type-checked, nothing printed
+#define ESP_LOGE(tag, fmt, ...) do { if (0) printf("%s" fmt, tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGW(tag, fmt, ...) do { if (0) printf("%s" fmt, tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGI(tag, fmt, ...) do { if (0) printf("%s" fmt, tag, ##__VA_ARGS__); } while (0)
+#else
 #define ESP_LOGE(tag, fmt, ...) printf("[ERROR][%s] " fmt "\n", tag, ##__VA_ARGS__)
 #define ESP_LOGW(tag, fmt, ...) printf("[WARN][%s] " fmt "\n", tag, ##__VA_ARGS__)
 #define ESP_LOGI(tag, fmt, ...) printf("[INFO][%s] " fmt "\n", tag, ##__VA_ARGS__)
+#endif
 #define ESP_LOGD(tag, fmt, ...) 
 #define ESP_LOGV(tag, fmt, ...) 
@@ -0,0 +1,181 @@
+/**
+ * @file test_at_parser.c
+ * @brief Unit tests for at_parser.c (ring buffer, line tokenizer, prefix
+ *        dispatch, raw PDU lines, resync after lost input)
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include "unity.h"
+#include "at_parser.h"
+
+static at_parser_t s_parser;
+
+/* Every dispatched line, tagged with who got it: "C:+CMTI: ..." / "F:OK" */
+static char s_log[16384];
+static int s_lines;
+
+static void log_line(char tag, const char *line, size_t len) {
+    size_t used = strlen(s_log);
+    snprintf(s_log + used, sizeof(s_log) - used, "%c:%.*s|", tag, (int)len, line);
+    s_lines++;
+}
+
+static void on_cmti(const char *line, size_t len, void *ctx) { log_line((char)(intptr_t)ctx, line, len); }
+static void on_fallback(const char *line, size_t len, void *ctx) { log_line('F', line, len); }
+
+/* Raw sink: collect the PDU line and note how many chunks it came in */
+static char s_raw[1024];
+static size_t s_raw_len;
+static int s_raw_chunks;
+static int s_raw_ends;
+
+static void on_raw(const char *data, size_t len, bool end, void *ctx) {
+    memcpy(s_raw + s_raw_len, data, len);
+    s_raw_len += len;
+    s_raw_chunks++;
+    if (end) s_raw_ends++;
+}
+
+static void on_cmgl(const char *line, size_t len, void *ctx) {
+    log_line('L', line, len);
+    at_parser_expect_raw(&s_parser, on_raw, NULL);
+}
+
+static void reset(void) {
+    s_log[0] = '\0';
+    s_lines = 0;
+    s_raw_len = 0;
+    s_raw_chunks = 0;
+    s_raw_ends = 0;
+    at_parser_init(&s_parser, on_fallback, NULL);
+    at_parser_register(&s_parser, "+CMTI:", on_cmti, (void *)(intptr_t)'C');
+    at_parser_register(&s_parser, "+CMGL:", on_cmgl, NULL);
+}
+
+static void feed_str(const char *str) {
+    at_parser_feed(&s_parser, str, strlen(str));
+}
+
+void test_at_parser_dispatches_by_prefix(void) {
+    reset();
+    feed_str("\r\n+CMTI: \"SM\",3\r\n\r\nOK\r\nERROR\r\n");
+    TEST_ASSERT_EQUAL_STRING("C:+CMTI: \"SM\",3|F:OK|F:ERROR|", s_log);
+}
+
+void test_at_parser_line_split_across_writes(void) {
+    static const char input[] = "+CMTI: \"SM\",12\r\nOK\r\n";
+    reset();
+    /* One byte at a time: the partial line waits for its terminator */
+    for (size_t i = 0; i < sizeof(input) - 1; i++) {
+        at_parser_feed(&s_parser, input + i, 1);
+        if (i == 5) TEST_ASSERT_EQUAL_INT(0, s_lines);
+    }
+    TEST_ASSERT_EQUAL_STRING("C:+CMTI: \"SM\",12|F:OK|", s_log);
+
+    /* Bare '\n' terminators are accepted too */
+    reset();
+    feed_str("RING\nOK\n");
+    TEST_ASSERT_EQUAL_STRING("F:RING|F:OK|", s_log);
+}
+
+void test_at_parser_wraps_around_ring(void) {
+    char line[64];
+    reset();
+    /* Enough lines to cycle the ring several times, none of them aligned */
+    for (int i = 0; i < 400; i++) {
+        int n = snprintf(line, sizeof(line), "+CMTI: \"SM\",%d\r\n", i);
+        at_parser_feed(&s_parser, line, (size_t)n);
+    }
+    TEST_ASSERT_EQUAL_INT(400, s_lines);
+    TEST_ASSERT_TRUE(strstr(s_log, "C:+CMTI: \"SM\",399|") != NULL);
+    TEST_ASSERT_TRUE(s_parser.head > AT_RX_RING_SIZE * 2);
+}
+
+void test_at_parser_raw_line_after_header(void) {
+    static const char pdu[] = "00000481214300009930925161958005E8329BFD06";
+    char input[256];
+    reset();
+
+    int n = snprintf(input, sizeof(input), "+CMGL: 1,0,,23\r\n%s\r\n\r\nOK\r\n", pdu);
+    /* Fill the ring almost to the end so the PDU line wraps */
+    s_parser.head = s_parser.tail = AT_RX_RING_SIZE - 30;
+    at_parser_feed(&s_parser, input, (size_t)n);
+
+    TEST_ASSERT_EQUAL_STRING("L:+CMGL: 1,0,,23|F:OK|", s_log);
+    TEST_ASSERT_EQUAL_INT(1, s_raw_ends);
+    TEST_ASSERT_TRUE(s_raw_chunks >= 2);
+    TEST_ASSERT_EQUAL_INT(sizeof(pdu) - 1 + 2, s_raw_len);
+    TEST_ASSERT_TRUE(memcmp(s_raw, pdu, sizeof(pdu) - 1) == 0);
+    TEST_ASSERT_TRUE(memcmp(s_raw + sizeof(pdu) - 1, "\r\n", 2) == 0);
+}
+
+void test_at_parser_drops_overlong_line(void) {
+    char big[AT_LINE_MAX + 40];
+    reset();
+    memset(big, 'A', sizeof(big));
+    at_parser_feed(&s_parser, big, sizeof(big));
+    feed_str("\r\nOK\r\n");
+
+    /* The long line is counted and skipped; parsing resumes at the next line */
+    TEST_ASSERT_EQUAL_STRING("F:OK|", s_log);
+    TEST_ASSERT_EQUAL_INT(1, (int)s_parser.dropped_lines);
+}
+
+void test_at_parser_rx_space_zero_copy(void) {
+    size_t room;
+    reset();
+
+    s_parser.head = s_parser.tail = AT_RX_RING_SIZE - 4;
+    char *dst = at_parser_rx_space(&s_parser, &room);
+    TEST_ASSERT_EQUAL_INT(4, room);
+    memcpy(dst, "OK\r\n", 4);
+    at_parser_rx_commit(&s_parser, 4);
+
+    /* Ring not polled yet: the rest of the buffer (from index 0) is free */
+    dst = at_parser_rx_space(&s_parser, &room);
+    TEST_ASSERT_TRUE(dst == s_parser.ring);
+    TEST_ASSERT_EQUAL_INT(AT_RX_RING_SIZE - 4, room);
+
+    at_parser_poll(&s_parser);
+    TEST_ASSERT_EQUAL_STRING("F:OK|", s_log);
+
+    /* Resyncing drops the partial line up to its end, past the ring wrap */
+    feed_str("+CMTI: \"S");
+    at_parser_resync(&s_parser);
+    feed_str("M\",9\r\nRING\r\n");
+    TEST_ASSERT_EQUAL_STRING("F:OK|F:RING|", s_log);
+}
+
+void test_at_parser_resync_after_lost_input(void) {
+    reset();
+    /* The driver lost input in the middle of a URC */
+    feed_str("OK\r\n+CMTI: \"S");
+    at_parser_resync(&s_parser);
+    feed_str("M\",7\r\nRING\r\n");
+
+    /* Nothing before the gap is lost; the broken line is not dispatched */
+    TEST_ASSERT_EQUAL_STRING("F:OK|F:RING|", s_log);
+    TEST_ASSERT_EQUAL_INT(1, (int)s_parser.resyncs);
+    TEST_ASSERT_EQUAL_INT(0, (int)s_parser.dropped_lines);
+
+    /* A claimed PDU line keeps going to its sink up to the line end */
+    reset();
+    feed_str("+CMGL: 1,0,,23\r\n0791");
+    at_parser_resync(&s_parser);
+    feed_str("ABCD\r\nOK\r\n");
+    TEST_ASSERT_EQUAL_INT(1, s_raw_ends);
+    TEST_ASSERT_EQUAL_STRING("L:+CMGL: 1,0,,23|F:OK|", s_log);
+}
+
+void run_at_parser_tests(void) {
+    printf("\n=== AT Parser Tests ===\n");
+    RUN_TEST(test_at_parser_dispatches_by_prefix);
+    RUN_TEST(test_at_parser_line_split_across_writes);
+    RUN_TEST(test_at_parser_wraps_around_ring);
+    RUN_TEST(test_at_parser_raw_line_after_header);
+    RUN_TEST(test_at_parser_drops_overlong_line);
+    RUN_TEST(test_at_parser_rx_space_zero_copy);
+    RUN_TEST(test_at_parser_resync_after_lost_input);
+}
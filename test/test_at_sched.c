@@ -0,0 +1,241 @@
+/**
+ * @file test_at_sched.c
+ * @brief Unit tests for at_sched.c (AT command queue, response correlation,
+ *        timeouts, cancellation)
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include "unity.h"
+#include "at_sched.h"
+
+static at_sched_t s_sched;
+
+/* Everything the scheduler wrote, '|' separated */
+static char s_wire[512];
+static int s_writes;
+
+static void fake_write(const char *cmd, void *ctx) {
+    size_t used = strlen(s_wire);
+    snprintf(s_wire + used, sizeof(s_wire) - used, "%s|", cmd);
+    s_writes++;
+}
+
+static char s_events[512];
+
+static void on_line(const char *line, size_t len, void *ctx) {
+    size_t used = strlen(s_events);
+    snprintf(s_events + used, sizeof(s_events) - used, "%s<%.*s>", (const char *)ctx, (int)len, line);
+}
+
+static void on_done(at_result_t result, int cms_error, void *ctx) {
+    size_t used = strlen(s_events);
+    snprintf(s_events + used, sizeof(s_events) - used, "%s=%d/%d;", (const char *)ctx, (int)result, cms_error);
+}
+
+static void reset(void) {
+    s_wire[0] = '\0';
+    s_events[0] = '\0';
+    s_writes = 0;
+    at_sched_init(&s_sched, fake_write, NULL);
+}
+
+static void line(const char *text, int64_t now) {
+    at_sched_on_line(&s_sched, text, strlen(text), now);
+}
+
+void test_at_sched_issues_next_on_completion(void) {
+    reset();
+    TEST_ASSERT_TRUE(at_sched_submit(&s_sched, "AT+CMGD=1", 0, NULL, on_done, "a", 0));
+    TEST_ASSERT_TRUE(at_sched_submit(&s_sched, "AT+CMGD=2", 0, NULL, on_done, "b", 0));
+
+    /* Only the first is on the wire until it completes */
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=1|", s_wire);
+    line("OK", 5);
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=1|AT+CMGD=2|", s_wire);
+    line("OK", 9);
+    TEST_ASSERT_EQUAL_STRING("a=0/-1;b=0/-1;", s_events);
+    TEST_ASSERT_TRUE(at_sched_idle(&s_sched));
+}
+
+void test_at_sched_error_codes(void) {
+    reset();
+    at_sched_submit(&s_sched, "AT+CMGR=7", 0, NULL, on_done, "r", 0);
+    at_sched_submit(&s_sched, "AT+CPIN?", 0, NULL, on_done, "p", 0);
+    line("+CMS ERROR: 321", 1);
+    line("ERROR", 2);
+    TEST_ASSERT_EQUAL_STRING("r=2/321;p=1/-1;", s_events);
+}
+
+void test_at_sched_intermediate_lines_go_to_command(void) {
+    reset();
+    at_sched_submit(&s_sched, "AT+CPMS?", 0, on_line, on_done, "c", 0);
+    line("+CPMS: \"SM\",3,30,\"SM\",3,30,\"SM\",3,30", 1);
+    line("OK", 2);
+    /* Nothing in flight: stray lines are not claimed */
+    TEST_ASSERT_FALSE(at_sched_on_line(&s_sched, "OK", 2, 3));
+    TEST_ASSERT_EQUAL_STRING("c<+CPMS: \"SM\",3,30,\"SM\",3,30,\"SM\",3,30>c=0/-1;", s_events);
+}
+
+void test_at_sched_timeout_moves_on(void) {
+    reset();
+    at_sched_submit(&s_sched, "AT", 300, NULL, on_done, "t", 1000);
+    at_sched_submit(&s_sched, "ATE0", 0, NULL, on_done, "e", 1000);
+
+    at_sched_poll(&s_sched, 1299);
+    TEST_ASSERT_EQUAL_INT(1, s_writes);
+    at_sched_poll(&s_sched, 1300);
+    TEST_ASSERT_EQUAL_STRING("t=3/-1;", s_events);
+    TEST_ASSERT_EQUAL_INT(1, (int)s_sched.timeouts);
+
+    /* Nothing else goes out until a quiet line, the sentinel's OK and quiet again */
+    TEST_ASSERT_EQUAL_STRING("AT|", s_wire);
+    at_sched_poll(&s_sched, 1300 + AT_SCHED_QUIET_MS);
+    TEST_ASSERT_EQUAL_STRING("AT|AT|", s_wire);
+    line("OK", 1600);
+    at_sched_poll(&s_sched, 1600 + AT_SCHED_QUIET_MS - 1);
+    TEST_ASSERT_EQUAL_STRING("AT|AT|", s_wire);
+    at_sched_poll(&s_sched, 1600 + AT_SCHED_QUIET_MS);
+    TEST_ASSERT_EQUAL_STRING("AT|AT|ATE0|", s_wire);
+
+    /* The second command's deadline runs from when it was written */
+    at_sched_poll(&s_sched, 1800 + AT_SCHED_DEFAULT_TIMEOUT_MS - 1);
+    TEST_ASSERT_FALSE(at_sched_idle(&s_sched));
+}
+
+void test_at_sched_late_ok_after_timeout_not_credited(void) {
+    reset();
+    at_sched_submit(&s_sched, "AT+CMGR=3", 300, NULL, on_done, "r", 0);
+    at_sched_submit(&s_sched, "AT+CMGD=5", 0, NULL, on_done, "d", 0);
+    at_sched_poll(&s_sched, 300);
+    TEST_ASSERT_EQUAL_STRING("r=3/-1;", s_events);
+
+    /* The timed-out read's answer straggles in: swallowed, and it restarts the quiet wait */
+    TEST_ASSERT_TRUE(at_sched_on_line(&s_sched, "+CMGR: 0,,22", 12, 350));
+    at_sched_poll(&s_sched, 300 + AT_SCHED_QUIET_MS);
+    TEST_ASSERT_EQUAL_STRING("AT+CMGR=3|", s_wire);
+    line("OK", 360);
+    TEST_ASSERT_EQUAL_STRING("r=3/-1;", s_events);
+
+    at_sched_poll(&s_sched, 360 + AT_SCHED_QUIET_MS);
+    TEST_ASSERT_EQUAL_STRING("AT+CMGR=3|AT|", s_wire);
+
+    /* A second stale OK racing the sentinel's: both absorbed before CMGD goes out */
+    line("OK", 600);
+    line("OK", 610);
+    at_sched_poll(&s_sched, 610 + AT_SCHED_QUIET_MS);
+    TEST_ASSERT_EQUAL_STRING("AT+CMGR=3|AT|AT+CMGD=5|", s_wire);
+    TEST_ASSERT_EQUAL_STRING("r=3/-1;", s_events);
+
+    /* Only the delete's own OK completes it */
+    line("OK", 900);
+    TEST_ASSERT_EQUAL_STRING("r=3/-1;d=0/-1;", s_events);
+    TEST_ASSERT_TRUE(at_sched_idle(&s_sched));
+}
+
+void test_at_sched_sentinel_retried(void) {
+    reset();
+    at_sched_submit(&s_sched, "AT+CPMS?", 100, NULL, on_done, "p", 0);
+    at_sched_submit(&s_sched, "ATE0", 0, NULL, on_done, "e", 0);
+    at_sched_poll(&s_sched, 100);
+    at_sched_poll(&s_sched, 100 + AT_SCHED_QUIET_MS);
+    TEST_ASSERT_EQUAL_STRING("AT+CPMS?|AT|", s_wire);
+
+    /* No answer to the sentinel: another one after the quiet period */
+    int64_t t = 100 + AT_SCHED_QUIET_MS + AT_SCHED_SENTINEL_TIMEOUT_MS;
+    at_sched_poll(&s_sched, t);
+    at_sched_poll(&s_sched, t + AT_SCHED_QUIET_MS);
+    TEST_ASSERT_EQUAL_STRING("AT+CPMS?|AT|AT|", s_wire);
+    TEST_ASSERT_FALSE(at_sched_idle(&s_sched));
+    TEST_ASSERT_EQUAL_INT(1, (int)s_sched.resyncs);
+}
+
+void test_at_sched_submit_front_jumps_queue(void) {
+    reset();
+    at_sched_submit(&s_sched, "AT+CMGD=1", 0, NULL, on_done, "a", 0);
+    at_sched_submit(&s_sched, "AT+CMGD=2", 0, NULL, on_done, "b", 0);
+    at_sched_submit(&s_sched, "AT+CMGD=3", 0, NULL, on_done, "c", 0);
+
+    /* Goes right behind the command already on the wire */
+    TEST_ASSERT_TRUE(at_sched_submit_front(&s_sched, "AT+CNMA", 0, NULL, on_done, "k", 1));
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=1|", s_wire);
+    line("OK", 2);
+    line("OK", 3);
+    line("OK", 4);
+    line("OK", 5);
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=1|AT+CNMA|AT+CMGD=2|AT+CMGD=3|", s_wire);
+    TEST_ASSERT_EQUAL_STRING("a=0/-1;k=0/-1;b=0/-1;c=0/-1;", s_events);
+
+    /* Nothing in flight: written at once */
+    TEST_ASSERT_TRUE(at_sched_submit_front(&s_sched, "AT+CNMA=2", 0, NULL, NULL, NULL, 6));
+    TEST_ASSERT_EQUAL_STRING("AT+CNMA=2", at_sched_current(&s_sched));
+}
+
+static void chain_done(at_result_t result, int cms_error, void *ctx) {
+    on_done(result, cms_error, ctx);
+    at_sched_submit(&s_sched, "AT+CMGL=4", 0, NULL, on_done, "l", 0);
+}
+
+void test_at_sched_queue_full_and_chaining(void) {
+    char cmd[AT_SCHED_CMD_MAX + 8];
+    reset();
+    for (int i = 0; i < AT_SCHED_QUEUE_LEN; i++) {
+        TEST_ASSERT_TRUE(at_sched_submit(&s_sched, "AT", 0, NULL, NULL, NULL, 0));
+    }
+    TEST_ASSERT_FALSE(at_sched_submit(&s_sched, "AT", 0, NULL, NULL, NULL, 0));
+
+    reset();
+    memset(cmd, 'A', sizeof(cmd) - 1);
+    cmd[sizeof(cmd) - 1] = '\0';
+    TEST_ASSERT_FALSE(at_sched_submit(&s_sched, cmd, 0, NULL, NULL, NULL, 0));
+
+    /* A completion callback may queue the follow-up command */
+    at_sched_submit(&s_sched, "AT+CMGD=3", 0, NULL, chain_done, "d", 0);
+    line("OK", 1);
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=3|AT+CMGL=4|", s_wire);
+}
+
+void test_at_sched_cancel_in_flight(void) {
+    reset();
+    TEST_ASSERT_NULL(at_sched_current(&s_sched));
+    TEST_ASSERT_FALSE(at_sched_cancel(&s_sched, 0));
+
+    at_sched_submit(&s_sched, "AT+CMGR=4", 0, NULL, on_done, "r", 0);
+    at_sched_submit(&s_sched, "AT+CMGD=2", 0, NULL, on_done, "d", 0);
+    TEST_ASSERT_EQUAL_STRING("AT+CMGR=4", at_sched_current(&s_sched));
+
+    /* Cancelled at once, without waiting for the timeout; the next one is held */
+    TEST_ASSERT_TRUE(at_sched_cancel(&s_sched, 10));
+    TEST_ASSERT_EQUAL_STRING("r=4/-1;", s_events);
+    TEST_ASSERT_EQUAL_STRING("AT+CMGR=4|", s_wire);
+    TEST_ASSERT_NULL(at_sched_current(&s_sched));
+
+    /* The cancelled read's OK turns up: not credited to the delete */
+    TEST_ASSERT_TRUE(at_sched_on_line(&s_sched, "OK", 2, 50));
+    TEST_ASSERT_EQUAL_STRING("r=4/-1;", s_events);
+    TEST_ASSERT_FALSE(at_sched_cancel(&s_sched, 60));
+
+    at_sched_poll(&s_sched, 50 + AT_SCHED_QUIET_MS);
+    TEST_ASSERT_EQUAL_STRING("AT+CMGR=4|AT|", s_wire);
+    line("OK", 300);
+    at_sched_poll(&s_sched, 300 + AT_SCHED_QUIET_MS);
+    TEST_ASSERT_EQUAL_STRING("AT+CMGR=4|AT|AT+CMGD=2|", s_wire);
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=2", at_sched_current(&s_sched));
+    TEST_ASSERT_EQUAL_INT(1, (int)s_sched.resyncs);
+    TEST_ASSERT_EQUAL_INT(1, (int)s_sched.cancelled);
+    TEST_ASSERT_EQUAL_INT(0, (int)s_sched.timeouts);
+}
+
+void run_at_sched_tests(void) {
+    printf("\n=== AT Scheduler Tests ===\n");
+    RUN_TEST(test_at_sched_issues_next_on_completion);
+    RUN_TEST(test_at_sched_error_codes);
+    RUN_TEST(test_at_sched_intermediate_lines_go_to_command);
+    RUN_TEST(test_at_sched_timeout_moves_on);
+    RUN_TEST(test_at_sched_late_ok_after_timeout_not_credited);
+    RUN_TEST(test_at_sched_sentinel_retried);
+    RUN_TEST(test_at_sched_queue_full_and_chaining);
+    RUN_TEST(test_at_sched_submit_front_jumps_queue);
+    RUN_TEST(test_at_sched_cancel_in_flight);
+}
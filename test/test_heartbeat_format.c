@@ -44,6 +44,83 @@ void test_hb_mqtt_false_and_wdt_reason(void) {
         buf);
 }
 
+void test_hb_uart_overflows_only_when_nonzero(void) {
+    heartbeat_info_t hb = {
+        .device = "ESP32_7c7038",
+        .reset_reason = "POWERON",
+        .boot_id = 1u,
+        .uptime_s = 5u,
+        .free_heap = 100u,
+        .mqtt_connected = true,
+        .uart_overflows = 3u,
+    };
+    char buf[256];
+    int n = format_heartbeat_json(buf, sizeof(buf), &hb);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"device\":\"ESP32_7c7038\",\"boot_id\":1,\"reset_reason\":\"POWERON\","
+        "\"uptime_s\":5,\"free_heap\":100,\"mqtt\":true,\"uart_overflows\":3}",
+        buf);
+    TEST_ASSERT_EQUAL_INT((int)strlen(buf), n);
+
+    /* The closing brace must fit too */
+    TEST_ASSERT_EQUAL_INT(-1, format_heartbeat_json(buf, (size_t)n, &hb));
+}
+
+void test_hb_sms_pool_once_used(void) {
+    heartbeat_info_t hb = {
+        .device = "ESP32_7c7038",
+        .reset_reason = "POWERON",
+        .boot_id = 1u,
+        .uptime_s = 5u,
+        .free_heap = 100u,
+        .mqtt_connected = true,
+        .sms_blocks = 40u,
+        .sms_blocks_free_min = 40u,
+    };
+    char buf[256];
+
+    /* Pool never touched: nothing to report */
+    format_heartbeat_json(buf, sizeof(buf), &hb);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"device\":\"ESP32_7c7038\",\"boot_id\":1,\"reset_reason\":\"POWERON\","
+        "\"uptime_s\":5,\"free_heap\":100,\"mqtt\":true}",
+        buf);
+
+    hb.sms_blocks_free_min = 0u;
+    hb.sms_evictions = 2u;
+    hb.uart_overflows = 1u;
+    int n = format_heartbeat_json(buf, sizeof(buf), &hb);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"device\":\"ESP32_7c7038\",\"boot_id\":1,\"reset_reason\":\"POWERON\","
+        "\"uptime_s\":5,\"free_heap\":100,\"mqtt\":true,\"uart_overflows\":1,"
+        "\"sms_pool\":{\"blocks\":40,\"free_min\":0,\"evictions\":2}}",
+        buf);
+    TEST_ASSERT_EQUAL_INT((int)strlen(buf), n);
+    TEST_ASSERT_EQUAL_INT(-1, format_heartbeat_json(buf, (size_t)n, &hb));
+}
+
+void test_hb_sim_storage_when_known(void) {
+    heartbeat_info_t hb = {
+        .device = "ESP32_7c7038",
+        .reset_reason = "POWERON",
+        .boot_id = 1u,
+        .uptime_s = 5u,
+        .free_heap = 100u,
+        .mqtt_connected = true,
+        .sim_used = 12u,
+        .sim_total = 50u,
+    };
+    char buf[256];
+    int n = format_heartbeat_json(buf, sizeof(buf), &hb);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"device\":\"ESP32_7c7038\",\"boot_id\":1,\"reset_reason\":\"POWERON\","
+        "\"uptime_s\":5,\"free_heap\":100,\"mqtt\":true,"
+        "\"sim_storage\":{\"used\":12,\"total\":50}}",
+        buf);
+    TEST_ASSERT_EQUAL_INT((int)strlen(buf), n);
+    TEST_ASSERT_EQUAL_INT(-1, format_heartbeat_json(buf, (size_t)n, &hb));
+}
+
 void test_hb_null_args(void) {
     heartbeat_info_t hb = {0};
     char buf[64];
@@ -83,4 +160,7 @@ void run_heartbeat_format_tests(void) {
     RUN_TEST(test_hb_null_args);
     RUN_TEST(test_hb_null_strings_safe);
     RUN_TEST(test_hb_truncation_returns_negative);
+    RUN_TEST(test_hb_uart_overflows_only_when_nonzero);
+    RUN_TEST(test_hb_sms_pool_once_used);
+    RUN_TEST(test_hb_sim_storage_when_known);
 }
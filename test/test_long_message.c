@@ -3,11 +3,11 @@
  * @brief End-to-end verification of LONG (concatenated) SMS handling.
  *
  * Unlike test_pdu_decoder.c (which mostly checks "does not crash") and
- * test_sms_assembly.c (which feeds synthetic pdu_sms_t structs), this file
- * drives the REAL pdu_decode() with REAL multi-part PDU hex strings -- the
- * exact bytes a SIM900A emits in an AT+CMGL response -- then reassembles the
- * fragments and asserts the final message is byte-exact and in the right
- * order.
+ * test_sms_assembly.c (which builds its parts in the test), this file
+ * drives the REAL decoder with REAL multi-part PDU hex strings -- the exact
+ * bytes a SIM900A emits in an AT+CMGL response -- then reassembles the
+ * parts with sms_assembly.c, as the publish task does, and asserts the
+ * final message is byte-exact and in the right order.
  *
  * This is the path where "long message gets split / scrambled" bugs live.
  *
@@ -22,54 +22,32 @@
 
 #include "unity.h"
 #include "pdu_decoder.h"
-
-/* ---- Minimal ordered reassembler -------------------------------------
- * Mirrors publish_assembled_sms()'s concatenation: place each fragment at
- * fragments[part_num] and join 1..total_parts in order. This isolates the
- * decode + ordering behavior (assembly-buffer slot management is already
- * covered by the 21 tests in test_sms_assembly.c).
- */
-typedef struct {
-    uint16_t ref_num;
-    uint8_t  total_parts;
-    uint8_t  received_parts;
-    bool     active;
-    char     fragments[11][PDU_MAX_MESSAGE_LEN]; /* 1-based, up to 10 parts */
-    bool     part_received[11];
-    char     sender[PDU_MAX_SENDER_LEN];
-} reasm_t;
-
-static void reasm_reset(reasm_t *r) { memset(r, 0, sizeof(*r)); }
-
-/* Feed one decoded PDU. Returns true when the message is complete. */
-static bool reasm_feed(reasm_t *r, const pdu_sms_t *sms) {
-    if (!sms->is_multipart) {
-        /* single -> "complete" with one fragment */
-        strncpy(r->fragments[1], sms->message, PDU_MAX_MESSAGE_LEN - 1);
-        r->part_received[1] = true;
-        r->total_parts = 1;
-        r->received_parts = 1;
-        strncpy(r->sender, sms->sender, sizeof(r->sender) - 1);
-        return true;
-    }
-    if (sms->part_num < 1 || sms->part_num > 10) return false;
-    if (!r->active) { r->active = true; r->ref_num = sms->ref_num; r->total_parts = sms->total_parts; }
-    strncpy(r->sender, sms->sender, sizeof(r->sender) - 1);
-    if (!r->part_received[sms->part_num]) {
-        r->part_received[sms->part_num] = true;
-        strncpy(r->fragments[sms->part_num], sms->message, PDU_MAX_MESSAGE_LEN - 1);
-        r->received_parts++;
-    }
-    return r->received_parts >= r->total_parts;
+#include "pdu_hex.h"
+#include "sms_assembly.h"
+
+static sms_assembly_t s_as;
+
+/* Hex PDU -> view -> sms_assembly_add(), as handle_sms_view() does.
+ * Returns true when the message is complete. */
+static bool feed_hex(const char *hex, sms_assembly_slot_t **slot) {
+    static uint8_t pdu[PDU_MAX_OCTETS];
+    size_t len = strlen(hex);
+    pdu_sms_view_t view;
+    char sender[PDU_MAX_SENDER_LEN];
+
+    TEST_ASSERT_TRUE(len / 2 <= sizeof(pdu));
+    TEST_ASSERT_TRUE(pdu_hex_decode(hex, len, pdu, NULL));
+    TEST_ASSERT_TRUE(pdu_view_parse(pdu, len / 2, &view));
+    pdu_view_sender(&view, sender, sizeof(sender));
+    sms_assembly_result_t r = sms_assembly_add(&s_as, sender, &view, 0, 0, slot);
+    TEST_ASSERT_TRUE(r == SMS_ASSEMBLY_STORED || r == SMS_ASSEMBLY_COMPLETE);
+    return r == SMS_ASSEMBLY_COMPLETE;
 }
 
-static void reasm_join(const reasm_t *r, char *out, size_t out_size) {
-    out[0] = '\0';
-    for (int i = 1; i <= r->total_parts && i <= 10; i++) {
-        if (r->part_received[i]) {
-            strncat(out, r->fragments[i], out_size - strlen(out) - 1);
-        }
-    }
+static void join(const sms_assembly_slot_t *slot, char *out, size_t out_size) {
+    bool truncated = true;
+    sms_assembly_text(&s_as, slot, out, out_size, &truncated);
+    TEST_ASSERT_FALSE(truncated);
 }
 
 /* ====================================================================== */
@@ -124,36 +102,31 @@ void test_long_ucs2_each_part_detected_as_multipart(void) {
 }
 
 void test_long_ucs2_reassembled_in_order(void) {
-    reasm_t r; reasm_reset(&r);
-    pdu_sms_t s1, s2, s3;
-    TEST_ASSERT_TRUE(pdu_decode(PDU_UCS2_PART1, &s1));
-    TEST_ASSERT_TRUE(pdu_decode(PDU_UCS2_PART2, &s2));
-    TEST_ASSERT_TRUE(pdu_decode(PDU_UCS2_PART3, &s3));
+    sms_assembly_slot_t *slot;
+    sms_assembly_init(&s_as);
 
     /* in-order feed */
-    TEST_ASSERT_FALSE(reasm_feed(&r, &s1));
-    TEST_ASSERT_FALSE(reasm_feed(&r, &s2));
-    TEST_ASSERT_TRUE(reasm_feed(&r, &s3));
+    TEST_ASSERT_FALSE(feed_hex(PDU_UCS2_PART1, &slot));
+    TEST_ASSERT_FALSE(feed_hex(PDU_UCS2_PART2, &slot));
+    TEST_ASSERT_TRUE(feed_hex(PDU_UCS2_PART3, &slot));
+    TEST_ASSERT_EQUAL_STRING("+886987654321", slot->sender);
 
     char joined[1024];
-    reasm_join(&r, joined, sizeof(joined));
+    join(slot, joined, sizeof(joined));
     TEST_ASSERT_EQUAL_STRING((const char *)EXPECTED_UCS2_UTF8, joined);
 }
 
 void test_long_ucs2_reassembled_scrambled_order(void) {
-    reasm_t r; reasm_reset(&r);
-    pdu_sms_t s1, s2, s3;
-    TEST_ASSERT_TRUE(pdu_decode(PDU_UCS2_PART1, &s1));
-    TEST_ASSERT_TRUE(pdu_decode(PDU_UCS2_PART2, &s2));
-    TEST_ASSERT_TRUE(pdu_decode(PDU_UCS2_PART3, &s3));
+    sms_assembly_slot_t *slot;
+    sms_assembly_init(&s_as);
 
     /* arrive 3, 1, 2 -- final text must STILL be in logical order */
-    TEST_ASSERT_FALSE(reasm_feed(&r, &s3));
-    TEST_ASSERT_FALSE(reasm_feed(&r, &s1));
-    TEST_ASSERT_TRUE(reasm_feed(&r, &s2));
+    TEST_ASSERT_FALSE(feed_hex(PDU_UCS2_PART3, &slot));
+    TEST_ASSERT_FALSE(feed_hex(PDU_UCS2_PART1, &slot));
+    TEST_ASSERT_TRUE(feed_hex(PDU_UCS2_PART2, &slot));
 
     char joined[1024];
-    reasm_join(&r, joined, sizeof(joined));
+    join(slot, joined, sizeof(joined));
     TEST_ASSERT_EQUAL_STRING((const char *)EXPECTED_UCS2_UTF8, joined);
 }
 
@@ -194,17 +167,15 @@ void test_long_gsm7_multipart_header_decoded(void) {
 }
 
 void test_long_gsm7_reassembled(void) {
-    reasm_t r; reasm_reset(&r);
-    pdu_sms_t s1, s2;
-    TEST_ASSERT_TRUE(pdu_decode(PDU_GSM7_PART1, &s1));
-    TEST_ASSERT_TRUE(pdu_decode(PDU_GSM7_PART2, &s2));
+    sms_assembly_slot_t *slot;
+    sms_assembly_init(&s_as);
 
     /* out of order: part 2 first */
-    TEST_ASSERT_FALSE(reasm_feed(&r, &s2));
-    TEST_ASSERT_TRUE(reasm_feed(&r, &s1));
+    TEST_ASSERT_FALSE(feed_hex(PDU_GSM7_PART2, &slot));
+    TEST_ASSERT_TRUE(feed_hex(PDU_GSM7_PART1, &slot));
 
     char joined[1024];
-    reasm_join(&r, joined, sizeof(joined));
+    join(slot, joined, sizeof(joined));
     TEST_ASSERT_EQUAL_STRING("hellohello", joined);
 }
 
@@ -15,7 +15,14 @@ const char *unity_current_test = "";
 #include "unity.h"
 
 extern void run_pdu_decoder_tests(void);
+extern void run_pdu_hex_tests(void);
+extern void run_at_parser_tests(void);
+extern void run_at_sched_tests(void);
+extern void run_sim_storage_tests(void);
+extern void run_spsc_ring_tests(void);
+extern void run_sms_codec_tests(void);
 extern void run_sms_assembly_tests(void);
+extern void run_sms_reassembly_tests(void);
 extern void run_long_message_tests(void);
 extern void run_health_logic_tests(void);
 extern void run_heartbeat_format_tests(void);
@@ -26,7 +33,14 @@ int main(void) {
     printf("========================================\n");
 
     run_pdu_decoder_tests();
+    run_pdu_hex_tests();
+    run_at_parser_tests();
+    run_at_sched_tests();
+    run_sim_storage_tests();
+    run_spsc_ring_tests();
+    run_sms_codec_tests();
     run_sms_assembly_tests();
+    run_sms_reassembly_tests();
     run_long_message_tests();
     run_health_logic_tests();
     run_heartbeat_format_tests();
@@ -8,6 +8,7 @@
 
 #include "unity.h"
 #include "pdu_decoder.h"
+#include "sms_codec.h"
 
 /* ========== GSM 7-bit Single SMS ========== */
 
@@ -241,6 +242,394 @@ void test_pdu_decode_output_clears_struct(void) {
     TEST_ASSERT_EQUAL_UINT16(0, sms.ref_num);
 }
 
+/* ========== GSM 03.38 alphabet ========== */
+
+void test_pdu_decode_gsm7_extension_chars(void) {
+    // "<euro>5 @home": 9 septets 1B 65 35 20 00 68 6F 6D 65 (escape + '@' = 0x00)
+    const char *pdu = "00000481214300009930925161958009" "9B720D0440BFDB65";
+    static const unsigned char expected[] = { 0xE2, 0x82, 0xAC, '5', ' ', '@', 'h', 'o', 'm', 'e', 0x00 };
+    pdu_sms_t sms;
+    TEST_ASSERT_TRUE(pdu_decode(pdu, &sms));
+    TEST_ASSERT_EQUAL_STRING((const char *)expected, sms.message);
+}
+
+/* ========== Binary API ========== */
+
+void test_pdu_decode_bytes_matches_hex(void) {
+    // Same "hello" from "1234" PDU as above, pre-converted to octets
+    static const uint8_t pdu[] = {
+        0x00, 0x00, 0x04, 0x81, 0x21, 0x43, 0x00, 0x00,
+        0x99, 0x30, 0x92, 0x51, 0x61, 0x95, 0x80,
+        0x05, 0xE8, 0x32, 0x9B, 0xFD, 0x06
+    };
+    pdu_sms_t from_bytes, from_hex;
+    TEST_ASSERT_TRUE(pdu_decode_bytes(pdu, sizeof(pdu), &from_bytes));
+    TEST_ASSERT_TRUE(pdu_decode("00000481214300009930925161958005E8329BFD06", &from_hex));
+    TEST_ASSERT_EQUAL_STRING("1234", from_bytes.sender);
+    TEST_ASSERT_EQUAL_STRING("hello", from_bytes.message);
+    TEST_ASSERT_EQUAL_STRING(from_hex.sender, from_bytes.sender);
+    TEST_ASSERT_EQUAL_STRING(from_hex.message, from_bytes.message);
+}
+
+void test_pdu_decode_bytes_truncated_udh(void) {
+    // UDHI set, UDHL claims 5 octets but the PDU ends after 2
+    static const uint8_t pdu[] = {
+        0x00, 0x40, 0x04, 0x81, 0x21, 0x43, 0x00, 0x08,
+        0x99, 0x30, 0x92, 0x51, 0x61, 0x95, 0x80,
+        0x0A, 0x05, 0x00
+    };
+    pdu_sms_t sms;
+    TEST_ASSERT_FALSE(pdu_decode_bytes(pdu, sizeof(pdu), &sms));
+    TEST_ASSERT_FALSE(pdu_decode_bytes(NULL, 10, &sms));
+}
+
+void test_pdu_decode_invalid_hex_rejected(void) {
+    pdu_sms_t sms;
+    TEST_ASSERT_FALSE(pdu_decode("00000481214300009930925161958005E8329BFDZZ", &sms));
+}
+
+/* ========== Streaming API ========== */
+
+// Feed a whole line in chunks of `chunk` bytes; returns the last non-MORE result
+static pdu_stream_result_t stream_line(const char *line, size_t chunk, pdu_sms_view_t *out) {
+    static pdu_stream_t ctx;
+    pdu_stream_result_t last = PDU_STREAM_MORE;
+    size_t len = strlen(line);
+    size_t pos = 0;
+
+    pdu_stream_begin(&ctx);
+    while (pos < len && pdu_stream_busy(&ctx)) {
+        size_t n = (len - pos < chunk) ? len - pos : chunk;
+        size_t used = 0;
+        pdu_stream_result_t r = pdu_stream_feed(&ctx, line + pos, n, &used, out);
+        if (r != PDU_STREAM_MORE) last = r;
+        pos += used;
+    }
+    return last;
+}
+
+void test_pdu_stream_matches_decode_any_chunking(void) {
+    static const char *pdus[] = {
+        "00000481214300009930925161958005E8329BFD06",
+        "00000481214300009930925161958009" "9B720D0440BFDB65",
+        "004004812143000899309251619580" "0A" "050003A50201" "4F605B98",
+        "004004812143000899309251619580" "0B" "06080401A50302" "4F605B98",
+    };
+    static const size_t chunks[] = { 1, 2, 3, 7, 64 };
+
+    for (size_t p = 0; p < sizeof(pdus) / sizeof(pdus[0]); p++) {
+        pdu_sms_t expected;
+        TEST_ASSERT_TRUE(pdu_decode(pdus[p], &expected));
+
+        for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+            char line[160];
+            char sender[PDU_MAX_SENDER_LEN], text[PDU_MAX_MESSAGE_LEN];
+            pdu_sms_view_t view;
+            snprintf(line, sizeof(line), "%s\r\n", pdus[p]);
+            TEST_ASSERT_EQUAL_INT(PDU_STREAM_DECODED, stream_line(line, chunks[c], &view));
+            pdu_view_sender(&view, sender, sizeof(sender));
+            pdu_view_text(&view, text, sizeof(text));
+            TEST_ASSERT_EQUAL_STRING(expected.sender, sender);
+            TEST_ASSERT_EQUAL_STRING(expected.message, text);
+            TEST_ASSERT_EQUAL_UINT16(expected.ref_num, view.ref_num);
+            TEST_ASSERT_EQUAL_UINT8(expected.part_num, view.part_num);
+        }
+    }
+}
+
+void test_pdu_stream_decodes_before_line_end(void) {
+    pdu_stream_t ctx;
+    pdu_sms_view_t sms;
+    char text[PDU_MAX_MESSAGE_LEN];
+    size_t used = 0;
+    const char *line = "00000481214300009930925161958005E8329BFD06\r\nOK\r\n";
+
+    pdu_stream_begin(&ctx);
+    TEST_ASSERT_EQUAL_INT(PDU_STREAM_DECODED, pdu_stream_feed(&ctx, line, strlen(line), &used, &sms));
+    TEST_ASSERT_EQUAL_INT(42, (int)used);
+    pdu_view_text(&sms, text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("hello", text);
+
+    // The terminator is left for the caller's line parser
+    TEST_ASSERT_TRUE(pdu_stream_busy(&ctx));
+    TEST_ASSERT_EQUAL_INT(PDU_STREAM_MORE, pdu_stream_feed(&ctx, line + used, strlen(line + used), &used, &sms));
+    TEST_ASSERT_EQUAL_INT(0, (int)used);
+    TEST_ASSERT_FALSE(pdu_stream_busy(&ctx));
+}
+
+void test_pdu_stream_rejects_submit_early(void) {
+    pdu_stream_t ctx;
+    pdu_sms_view_t sms;
+    size_t used = 0;
+
+    // SMS-SUBMIT is refused from the type octet, before the rest arrives
+    pdu_stream_begin(&ctx);
+    TEST_ASSERT_EQUAL_INT(PDU_STREAM_FAILED, pdu_stream_feed(&ctx, "0001", 4, &used, &sms));
+    TEST_ASSERT_EQUAL_INT(4, (int)used);
+
+    // ...and the rest of the line is skipped up to the terminator
+    TEST_ASSERT_EQUAL_INT(PDU_STREAM_MORE, pdu_stream_feed(&ctx, "0481214300\r\n", 12, &used, &sms));
+    TEST_ASSERT_EQUAL_INT(10, (int)used);
+    TEST_ASSERT_FALSE(pdu_stream_busy(&ctx));
+}
+
+void test_pdu_stream_invalid_hex_and_short_line(void) {
+    pdu_sms_view_t sms;
+    TEST_ASSERT_EQUAL_INT(PDU_STREAM_FAILED,
+                          stream_line("00000481214300009930925161958005E8329BFDZZ\r\n", 5, &sms));
+    TEST_ASSERT_EQUAL_INT(PDU_STREAM_FAILED, stream_line("0000\r\n", 1, &sms));
+    // Line ends inside the SMSC address
+    TEST_ASSERT_EQUAL_INT(PDU_STREAM_FAILED, stream_line("0791\r\n", 4, &sms));
+}
+
+/* ========== Batch API ========== */
+
+#define HELLO_PDU  "00000481214300009930925161958005E8329BFD06"
+#define EURO_PDU   "00000481214300009930925161958009" "9B720D0440BFDB65"
+
+void test_pdu_batch_decodes_whole_listing(void) {
+    const char *resp =
+        "\r\n+CMGL: 3,1,,21\r\n" HELLO_PDU "\r\n"
+        "+CMGL: 7,0,\"\",23\r\n" EURO_PDU "\r\n"
+        "\r\nOK\r\n";
+    static pdu_cmgl_record_t recs[4];
+    char buf[PDU_MAX_MESSAGE_LEN];
+    size_t used = 0;
+
+    TEST_ASSERT_EQUAL_INT(2, (int)pdu_decode_batch(resp, strlen(resp), recs, 4, &used));
+    TEST_ASSERT_EQUAL_INT(3, recs[0].index);
+    TEST_ASSERT_EQUAL_INT(1, recs[0].stat);
+    pdu_view_text(&recs[0].view, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("hello", buf);
+    TEST_ASSERT_EQUAL_INT(7, recs[1].index);
+    TEST_ASSERT_EQUAL_INT(0, recs[1].stat);
+    pdu_view_sender(&recs[1].view, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("1234", buf);
+
+    // Stops at the final OK and leaves it for the caller
+    TEST_ASSERT_EQUAL_STRING("OK\r\n", resp + used);
+}
+
+void test_pdu_batch_leaves_partial_record(void) {
+    const char *resp =
+        "+CMGL: 1,1,,21\r\n" HELLO_PDU "\r\n"
+        "+CMGL: 2,1,,21\r\n" "0000048121430000";
+    static pdu_cmgl_record_t recs[4];
+    size_t used = 0;
+
+    TEST_ASSERT_EQUAL_INT(1, (int)pdu_decode_batch(resp, strlen(resp), recs, 4, &used));
+    TEST_ASSERT_EQUAL_STRING("+CMGL: 2,1,,21\r\n0000048121430000", resp + used);
+}
+
+void test_pdu_batch_respects_capacity_and_drops_bad(void) {
+    const char *resp =
+        "+CMGL: 1,1,,21\r\n" "0001048121430000\r\n"    /* SMS-SUBMIT: dropped */
+        "+CMGL: 2,1,,21\r\n" HELLO_PDU "\r\n"
+        "+CMGL: 4,1,,21\r\n" HELLO_PDU "\r\n";
+    static pdu_cmgl_record_t recs[1];
+    size_t used = 0;
+
+    TEST_ASSERT_EQUAL_INT(1, (int)pdu_decode_batch(resp, strlen(resp), recs, 1, &used));
+    TEST_ASSERT_EQUAL_INT(2, recs[0].index);
+    TEST_ASSERT_EQUAL_INT(0, strncmp(resp + used, "+CMGL: 4,", 9));
+
+    TEST_ASSERT_EQUAL_INT(0, (int)pdu_decode_batch(resp, strlen(resp), recs, 0, &used));
+    TEST_ASSERT_EQUAL_INT(0, (int)used);
+}
+
+/* ========== Lazy view ========== */
+
+void test_pdu_view_fields_without_decoding(void) {
+    /* "hello" from 1234, PID 0x40, SCTS 99-03-29 15:16:59, TZ +08 quarters */
+    static const uint8_t pdu[] = {
+        0x00, 0x00, 0x04, 0x81, 0x21, 0x43, 0x40, 0x00,
+        0x99, 0x30, 0x92, 0x51, 0x61, 0x95, 0x80,
+        0x05, 0xE8, 0x32, 0x9B, 0xFD, 0x06
+    };
+    pdu_sms_view_t view;
+    pdu_timestamp_t ts;
+    char buf[PDU_MAX_MESSAGE_LEN];
+
+    TEST_ASSERT_TRUE(pdu_view_parse(pdu, sizeof(pdu), &view));
+    TEST_ASSERT_EQUAL_UINT8(0x40, pdu_view_pid(&view));
+    TEST_ASSERT_EQUAL_UINT8(0x00, view.dcs);
+    TEST_ASSERT_EQUAL_INT(16, view.ud_pos);
+    TEST_ASSERT_EQUAL_INT(0, view.udh_len);
+    TEST_ASSERT_FALSE(view.is_multipart);
+
+    TEST_ASSERT_TRUE(pdu_view_timestamp(&view, &ts));
+    TEST_ASSERT_EQUAL_UINT8(99, ts.year);
+    TEST_ASSERT_EQUAL_UINT8(3, ts.month);
+    TEST_ASSERT_EQUAL_UINT8(29, ts.day);
+    TEST_ASSERT_EQUAL_UINT8(15, ts.hour);
+    TEST_ASSERT_EQUAL_UINT8(16, ts.minute);
+    TEST_ASSERT_EQUAL_UINT8(59, ts.second);
+    TEST_ASSERT_EQUAL_INT(8, ts.tz_quarters);
+
+    TEST_ASSERT_EQUAL_INT(4, (int)pdu_view_sender(&view, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("1234", buf);
+    TEST_ASSERT_EQUAL_INT(5, (int)pdu_view_text(&view, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("hello", buf);
+}
+
+void test_pdu_view_concat_key_and_negative_tz(void) {
+    /* 16-bit concat ref 0x01A5 part 2/3, UCS2, TZ octet 0x4A = -(2*10+4) */
+    static const uint8_t pdu[] = {
+        0x00, 0x40, 0x04, 0x81, 0x21, 0x43, 0x00, 0x08,
+        0x99, 0x30, 0x92, 0x51, 0x61, 0x95, 0x4A,
+        0x0B, 0x06, 0x08, 0x04, 0x01, 0xA5, 0x03, 0x02, 0x4F, 0x60, 0x59, 0x7D
+    };
+    static const unsigned char expected[] = { 0xE4, 0xBD, 0xA0, 0xE5, 0xA5, 0xBD, 0x00 };
+    pdu_sms_view_t view;
+    pdu_timestamp_t ts;
+    char buf[32];
+
+    TEST_ASSERT_TRUE(pdu_view_parse(pdu, sizeof(pdu), &view));
+    TEST_ASSERT_TRUE(view.is_multipart);
+    TEST_ASSERT_EQUAL_UINT16(0x01A5, view.ref_num);
+    TEST_ASSERT_EQUAL_UINT8(3, view.total_parts);
+    TEST_ASSERT_EQUAL_UINT8(2, view.part_num);
+    TEST_ASSERT_EQUAL_INT(7, view.udh_len);
+
+    TEST_ASSERT_TRUE(pdu_view_timestamp(&view, &ts));
+    TEST_ASSERT_EQUAL_INT(-24, ts.tz_quarters);
+
+    pdu_view_text(&view, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING((const char *)expected, buf);
+}
+
+/* ========== Text arena ========== */
+
+void test_pdu_arena_slices_back_to_back(void) {
+    static const uint8_t hello[] = {
+        0x00, 0x00, 0x04, 0x81, 0x21, 0x43, 0x00, 0x00,
+        0x99, 0x30, 0x92, 0x51, 0x61, 0x95, 0x80,
+        0x05, 0xE8, 0x32, 0x9B, 0xFD, 0x06
+    };
+    pdu_sms_view_t view;
+    pdu_arena_t arena;
+    pdu_text_t a, b;
+    char buf[64];
+
+    pdu_arena_init(&arena, buf, sizeof(buf));
+    TEST_ASSERT_TRUE(pdu_view_parse(hello, sizeof(hello), &view));
+    TEST_ASSERT_TRUE(pdu_view_text_bound(&view) <= sizeof(buf));
+
+    TEST_ASSERT_TRUE(pdu_view_text_alloc(&view, &arena, &a));
+    TEST_ASSERT_TRUE(pdu_view_text_alloc(&view, &arena, &b));
+    TEST_ASSERT_EQUAL_INT(5, (int)a.len);
+    TEST_ASSERT_EQUAL_STRING("hello", a.ptr);
+    TEST_ASSERT_EQUAL_STRING("hello", b.ptr);
+    /* Only the decoded length (plus NUL) is consumed, not the bound */
+    TEST_ASSERT_TRUE(b.ptr == a.ptr + 6);
+    TEST_ASSERT_EQUAL_INT(12, (int)arena.used);
+}
+
+void test_pdu_arena_overflow_is_reported(void) {
+    /* UCS2 "<ni><hao>": bound 2 * 3 + 5 = 11 */
+    static const uint8_t pdu[] = {
+        0x00, 0x00, 0x04, 0x81, 0x21, 0x43, 0x00, 0x08,
+        0x99, 0x30, 0x92, 0x51, 0x61, 0x95, 0x80,
+        0x04, 0x4F, 0x60, 0x59, 0x7D
+    };
+    pdu_sms_view_t view;
+    pdu_arena_t arena;
+    pdu_text_t t;
+    char buf[16];
+
+    TEST_ASSERT_TRUE(pdu_view_parse(pdu, sizeof(pdu), &view));
+    TEST_ASSERT_EQUAL_INT(11, (int)pdu_view_text_bound(&view));
+
+    pdu_arena_init(&arena, buf, sizeof(buf));
+    arena.used = 6;
+    TEST_ASSERT_FALSE(pdu_view_text_alloc(&view, &arena, &t));
+    TEST_ASSERT_EQUAL_INT(6, (int)arena.used);
+    TEST_ASSERT_EQUAL_INT(0, (int)t.len);
+
+    pdu_arena_reset(&arena);
+    TEST_ASSERT_TRUE(pdu_view_text_alloc(&view, &arena, &t));
+    TEST_ASSERT_EQUAL_INT(6, (int)t.len);
+    TEST_ASSERT_EQUAL_INT(7, (int)arena.used);
+}
+
+void test_pdu_arena_fits_full_locking_shift_sms(void) {
+    /* 140-octet UD: Turkish locking shift UDH (4 octets, 3 fill bits), then
+     * 155 septets of 0x04, which is the 3-byte euro sign in that table */
+    uint8_t pdu[15 + 1 + 140] = {
+        0x00, 0x40, 0x04, 0x81, 0x21, 0x43, 0x00, 0x00,
+        0x99, 0x30, 0x92, 0x51, 0x61, 0x95, 0x80,
+        160, 0x03, PDU_IEI_NL_LOCKING, 0x01, GSM7_LANG_TURKISH
+    };
+    uint8_t *ud = pdu + 16;
+    for (size_t k = 0; k < 155; k++) {
+        for (unsigned b = 0; b < 7; b++) {
+            size_t bit = 35 + k * 7 + b;
+            ud[bit / 8] |= (uint8_t)(((0x04 >> b) & 1) << (bit % 8));
+        }
+    }
+
+    pdu_sms_view_t view;
+    pdu_arena_t arena;
+    pdu_text_t t;
+    static char buf[PDU_TEXT_BOUND_SMS];
+
+    TEST_ASSERT_TRUE(pdu_view_parse(pdu, sizeof(pdu), &view));
+    TEST_ASSERT_EQUAL_UINT8(GSM7_LANG_TURKISH, view.nl_locking);
+    TEST_ASSERT_EQUAL_INT(155 * 3 + 4, (int)pdu_view_text_bound(&view));
+
+    pdu_arena_init(&arena, buf, sizeof(buf));
+    TEST_ASSERT_TRUE(pdu_view_text_alloc(&view, &arena, &t));
+    TEST_ASSERT_EQUAL_INT(155 * 3, (int)t.len);
+    TEST_ASSERT_EQUAL_STRING("\xE2\x82\xAC", t.ptr + t.len - 3);
+}
+
+/* ========== UDH IE index ========== */
+
+void test_pdu_view_indexes_all_udh_ies(void) {
+    /* UDH: ports 0B84->23F0, concat ref A5 2/1, Turkish single shift,
+     * special indication (voicemail, 1 waiting). Text: ESC 73 'a' = "<s-cedilla>a" */
+    const char *pdu = "004004812143000099309251619580"
+                      "19"
+                      "12" "05040B8423F0" "0003A50201" "250101" "01020100"
+                      "6CE661";
+    uint8_t bin[64];
+    size_t len = strlen(pdu) / 2;
+    for (size_t i = 0; i < len; i++) {
+        unsigned v;
+        sscanf(pdu + i * 2, "%2X", &v);
+        bin[i] = (uint8_t)v;
+    }
+
+    pdu_sms_view_t view;
+    char text[16];
+    TEST_ASSERT_TRUE(pdu_view_parse(bin, len, &view));
+
+    TEST_ASSERT_EQUAL_INT(4, view.udh.count);
+    TEST_ASSERT_EQUAL_INT(0, view.udh.dropped);
+    TEST_ASSERT_EQUAL_UINT8(PDU_IEI_PORTS_16, view.udh.ie[0].iei);
+    TEST_ASSERT_EQUAL_UINT8(PDU_IEI_CONCAT_8, view.udh.ie[1].iei);
+    TEST_ASSERT_EQUAL_UINT8(PDU_IEI_NL_SINGLE, view.udh.ie[2].iei);
+    TEST_ASSERT_EQUAL_UINT8(PDU_IEI_SPECIAL_SMS, view.udh.ie[3].iei);
+
+    TEST_ASSERT_TRUE(view.has_ports);
+    TEST_ASSERT_EQUAL_UINT16(0x0B84, view.dst_port);
+    TEST_ASSERT_EQUAL_UINT16(0x23F0, view.src_port);
+    TEST_ASSERT_TRUE(view.is_multipart);
+    TEST_ASSERT_EQUAL_UINT16(0xA5, view.ref_num);
+    TEST_ASSERT_EQUAL_UINT8(0, view.nl_locking);
+    TEST_ASSERT_EQUAL_UINT8(1, view.nl_single);
+
+    const pdu_udh_ie_t *special = pdu_view_find_ie(&view, PDU_IEI_SPECIAL_SMS);
+    TEST_ASSERT_NOT_NULL(special);
+    TEST_ASSERT_EQUAL_UINT8(2, special->len);
+    TEST_ASSERT_EQUAL_UINT8(0x01, pdu_view_ie_data(&view, special)[0]);
+    TEST_ASSERT_NULL(pdu_view_find_ie(&view, PDU_IEI_NL_LOCKING));
+
+    /* The single shift ID reaches the 7-bit decoder */
+    pdu_view_text(&view, text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("\xC5\x9F" "a", text);
+}
+
 /* ========== Test Runner ========== */
 
 void run_pdu_decoder_tests(void) {
@@ -255,4 +644,21 @@ void run_pdu_decoder_tests(void) {
     RUN_TEST(test_pdu_decode_not_sms_deliver);
     RUN_TEST(test_pdu_decode_international_number);
     RUN_TEST(test_pdu_decode_output_clears_struct);
+    RUN_TEST(test_pdu_decode_gsm7_extension_chars);
+    RUN_TEST(test_pdu_decode_bytes_matches_hex);
+    RUN_TEST(test_pdu_decode_bytes_truncated_udh);
+    RUN_TEST(test_pdu_decode_invalid_hex_rejected);
+    RUN_TEST(test_pdu_stream_matches_decode_any_chunking);
+    RUN_TEST(test_pdu_stream_decodes_before_line_end);
+    RUN_TEST(test_pdu_stream_rejects_submit_early);
+    RUN_TEST(test_pdu_stream_invalid_hex_and_short_line);
+    RUN_TEST(test_pdu_batch_decodes_whole_listing);
+    RUN_TEST(test_pdu_batch_leaves_partial_record);
+    RUN_TEST(test_pdu_batch_respects_capacity_and_drops_bad);
+    RUN_TEST(test_pdu_view_fields_without_decoding);
+    RUN_TEST(test_pdu_view_concat_key_and_negative_tz);
+    RUN_TEST(test_pdu_arena_slices_back_to_back);
+    RUN_TEST(test_pdu_arena_overflow_is_reported);
+    RUN_TEST(test_pdu_arena_fits_full_locking_shift_sms);
+    RUN_TEST(test_pdu_view_indexes_all_udh_ies);
 }
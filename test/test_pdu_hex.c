@@ -0,0 +1,97 @@
+/**
+ * @file test_pdu_hex.c
+ * @brief Unit tests for pdu_hex.c (vectorized hex-to-binary conversion)
+ *
+ * Lengths are chosen to straddle the 8/16/32-character block sizes so the
+ * vector/SWAR block and the scalar tail are both exercised whichever kernel
+ * the host compiler selects.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include "unity.h"
+#include "pdu_hex.h"
+
+static void to_hex(const uint8_t *in, size_t n, char *out, bool lowercase) {
+    const char *digits = lowercase ? "0123456789abcdef" : "0123456789ABCDEF";
+    for (size_t i = 0; i < n; i++) {
+        out[i * 2]     = digits[in[i] >> 4];
+        out[i * 2 + 1] = digits[in[i] & 0x0F];
+    }
+    out[n * 2] = '\0';
+}
+
+void test_hex_all_byte_values_roundtrip(void) {
+    uint8_t in[256], out[256];
+    char hex[513];
+    for (int i = 0; i < 256; i++) in[i] = (uint8_t)i;
+
+    for (int lc = 0; lc < 2; lc++) {
+        to_hex(in, sizeof(in), hex, lc);
+        memset(out, 0, sizeof(out));
+        TEST_ASSERT_TRUE(pdu_hex_decode(hex, 512, out, NULL));
+        TEST_ASSERT_TRUE(memcmp(in, out, sizeof(in)) == 0);
+    }
+}
+
+void test_hex_every_length_roundtrip(void) {
+    uint8_t in[40], out[41];
+    char hex[81];
+    for (int i = 0; i < 40; i++) in[i] = (uint8_t)(i * 37 + 11);
+
+    for (size_t n = 0; n <= sizeof(in); n++) {
+        to_hex(in, n, hex, n % 2);
+        memset(out, 0xAA, sizeof(out));
+        TEST_ASSERT_TRUE(pdu_hex_decode(hex, n * 2, out, NULL));
+        TEST_ASSERT_TRUE(memcmp(in, out, n) == 0);
+        TEST_ASSERT_EQUAL_INT(0xAA, out[n]); /* no write past hex_len / 2 */
+    }
+}
+
+void test_hex_reports_first_invalid_char(void) {
+    /* Characters just outside each valid range, plus high-bit bytes */
+    static const char bad_chars[] = { '/', ':', '@', 'G', '`', 'g', ' ', '\r', (char)0x80, (char)0xC6 };
+    char hex[81];
+    memset(hex, '7', 80);
+    hex[80] = '\0';
+
+    for (size_t b = 0; b < sizeof(bad_chars); b++) {
+        for (size_t pos = 0; pos < 80; pos++) {
+            hex[pos] = bad_chars[b];
+            uint8_t out[40];
+            size_t bad_pos = 9999;
+            TEST_ASSERT_FALSE(pdu_hex_decode(hex, 80, out, &bad_pos));
+            TEST_ASSERT_EQUAL_INT((int)pos, (int)bad_pos);
+            hex[pos] = '7';
+        }
+    }
+}
+
+void test_hex_first_of_two_invalid_chars(void) {
+    char hex[65];
+    memset(hex, 'f', 64);
+    hex[64] = '\0';
+    hex[40] = 'x';
+    hex[5]  = 'z';
+    size_t bad_pos = 0;
+    uint8_t out[32];
+    TEST_ASSERT_FALSE(pdu_hex_decode(hex, 64, out, &bad_pos));
+    TEST_ASSERT_EQUAL_INT(5, (int)bad_pos);
+}
+
+void test_hex_odd_length_ignores_last_nibble(void) {
+    uint8_t out[2] = {0};
+    TEST_ASSERT_TRUE(pdu_hex_decode("A5F", 3, out, NULL));
+    TEST_ASSERT_EQUAL_INT(0xA5, out[0]);
+    TEST_ASSERT_EQUAL_INT(0, out[1]);
+}
+
+void run_pdu_hex_tests(void) {
+    printf("\n=== PDU Hex Kernel Tests ===\n");
+    RUN_TEST(test_hex_all_byte_values_roundtrip);
+    RUN_TEST(test_hex_every_length_roundtrip);
+    RUN_TEST(test_hex_reports_first_invalid_char);
+    RUN_TEST(test_hex_first_of_two_invalid_chars);
+    RUN_TEST(test_hex_odd_length_ignores_last_nibble);
+}
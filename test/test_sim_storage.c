@@ -0,0 +1,251 @@
+/**
+ * @file test_sim_storage.c
+ * @brief Unit tests for sim_storage.c (pending-delete set, bulk vs
+ *        individual delete planning, bulk only with the SIM fully
+ *        accounted for, processed state, messages queued
+ *        for the publisher, +CPMS usage)
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include "unity.h"
+#include "sim_storage.h"
+
+static sim_storage_t s_st;
+static char s_cmd[32];
+static int s_index;
+
+static bool next(void) {
+    return sim_storage_next_delete(&s_st, true, &s_index, s_cmd, sizeof(s_cmd));
+}
+
+/* Fresh state after a complete enumeration, so bulk deletes are allowed */
+static void reset(void) {
+    sim_storage_init(&s_st);
+    sim_storage_set_enumerated(&s_st, true);
+}
+
+void test_sim_storage_bulk_when_nothing_held(void) {
+    reset();
+    for (int i = 1; i <= 30; i++) {
+        sim_storage_mark_read(&s_st, i);
+        sim_storage_mark_delete(&s_st, i);
+    }
+
+    /* A whole backlog goes in one command */
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=1,1", s_cmd);
+    TEST_ASSERT_EQUAL_INT(SIM_STORAGE_BULK, s_index);
+    TEST_ASSERT_FALSE(next());
+
+    sim_storage_delete_done(&s_st, s_index, SIM_DELETE_OK);
+    TEST_ASSERT_EQUAL_INT(0, (int)sim_storage_pending_count(&s_st));
+    TEST_ASSERT_EQUAL_INT(1, (int)s_st.bulk_deletes);
+    TEST_ASSERT_FALSE(next());
+}
+
+void test_sim_storage_individual_when_fragment_held(void) {
+    reset();
+    /* Index 4 is a fragment still waiting for its other parts */
+    sim_storage_mark_read(&s_st, 4);
+    sim_storage_mark_read(&s_st, 7);
+    sim_storage_mark_read(&s_st, 40);
+    sim_storage_mark_delete(&s_st, 40);
+    sim_storage_mark_delete(&s_st, 7);
+
+    /* Individual deletes, lowest index first, all available at once */
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=7", s_cmd);
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=40", s_cmd);
+    TEST_ASSERT_FALSE(next());
+
+    sim_storage_delete_done(&s_st, 7, SIM_DELETE_OK);
+    sim_storage_delete_done(&s_st, 40, SIM_DELETE_OK);
+
+    /* Fragment published: a single pending delete is not worth a bulk command */
+    sim_storage_mark_delete(&s_st, 4);
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=4", s_cmd);
+}
+
+void test_sim_storage_dedup_and_range(void) {
+    reset();
+    sim_storage_mark_read(&s_st, 9);
+    for (int i = 0; i < 5; i++) sim_storage_mark_delete(&s_st, 3);
+    TEST_ASSERT_EQUAL_INT(1, (int)sim_storage_pending_count(&s_st));
+
+    TEST_ASSERT_FALSE(sim_storage_mark_delete(&s_st, -1));
+    TEST_ASSERT_FALSE(sim_storage_mark_delete(&s_st, SIM_STORAGE_MAX_INDEX));
+
+    /* Marking again while the delete is on the wire does not queue a second one */
+    TEST_ASSERT_TRUE(next());
+    sim_storage_mark_delete(&s_st, 3);
+    TEST_ASSERT_FALSE(next());
+
+    /* Every index in range is kept, nothing dropped */
+    reset();
+    for (int i = 0; i < SIM_STORAGE_MAX_INDEX; i++) sim_storage_mark_delete(&s_st, i);
+    TEST_ASSERT_EQUAL_INT(SIM_STORAGE_MAX_INDEX, (int)sim_storage_pending_count(&s_st));
+}
+
+void test_sim_storage_retry_and_bulk_rejected(void) {
+    reset();
+    sim_storage_mark_read(&s_st, 2);
+    sim_storage_mark_delete(&s_st, 5);
+    TEST_ASSERT_TRUE(next());
+    sim_storage_delete_done(&s_st, 5, SIM_DELETE_RETRY);
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=5", s_cmd);
+    sim_storage_delete_done(&s_st, 5, SIM_DELETE_FAILED);
+    TEST_ASSERT_FALSE(next());
+
+    /* A modem without the flag form falls back to individual deletes for good */
+    sim_storage_mark_delete(&s_st, 2);
+    sim_storage_mark_delete(&s_st, 6);
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=1,1", s_cmd);
+    sim_storage_delete_done(&s_st, SIM_STORAGE_BULK, SIM_DELETE_FAILED);
+    TEST_ASSERT_TRUE(s_st.bulk_unsupported);
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=2", s_cmd);
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=6", s_cmd);
+}
+
+void test_sim_storage_processed_until_freed(void) {
+    reset();
+    TEST_ASSERT_FALSE(sim_storage_is_processed(&s_st, 12));
+    sim_storage_mark_read(&s_st, 12);
+    TEST_ASSERT_FALSE(sim_storage_is_processed(&s_st, 12));
+
+    /* Published: processed while the delete is pending and on the wire */
+    sim_storage_mark_delete(&s_st, 12);
+    TEST_ASSERT_TRUE(sim_storage_is_processed(&s_st, 12));
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_TRUE(sim_storage_is_processed(&s_st, 12));
+    sim_storage_delete_done(&s_st, 12, SIM_DELETE_RETRY);
+    TEST_ASSERT_TRUE(sim_storage_is_processed(&s_st, 12));
+
+    /* Freed: the index can carry a new message */
+    TEST_ASSERT_TRUE(next());
+    sim_storage_delete_done(&s_st, 12, SIM_DELETE_OK);
+    TEST_ASSERT_FALSE(sim_storage_is_processed(&s_st, 12));
+}
+
+void test_sim_storage_queued_for_publisher(void) {
+    reset();
+    sim_storage_mark_read(&s_st, 1);
+    sim_storage_mark_delete(&s_st, 1);
+    TEST_ASSERT_TRUE(sim_storage_mark_queued(&s_st, 2));
+    TEST_ASSERT_FALSE(sim_storage_mark_queued(&s_st, SIM_STORAGE_MAX_INDEX));
+
+    /* Handed over: not read again, and no bulk delete may take it along */
+    TEST_ASSERT_TRUE(sim_storage_is_processed(&s_st, 2));
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=1", s_cmd);
+    sim_storage_delete_done(&s_st, 1, SIM_DELETE_OK);
+
+    /* Not published: readable again later, still held back from bulk deletes */
+    sim_storage_unqueue(&s_st, 2);
+    TEST_ASSERT_FALSE(sim_storage_is_processed(&s_st, 2));
+    sim_storage_mark_delete(&s_st, 3);
+    sim_storage_mark_delete(&s_st, 4);
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=3", s_cmd);
+
+    /* Published: the delete lands before the publisher lets go */
+    sim_storage_mark_queued(&s_st, 5);
+    sim_storage_mark_delete(&s_st, 5);
+    sim_storage_unqueue(&s_st, 5);
+    TEST_ASSERT_TRUE(sim_storage_is_processed(&s_st, 5));
+}
+
+void test_sim_storage_bulk_only_when_sim_accounted_for(void) {
+    /* No complete enumeration yet: REC READ messages we never saw may exist */
+    sim_storage_init(&s_st);
+    sim_storage_mark_delete(&s_st, 1);
+    sim_storage_mark_delete(&s_st, 2);
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=1", s_cmd);
+    sim_storage_delete_done(&s_st, 1, SIM_DELETE_OK);
+
+    /* Another command still ahead of it on the modem */
+    sim_storage_set_enumerated(&s_st, true);
+    sim_storage_mark_delete(&s_st, 3);
+    TEST_ASSERT_TRUE(sim_storage_next_delete(&s_st, false, &s_index, s_cmd, sizeof(s_cmd)));
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=2", s_cmd);
+    sim_storage_delete_done(&s_st, 2, SIM_DELETE_OK);
+
+    /* Lost track after the enumeration (overflow, dropped hand-over) */
+    sim_storage_mark_delete(&s_st, 4);
+    sim_storage_set_enumerated(&s_st, false);
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=3", s_cmd);
+    sim_storage_delete_done(&s_st, 3, SIM_DELETE_OK);
+    sim_storage_delete_done(&s_st, 4, SIM_DELETE_OK);
+}
+
+void test_sim_storage_bulk_keeps_reads_made_meanwhile(void) {
+    reset();
+    sim_storage_mark_delete(&s_st, 1);
+    sim_storage_mark_delete(&s_st, 2);
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_EQUAL_INT(SIM_STORAGE_BULK, s_index);
+
+    /* Read while the bulk command was on the wire, then not published */
+    sim_storage_mark_queued(&s_st, 7);
+    sim_storage_delete_done(&s_st, SIM_STORAGE_BULK, SIM_DELETE_OK);
+    sim_storage_unqueue(&s_st, 7);
+
+    /* Still held: the next bulk delete must not take it along */
+    sim_storage_mark_delete(&s_st, 8);
+    sim_storage_mark_delete(&s_st, 9);
+    TEST_ASSERT_TRUE(next());
+    TEST_ASSERT_EQUAL_STRING("AT+CMGD=8", s_cmd);
+}
+
+void test_sim_storage_cpms_usage(void) {
+    int used = -1, total = -1;
+    TEST_ASSERT_TRUE(sim_storage_parse_cpms("+CPMS: \"SM\",3,30,\"SM\",3,30,\"SM\",3,30", &used, &total));
+    TEST_ASSERT_EQUAL_INT(3, used);
+    TEST_ASSERT_EQUAL_INT(30, total);
+    TEST_ASSERT_TRUE(sim_storage_parse_cpms("+CPMS: 5,50,5,50,5,50", &used, &total));
+    TEST_ASSERT_EQUAL_INT(5, used);
+    TEST_ASSERT_EQUAL_INT(50, total);
+    TEST_ASSERT_FALSE(sim_storage_parse_cpms("+CPMS: (\"SM\"),(\"SM\")", &used, &total));
+
+    reset();
+    TEST_ASSERT_EQUAL_INT(-1, s_st.used);
+    sim_storage_set_usage(&s_st, 3, 30);
+    /* Bitmaps cover indices 0..30 only */
+    TEST_ASSERT_TRUE(sim_storage_mark_delete(&s_st, 30));
+    TEST_ASSERT_FALSE(sim_storage_mark_delete(&s_st, 40));
+
+    sim_storage_note_stored(&s_st);
+    TEST_ASSERT_EQUAL_INT(4, s_st.used);
+    TEST_ASSERT_TRUE(next());
+    sim_storage_delete_done(&s_st, s_index, SIM_DELETE_OK);
+    TEST_ASSERT_EQUAL_INT(3, s_st.used);
+
+    /* Bulk delete frees the indices it covered */
+    sim_storage_mark_delete(&s_st, 1);
+    sim_storage_mark_delete(&s_st, 2);
+    TEST_ASSERT_TRUE(next());
+    sim_storage_delete_done(&s_st, s_index, SIM_DELETE_OK);
+    TEST_ASSERT_EQUAL_INT(1, s_st.used);
+}
+
+void run_sim_storage_tests(void) {
+    printf("\n=== SIM Storage Tests ===\n");
+    RUN_TEST(test_sim_storage_bulk_when_nothing_held);
+    RUN_TEST(test_sim_storage_individual_when_fragment_held);
+    RUN_TEST(test_sim_storage_dedup_and_range);
+    RUN_TEST(test_sim_storage_retry_and_bulk_rejected);
+    RUN_TEST(test_sim_storage_processed_until_freed);
+    RUN_TEST(test_sim_storage_queued_for_publisher);
+    RUN_TEST(test_sim_storage_bulk_only_when_sim_accounted_for);
+    RUN_TEST(test_sim_storage_bulk_keeps_reads_made_meanwhile);
+    RUN_TEST(test_sim_storage_cpms_usage);
+}
@@ -0,0 +1,220 @@
+/**
+ * @file test_sms_codec.c
+ * @brief Unit tests for sms_codec.c (GSM 7-bit unpacking, GSM 03.38 -> UTF-8,
+ *        UCS2 -> UTF-8)
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include "unity.h"
+#include "sms_codec.h"
+
+/* Bit-by-bit packer: the obviously-correct inverse of gsm7_unpack() */
+static size_t pack_septets(const uint8_t *septets, size_t n, unsigned fill, uint8_t *out) {
+    size_t octets = (fill + n * 7 + 7) / 8;
+    memset(out, 0, octets);
+    for (size_t k = 0; k < n; k++) {
+        for (unsigned b = 0; b < 7; b++) {
+            size_t bit = fill + k * 7 + b;
+            if (septets[k] & (1u << b)) out[bit / 8] |= (uint8_t)(1u << (bit % 8));
+        }
+    }
+    return octets;
+}
+
+void test_gsm7_unpack_hello(void) {
+    static const uint8_t packed[] = { 0xE8, 0x32, 0x9B, 0xFD, 0x06 };
+    uint8_t septets[8];
+    TEST_ASSERT_EQUAL_INT(5, (int)gsm7_unpack(packed, sizeof(packed), 0, septets, 5));
+    TEST_ASSERT_TRUE(memcmp(septets, "hello", 5) == 0);
+}
+
+void test_gsm7_unpack_all_lengths_and_fill_bits(void) {
+    uint8_t text[160], packed[160], out[160];
+    for (int k = 0; k < 160; k++) text[k] = (uint8_t)((k * 53 + 17) & 0x7F);
+
+    for (unsigned fill = 0; fill < 7; fill++) {
+        for (size_t n = 0; n <= 153; n++) {
+            size_t octets = pack_septets(text, n, fill, packed);
+            memset(out, 0xFF, sizeof(out));
+            TEST_ASSERT_EQUAL_INT((int)n, (int)gsm7_unpack(packed, octets, fill, out, n));
+            TEST_ASSERT_TRUE(memcmp(text, out, n) == 0);
+            TEST_ASSERT_EQUAL_INT(0xFF, out[n]); /* no write past num_septets */
+        }
+    }
+}
+
+void test_gsm7_unpack_stops_at_end_of_input(void) {
+    /* 3 octets hold 24 bits = 3 whole septets; asking for 10 must not overrun */
+    static const uint8_t packed[] = { 0xE8, 0x32, 0x9B };
+    uint8_t septets[10];
+    TEST_ASSERT_EQUAL_INT(3, (int)gsm7_unpack(packed, sizeof(packed), 0, septets, 10));
+    TEST_ASSERT_TRUE(memcmp(septets, "hel", 3) == 0);
+    TEST_ASSERT_EQUAL_INT(0, (int)gsm7_unpack(packed, 0, 0, septets, 10));
+}
+
+void test_gsm7_to_utf8_basic_and_extension(void) {
+    /* @ £ ä then the escape pairs for euro { } [ ] ~ \ | ^ */
+    static const uint8_t septets[] = {
+        0x00, 0x01, 0x7B,
+        0x1B, 0x65, 0x1B, 0x28, 0x1B, 0x29, 0x1B, 0x3C, 0x1B, 0x3E,
+        0x1B, 0x3D, 0x1B, 0x2F, 0x1B, 0x40, 0x1B, 0x14
+    };
+    static const unsigned char expected[] = {
+        0x40, 0xC2, 0xA3, 0xC3, 0xA4,
+        0xE2, 0x82, 0xAC, '{', '}', '[', ']', '~', '\\', '|', '^', 0x00
+    };
+    char out[64];
+    size_t n = gsm7_to_utf8(septets, sizeof(septets), out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING((const char *)expected, out);
+    TEST_ASSERT_EQUAL_INT((int)strlen((const char *)expected), (int)n);
+}
+
+void test_gsm7_to_utf8_unassigned_extension_falls_back(void) {
+    /* 1B 41 is unassigned -> basic 'A'; 1B 1B shows as a space */
+    static const uint8_t septets[] = { 0x1B, 0x41, 0x1B, 0x1B, 0x62 };
+    char out[16];
+    gsm7_to_utf8(septets, sizeof(septets), out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("A b", out);
+}
+
+void test_gsm7_to_utf8_respects_out_size(void) {
+    /* Greek capitals are 2 bytes each; a 6-byte buffer fits two plus NUL */
+    static const uint8_t septets[] = { 0x10, 0x12, 0x13, 0x14 };
+    char out[8];
+    memset(out, 'X', sizeof(out));
+    size_t n = gsm7_to_utf8(septets, sizeof(septets), out, 6);
+    TEST_ASSERT_EQUAL_INT(4, (int)n);
+    TEST_ASSERT_EQUAL_INT(0, out[4]);
+    TEST_ASSERT_EQUAL_INT('X', out[6]);
+}
+
+/* Unit-at-a-time UCS2 decoder (the original decode_ucs2()) as the reference */
+static size_t ucs2_reference(const uint8_t *data, size_t data_len, char *out, size_t out_size) {
+    size_t j = 0;
+    size_t i = 0;
+    while (i + 1 < data_len && j + 4 < out_size) {
+        uint32_t wc = ((uint32_t)data[i] << 8) | data[i + 1];
+        i += 2;
+        if (wc >= 0xD800 && wc <= 0xDBFF && i + 1 < data_len) {
+            uint32_t lo = ((uint32_t)data[i] << 8) | data[i + 1];
+            if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                wc = 0x10000u + ((wc - 0xD800u) << 10) + (lo - 0xDC00u);
+                i += 2;
+            }
+        }
+        if (wc >= 0xD800 && wc <= 0xDFFF) wc = 0xFFFD;
+        if (wc < 0x80) {
+            out[j++] = (char)wc;
+        } else if (wc < 0x800) {
+            out[j++] = (char)(0xC0 | (wc >> 6));
+            out[j++] = (char)(0x80 | (wc & 0x3F));
+        } else if (wc < 0x10000) {
+            out[j++] = (char)(0xE0 | (wc >> 12));
+            out[j++] = (char)(0x80 | ((wc >> 6) & 0x3F));
+            out[j++] = (char)(0x80 | (wc & 0x3F));
+        } else {
+            out[j++] = (char)(0xF0 | (wc >> 18));
+            out[j++] = (char)(0x80 | ((wc >> 12) & 0x3F));
+            out[j++] = (char)(0x80 | ((wc >> 6) & 0x3F));
+            out[j++] = (char)(0x80 | (wc & 0x3F));
+        }
+    }
+    out[j] = '\0';
+    return j;
+}
+
+void test_ucs2_to_utf8_paths(void) {
+    /* "Hi, world" (ASCII run) + 你好 (BMP run) + é + emoji pair + 'A' */
+    static const uint8_t be[] = {
+        0x00, 'H', 0x00, 'i', 0x00, ',', 0x00, ' ', 0x00, 'w', 0x00, 'o', 0x00, 'r',
+        0x00, 'l', 0x00, 'd', 0x4F, 0x60, 0x59, 0x7D, 0x00, 0xE9,
+        0xD8, 0x3D, 0xDC, 0xE9, 0x00, 'A'
+    };
+    static const unsigned char expected[] = {
+        'H', 'i', ',', ' ', 'w', 'o', 'r', 'l', 'd', 0xE4, 0xBD, 0xA0, 0xE5, 0xA5, 0xBD,
+        0xC3, 0xA9, 0xF0, 0x9F, 0x93, 0xA9, 'A', 0x00
+    };
+    char out[64];
+    size_t n = ucs2_to_utf8(be, sizeof(be), out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING((const char *)expected, out);
+    TEST_ASSERT_EQUAL_INT((int)strlen((const char *)expected), (int)n);
+}
+
+void test_ucs2_to_utf8_unpaired_surrogates(void) {
+    /* lone low, lone high before BMP, high at the very end */
+    static const uint8_t be[] = { 0xDC, 0x00, 0xD8, 0x00, 0x4E, 0x2D, 0xDB, 0xFF };
+    static const unsigned char expected[] = {
+        0xEF, 0xBF, 0xBD, 0xEF, 0xBF, 0xBD, 0xE4, 0xB8, 0xAD, 0xEF, 0xBF, 0xBD, 0x00
+    };
+    char out[32];
+    ucs2_to_utf8(be, sizeof(be), out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING((const char *)expected, out);
+}
+
+void test_ucs2_to_utf8_matches_reference(void) {
+    /* Code units drawn from every path, including boundary values */
+    static const uint16_t pool[] = {
+        0x0000, 0x0041, 0x007F, 0x0080, 0x00E9, 0x07FF, 0x0800, 0x4E2D, 0x9FA5,
+        0xD7FF, 0xD83D, 0xDBFF, 0xDC00, 0xDCE9, 0xDFFF, 0xE000, 0xFF0C, 0xFFFF,
+        0x0061, 0x0062, 0x0063, 0x0020, 0x0031
+    };
+    uint8_t be[96];
+    char a[256], b[256];
+    uint32_t seed = 12345;
+
+    for (int round = 0; round < 400; round++) {
+        size_t len = (size_t)(round % 95) + 1;
+        for (size_t k = 0; k + 1 < len; k += 2) {
+            seed = seed * 1103515245u + 12345u;
+            /* Bias toward ASCII and CJK runs so the fast paths get long inputs */
+            unsigned pick = (seed >> 16) % 4 == 0 ? (seed >> 8) % (sizeof(pool) / sizeof(pool[0]))
+                          : (round & 1) ? 18 + (seed >> 8) % 5 : 7;
+            be[k] = (uint8_t)(pool[pick] >> 8);
+            be[k + 1] = (uint8_t)pool[pick];
+        }
+        if (len & 1) be[len - 1] = 0x4E;
+
+        for (size_t out_size = 1; out_size <= 200; out_size += (out_size < 40) ? 1 : 37) {
+            memset(a, 'X', sizeof(a));
+            memset(b, 'X', sizeof(b));
+            size_t na = ucs2_reference(be, len, a, out_size);
+            size_t nb = ucs2_to_utf8(be, len, b, out_size);
+            TEST_ASSERT_EQUAL_INT((int)na, (int)nb);
+            TEST_ASSERT_EQUAL_INT(0, memcmp(a, b, na + 1));
+        }
+    }
+}
+
+void test_gsm7_to_utf8_national_shift_tables(void) {
+    /* Turkish locking: 0x04 euro, 0x40 I-dot, 0x60 c-cedilla; 0x41 stays 'A' */
+    static const uint8_t tr[] = { 0x04, 0x40, 0x60, 0x41 };
+    /* Spanish single: 1B 41 A-acute, 1B 65 euro; basic set unchanged */
+    static const uint8_t es[] = { 0x1B, 0x41, 0x1B, 0x65, 0x7B };
+    char out[32];
+
+    gsm7_to_utf8_lang(tr, sizeof(tr), GSM7_LANG_TURKISH, GSM7_LANG_DEFAULT, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("\xE2\x82\xAC" "\xC4\xB0" "\xC3\xA7" "A", out);
+
+    gsm7_to_utf8_lang(es, sizeof(es), GSM7_LANG_DEFAULT, GSM7_LANG_SPANISH, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("\xC3\x81" "\xE2\x82\xAC" "\xC3\xA4", out);
+
+    /* Unsupported language IDs fall back to the default tables */
+    gsm7_to_utf8_lang(tr, sizeof(tr), 13, 13, out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("\xC3\xA8" "\xC2\xA1" "\xC2\xBF" "A", out);
+}
+
+void run_sms_codec_tests(void) {
+    printf("\n=== SMS Codec Tests ===\n");
+    RUN_TEST(test_gsm7_unpack_hello);
+    RUN_TEST(test_gsm7_unpack_all_lengths_and_fill_bits);
+    RUN_TEST(test_gsm7_unpack_stops_at_end_of_input);
+    RUN_TEST(test_gsm7_to_utf8_basic_and_extension);
+    RUN_TEST(test_gsm7_to_utf8_unassigned_extension_falls_back);
+    RUN_TEST(test_gsm7_to_utf8_respects_out_size);
+    RUN_TEST(test_gsm7_to_utf8_national_shift_tables);
+    RUN_TEST(test_ucs2_to_utf8_paths);
+    RUN_TEST(test_ucs2_to_utf8_unpaired_surrogates);
+    RUN_TEST(test_ucs2_to_utf8_matches_reference);
+}
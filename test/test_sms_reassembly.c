@@ -0,0 +1,377 @@
+/**
+ * @file test_sms_reassembly.c
+ * @brief Unit tests for sms_assembly.c (raw user-data reassembly, decoded
+ *        once over the joined parts, shared block pool and eviction)
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include "unity.h"
+#include "sms_assembly.h"
+
+static sms_assembly_t s_as;
+static uint8_t s_pdu[4][PDU_MAX_OCTETS];
+
+/* Bit-by-bit packer, as in test_sms_codec.c */
+static size_t pack_septets(const uint8_t *septets, size_t n, unsigned fill, uint8_t *out) {
+    size_t octets = (fill + n * 7 + 7) / 8;
+    memset(out, 0, octets);
+    for (size_t k = 0; k < n; k++) {
+        for (unsigned b = 0; b < 7; b++) {
+            size_t bit = fill + k * 7 + b;
+            if (septets[k] & (1u << b)) out[bit / 8] |= (uint8_t)(1u << (bit % 8));
+        }
+    }
+    return octets;
+}
+
+/**
+ * Build an SMS-DELIVER from +85291234567 with an 8-bit concat UDH and
+ * parse it into @p view. GSM 7-bit text is given as septets, UCS2 as
+ * UTF-16BE octets.
+ */
+static void make_part(int slot, uint8_t dcs, uint8_t ref, uint8_t total, uint8_t part,
+                      const uint8_t *text, size_t n, pdu_sms_view_t *view) {
+    static const uint8_t head[] = {
+        0x00,                                       /* no SMSC */
+        0x44,                                       /* SMS-DELIVER, UDHI */
+        0x0B, 0x91, 0x58, 0x92, 0x21, 0x43, 0x65, 0xF7,
+        0x00,                                       /* PID */
+    };
+    static const uint8_t scts[] = { 0x42, 0x01, 0x51, 0x21, 0x43, 0x65, 0x23 };
+    uint8_t *p = s_pdu[slot];
+    size_t pos = 0;
+
+    memcpy(p, head, sizeof(head));
+    pos += sizeof(head);
+    p[pos++] = dcs;
+    memcpy(p + pos, scts, sizeof(scts));
+    pos += sizeof(scts);
+
+    size_t udl_pos = pos++;
+    const uint8_t udh[] = { 0x05, 0x00, 0x03, ref, total, part };
+    memcpy(p + pos, udh, sizeof(udh));
+    pos += sizeof(udh);
+
+    if (dcs == 0x08) {
+        memcpy(p + pos, text, n);
+        pos += n;
+        p[udl_pos] = (uint8_t)(sizeof(udh) + n);
+    } else {
+        /* 48 UDH bits + 1 fill bit = 7 septets, text starts on septet 7 */
+        pos += pack_septets(text, n, 1, p + pos);
+        p[udl_pos] = (uint8_t)(7 + n);
+    }
+
+    TEST_ASSERT_TRUE(pdu_view_parse(p, pos, view));
+    TEST_ASSERT_TRUE(view->is_multipart);
+}
+
+static sms_assembly_result_t add_ref_part(uint8_t ref, uint8_t dcs, uint8_t total, uint8_t part,
+                                          const char *text, size_t n, int64_t now,
+                                          sms_assembly_slot_t **out) {
+    pdu_sms_view_t view;
+    make_part(3, dcs, ref, total, part, (const uint8_t *)text, n, &view);
+    return sms_assembly_add(&s_as, "+85291234567", &view, 10 + part, now, out);
+}
+
+static sms_assembly_result_t add_part(int slot, uint8_t dcs, uint8_t total, uint8_t part,
+                                      const char *text, size_t n, int64_t now,
+                                      sms_assembly_slot_t **out) {
+    pdu_sms_view_t view;
+    make_part(slot, dcs, 0x42, total, part, (const uint8_t *)text, n, &view);
+    return sms_assembly_add(&s_as, "+85291234567", &view, 10 + part, now, out);
+}
+
+static int sim_index_of(const sms_assembly_slot_t *slot, int part_num) {
+    const sms_assembly_part_t *part = sms_assembly_part(&s_as, slot, part_num);
+    return part ? part->sim_index : -1;
+}
+
+void test_reassembly_gsm7_in_order(void) {
+    sms_assembly_slot_t *slot;
+    char out[256];
+    bool truncated = true;
+
+    sms_assembly_init(&s_as);
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_STORED, add_part(0, 0x00, 2, 1, "Hello ", 6, 0, &slot));
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_COMPLETE, add_part(1, 0x00, 2, 2, "World", 5, 10, &slot));
+    TEST_ASSERT_EQUAL_INT(11, sim_index_of(slot, 1));
+    TEST_ASSERT_EQUAL_INT(12, sim_index_of(slot, 2));
+
+    TEST_ASSERT_EQUAL_INT(11, (int)sms_assembly_text(&s_as, slot, out, sizeof(out), &truncated));
+    TEST_ASSERT_EQUAL_STRING("Hello World", out);
+    TEST_ASSERT_FALSE(truncated);
+
+    sms_assembly_release(&s_as, slot);
+    TEST_ASSERT_FALSE(slot->active);
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_POOL_BLOCKS, s_as.blocks_free);
+}
+
+void test_reassembly_escape_split_across_parts(void) {
+    /* "Price: " ESC | 'e' " 5" -> the euro sign straddles the parts */
+    static const char p1[] = "Price: \x1B";
+    static const char p2[] = "\x65 5";
+    sms_assembly_slot_t *slot;
+    char out[64];
+
+    sms_assembly_init(&s_as);
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_STORED, add_part(1, 0x00, 2, 2, p2, 3, 0, &slot));
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_COMPLETE, add_part(0, 0x00, 2, 1, p1, 8, 0, &slot));
+
+    sms_assembly_text(&s_as, slot, out, sizeof(out), NULL);
+    TEST_ASSERT_EQUAL_STRING("Price: \xE2\x82\xAC 5", out);
+}
+
+void test_reassembly_surrogate_pair_split_across_parts(void) {
+    /* U+1F600 as D83D | DE00, then "!" */
+    static const char p1[] = { 0x00, 'A', (char)0xD8, 0x3D };
+    static const char p2[] = { (char)0xDE, 0x00, 0x00, '!' };
+    sms_assembly_slot_t *slot;
+    char out[64];
+
+    sms_assembly_init(&s_as);
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_STORED, add_part(0, 0x08, 2, 1, p1, 4, 0, &slot));
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_COMPLETE, add_part(1, 0x08, 2, 2, p2, 4, 0, &slot));
+
+    sms_assembly_text(&s_as, slot, out, sizeof(out), NULL);
+    TEST_ASSERT_EQUAL_STRING("A\xF0\x9F\x98\x80!", out);
+}
+
+void test_reassembly_duplicate_and_invalid(void) {
+    sms_assembly_slot_t *slot;
+    pdu_sms_view_t view;
+
+    sms_assembly_init(&s_as);
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_STORED, add_part(0, 0x00, 3, 1, "abc", 3, 0, &slot));
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_DUPLICATE, add_part(1, 0x00, 3, 1, "xyz", 3, 0, &slot));
+    TEST_ASSERT_EQUAL_INT(1, slot->received_parts);
+    TEST_ASSERT_EQUAL_INT(11, sim_index_of(slot, 1));
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_POOL_BLOCKS - 1, s_as.blocks_free);
+
+    /* Single-part messages have no place here */
+    memset(&view, 0, sizeof(view));
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_INVALID,
+                          sms_assembly_add(&s_as, "+85291234567", &view, 5, 0, &slot));
+    TEST_ASSERT_NULL(slot);
+}
+
+void test_reassembly_timeout_with_missing_part(void) {
+    sms_assembly_slot_t *slot;
+    char out[64];
+
+    sms_assembly_init(&s_as);
+    /* Part 1 ends in an escape; with part 2 missing it must not pair with part 3 */
+    add_part(0, 0x00, 3, 1, "ab\x1B", 3, 1000, &slot);
+    add_part(2, 0x00, 3, 3, "\x65z", 2, 2000, &slot);
+
+    TEST_ASSERT_NULL(sms_assembly_expired(&s_as, 31000, 30000));
+    TEST_ASSERT_TRUE(sms_assembly_expired(&s_as, 31001, 30000) == slot);
+
+    sms_assembly_text(&s_as, slot, out, sizeof(out), NULL);
+    TEST_ASSERT_EQUAL_STRING("abez", out);
+}
+
+void test_reassembly_reports_truncation(void) {
+    sms_assembly_slot_t *slot;
+    char out[8];
+    bool truncated = false;
+
+    sms_assembly_init(&s_as);
+    add_part(0, 0x00, 2, 1, "0123456789", 10, 0, &slot);
+    add_part(1, 0x00, 2, 2, "abcdef", 6, 0, &slot);
+
+    size_t len = sms_assembly_text(&s_as, slot, out, sizeof(out), &truncated);
+    TEST_ASSERT_TRUE(len < sizeof(out));
+    TEST_ASSERT_EQUAL_INT(len, (int)strlen(out));
+    TEST_ASSERT_TRUE(truncated);
+
+    /* Cut at a character boundary: "é" (septet 0x05) is two UTF-8 bytes */
+    sms_assembly_init(&s_as);
+    add_part(0, 0x00, 2, 1, "\x05\x05\x05\x05\x05", 5, 0, &slot);
+    add_part(1, 0x00, 2, 2, "\x05", 1, 0, &slot);
+    TEST_ASSERT_EQUAL_INT(6, (int)sms_assembly_text(&s_as, slot, out, sizeof(out), &truncated));
+    TEST_ASSERT_EQUAL_STRING("\xC3\xA9\xC3\xA9\xC3\xA9", out);
+    TEST_ASSERT_TRUE(truncated);
+}
+
+void test_reassembly_many_parts_across_chunks(void) {
+    /* 12 full parts, arriving last to first; the escape at the end of part 4
+     * falls on the boundary of a converter chunk */
+    enum { PARTS = 12, LEN = 153 };
+    static char expected[PARTS * LEN + 8];
+    char text[LEN];
+    static char out[PARTS * LEN * 2];
+    sms_assembly_slot_t *slot;
+    size_t e = 0;
+
+    sms_assembly_init(&s_as);
+    for (int p = PARTS; p >= 1; p--) {
+        memset(text, 'a' + p, LEN);
+        if (p == 4) text[LEN - 1] = 0x1B;
+        if (p == 5) text[0] = 0x65;
+        sms_assembly_result_t r = add_part(p % 4, 0x00, PARTS, (uint8_t)p, text, LEN, 0, &slot);
+        TEST_ASSERT_EQUAL_INT(p == 1 ? SMS_ASSEMBLY_COMPLETE : SMS_ASSEMBLY_STORED, r);
+    }
+    for (int p = 1; p <= PARTS; p++) {
+        for (int k = 0; k < LEN; k++) {
+            if (p == 4 && k == LEN - 1) continue;
+            if (p == 5 && k == 0) {
+                memcpy(expected + e, "\xE2\x82\xAC", 3);
+                e += 3;
+            } else {
+                expected[e++] = (char)('a' + p);
+            }
+        }
+    }
+    expected[e] = '\0';
+
+    TEST_ASSERT_EQUAL_INT(10 + 7, sim_index_of(slot, 7));
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_POOL_BLOCKS - PARTS, s_as.blocks_free);
+    TEST_ASSERT_EQUAL_INT((int)e, (int)sms_assembly_text(&s_as, slot, out, sizeof(out), NULL));
+    TEST_ASSERT_EQUAL_STRING(expected, out);
+
+    sms_assembly_release(&s_as, slot);
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_POOL_BLOCKS, s_as.blocks_free);
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_POOL_BLOCKS - PARTS, s_as.blocks_free_min);
+}
+
+void test_reassembly_surrogate_across_chunks(void) {
+    /* Six full UCS2 parts of "A"; part 4 ends with D83D, part 5 starts with DE00 */
+    enum { PARTS = 6, LEN = 134 };
+    char text[LEN];
+    static char out[1024];
+    sms_assembly_slot_t *slot;
+
+    sms_assembly_init(&s_as);
+    for (int p = 1; p <= PARTS; p++) {
+        for (int k = 0; k < LEN; k += 2) {
+            text[k] = 0x00;
+            text[k + 1] = 'A';
+        }
+        if (p == 4) {
+            text[LEN - 2] = (char)0xD8;
+            text[LEN - 1] = 0x3D;
+        }
+        if (p == 5) {
+            text[0] = (char)0xDE;
+            text[1] = 0x00;
+        }
+        add_part(p % 4, 0x08, PARTS, (uint8_t)p, text, LEN, 0, &slot);
+    }
+
+    size_t len = sms_assembly_text(&s_as, slot, out, sizeof(out), NULL);
+    /* 6 * 67 units, two of them one emoji (4 bytes) */
+    TEST_ASSERT_EQUAL_INT(PARTS * (LEN / 2) - 2 + 4, (int)len);
+    TEST_ASSERT_TRUE(strstr(out, "A\xF0\x9F\x98\x80" "A") != NULL);
+}
+
+void test_reassembly_evicts_oldest_when_full(void) {
+    sms_assembly_slot_t *slot, *first;
+
+    /* Pool: an old 30-part message, then a new one until no block is left */
+    sms_assembly_init(&s_as);
+    for (int p = 1; p <= 30; p++) add_ref_part(1, 0x00, 30 + 1, (uint8_t)p, "x", 1, 0, &first);
+    for (int p = 1; p <= SMS_ASSEMBLY_POOL_BLOCKS - 30; p++) {
+        TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_STORED, add_ref_part(2, 0x00, 50, (uint8_t)p, "y", 1, 10, &slot));
+    }
+    TEST_ASSERT_EQUAL_INT(0, s_as.blocks_free);
+
+    /* Nothing is overwritten: the caller is told to give up the oldest */
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_EVICT, add_ref_part(2, 0x00, 50, 20, "y", 1, 20, &slot));
+    TEST_ASSERT_TRUE(slot == first);
+    TEST_ASSERT_EQUAL_INT(30, first->received_parts);
+    TEST_ASSERT_EQUAL_INT(1, (int)s_as.evictions);
+    sms_assembly_release(&s_as, slot);
+    TEST_ASSERT_EQUAL_INT(30, s_as.blocks_free);
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_STORED, add_ref_part(2, 0x00, 50, 20, "y", 1, 20, &slot));
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_POOL_BLOCKS - 30 + 1, slot->received_parts);
+
+    /* Slots: one part each, a new message beyond the last slot evicts the oldest */
+    sms_assembly_init(&s_as);
+    for (int m = 0; m < SMS_ASSEMBLY_SLOTS; m++) {
+        add_ref_part((uint8_t)m, 0x00, 2, 1, "z", 1, 100 + m, &slot);
+        if (m == 0) first = slot;
+    }
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_EVICT, add_ref_part(200, 0x00, 2, 1, "z", 1, 200, &slot));
+    TEST_ASSERT_TRUE(slot == first);
+    /* A part of a message already held still fits */
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_COMPLETE, add_ref_part(3, 0x00, 2, 2, "z", 1, 200, &slot));
+}
+
+typedef struct {
+    size_t total;
+    size_t largest;
+    size_t stop_after;      /* Refuse the chunk that would pass this (0: never) */
+} sink_stats_t;
+
+static bool count_chunk(const char *text, size_t len, void *ctx) {
+    sink_stats_t *st = ctx;
+    if (st->stop_after && st->total + len > st->stop_after) return false;
+    for (size_t i = 0; i < len; i++) TEST_ASSERT_EQUAL_INT('q', text[i]);
+    st->total += len;
+    if (len > st->largest) st->largest = len;
+    return true;
+}
+
+void test_reassembly_part_limits(void) {
+    enum { LEN = 153 };
+    char text[LEN];
+    sms_assembly_slot_t *slot;
+    sink_stats_t st;
+    bool truncated = true;
+
+    /* Part numbers beyond the total are refused before anything is stored */
+    sms_assembly_init(&s_as);
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_INVALID, add_part(0, 0x00, 3, 4, "abc", 3, 0, &slot));
+    TEST_ASSERT_NULL(slot);
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_POOL_BLOCKS, s_as.blocks_free);
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_STORED, add_part(0, 0x00, 3, 1, "abc", 3, 0, &slot));
+    /* ... and beyond the total of the message already held */
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_INVALID, add_part(1, 0x00, 5, 4, "def", 3, 0, &slot));
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_POOL_BLOCKS - 1, s_as.blocks_free);
+
+    /* 255 full parts: the pool gives out every 40, each piece streams out in chunks */
+    sms_assembly_init(&s_as);
+    memset(&st, 0, sizeof(st));
+    memset(text, 'q', LEN);
+    for (int p = 1; p <= SMS_ASSEMBLY_MAX_PARTS; p++) {
+        sms_assembly_result_t r;
+        while ((r = add_ref_part(7, 0x00, SMS_ASSEMBLY_MAX_PARTS, (uint8_t)p, text, LEN, p, &slot)) ==
+               SMS_ASSEMBLY_EVICT) {
+            sms_assembly_text_stream(&s_as, slot, count_chunk, &st, &truncated);
+            TEST_ASSERT_FALSE(truncated);
+            sms_assembly_release(&s_as, slot);
+        }
+        TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_STORED, r);
+    }
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_MAX_PARTS / SMS_ASSEMBLY_POOL_BLOCKS, (int)s_as.evictions);
+    slot = sms_assembly_expired(&s_as, 1000, 0);
+    TEST_ASSERT_NOT_NULL(slot);
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_MAX_PARTS % SMS_ASSEMBLY_POOL_BLOCKS, slot->received_parts);
+    sms_assembly_text_stream(&s_as, slot, count_chunk, &st, &truncated);
+    TEST_ASSERT_EQUAL_INT(SMS_ASSEMBLY_MAX_PARTS * LEN, (int)st.total);
+    TEST_ASSERT_TRUE(st.largest <= SMS_ASSEMBLY_CHUNK_TEXT);
+
+    /* A sink that stops early marks the text truncated */
+    memset(&st, 0, sizeof(st));
+    st.stop_after = LEN;
+    TEST_ASSERT_EQUAL_INT(0, (int)sms_assembly_text_stream(&s_as, slot, count_chunk, &st, &truncated));
+    TEST_ASSERT_TRUE(truncated);
+    TEST_ASSERT_EQUAL_INT(0, (int)st.total);
+}
+
+void run_sms_reassembly_tests(void) {
+    printf("\n=== SMS Reassembly Tests ===\n");
+    RUN_TEST(test_reassembly_gsm7_in_order);
+    RUN_TEST(test_reassembly_escape_split_across_parts);
+    RUN_TEST(test_reassembly_surrogate_pair_split_across_parts);
+    RUN_TEST(test_reassembly_duplicate_and_invalid);
+    RUN_TEST(test_reassembly_timeout_with_missing_part);
+    RUN_TEST(test_reassembly_reports_truncation);
+    RUN_TEST(test_reassembly_many_parts_across_chunks);
+    RUN_TEST(test_reassembly_surrogate_across_chunks);
+    RUN_TEST(test_reassembly_evicts_oldest_when_full);
+    RUN_TEST(test_reassembly_part_limits);
+}
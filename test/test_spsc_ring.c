@@ -0,0 +1,162 @@
+/**
+ * @file test_spsc_ring.c
+ * @brief Unit tests for spsc_ring.c (FIFO order, full/empty, in-place
+ *        slots, index wrap-around, spans, producer/consumer on two threads)
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include "unity.h"
+#include "spsc_ring.h"
+
+#ifdef SPSC_TEST_THREADS
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+typedef struct {
+    uint32_t seq;
+    char text[12];
+} item_t;
+
+static spsc_ring_t s_ring;
+static item_t s_items[4];
+
+void test_spsc_ring_fifo_full_empty(void) {
+    item_t in = {0}, out;
+
+    TEST_ASSERT_FALSE(spsc_ring_init(&s_ring, s_items, sizeof(item_t), 3));
+    TEST_ASSERT_TRUE(spsc_ring_init(&s_ring, s_items, sizeof(item_t), 4));
+    TEST_ASSERT_FALSE(spsc_ring_pop(&s_ring, &out));
+    TEST_ASSERT_NULL(spsc_ring_front(&s_ring));
+
+    for (uint32_t i = 0; i < 4; i++) {
+        in.seq = i;
+        TEST_ASSERT_TRUE(spsc_ring_push(&s_ring, &in));
+    }
+    /* Full: the producer is told, nothing is overwritten */
+    in.seq = 99;
+    TEST_ASSERT_FALSE(spsc_ring_push(&s_ring, &in));
+    TEST_ASSERT_NULL(spsc_ring_acquire(&s_ring));
+    TEST_ASSERT_EQUAL_INT(4, (int)spsc_ring_count(&s_ring));
+    TEST_ASSERT_EQUAL_INT(0, (int)spsc_ring_free(&s_ring));
+
+    for (uint32_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(spsc_ring_pop(&s_ring, &out));
+        TEST_ASSERT_EQUAL_INT((int)i, (int)out.seq);
+    }
+    TEST_ASSERT_FALSE(spsc_ring_pop(&s_ring, &out));
+    TEST_ASSERT_EQUAL_INT(4, (int)spsc_ring_free(&s_ring));
+}
+
+void test_spsc_ring_in_place_and_wrap(void) {
+    spsc_ring_init(&s_ring, s_items, sizeof(item_t), 4);
+    /* Start just below the 32-bit wrap so the free-running indices overflow */
+    atomic_store(&s_ring.head, UINT32_MAX - 1);
+    atomic_store(&s_ring.tail, UINT32_MAX - 1);
+
+    for (uint32_t i = 0; i < 10; i++) {
+        item_t *slot = spsc_ring_acquire(&s_ring);
+        TEST_ASSERT_NOT_NULL(slot);
+        slot->seq = i;
+        snprintf(slot->text, sizeof(slot->text), "msg%u", (unsigned)i);
+
+        /* Not visible until committed */
+        if (i == 0) TEST_ASSERT_NULL(spsc_ring_front(&s_ring));
+        spsc_ring_commit(&s_ring);
+
+        item_t *front = spsc_ring_front(&s_ring);
+        TEST_ASSERT_NOT_NULL(front);
+        TEST_ASSERT_EQUAL_INT((int)i, (int)front->seq);
+        TEST_ASSERT_TRUE(front == slot);
+        spsc_ring_release(&s_ring);
+        TEST_ASSERT_EQUAL_INT(0, (int)spsc_ring_count(&s_ring));
+    }
+    TEST_ASSERT_EQUAL_STRING("msg9", s_items[(UINT32_MAX - 1 + 9) & 3].text);
+}
+
+void test_spsc_ring_span_stops_at_wrap(void) {
+    item_t out;
+    uint32_t n = 0;
+
+    spsc_ring_init(&s_ring, s_items, sizeof(item_t), 4);
+    /* Two slots in use from index 1: free are 3 and 0, split by the wrap */
+    atomic_store(&s_ring.head, 3);
+    atomic_store(&s_ring.tail, 1);
+
+    item_t *span = spsc_ring_acquire_span(&s_ring, &n);
+    TEST_ASSERT_TRUE(span == &s_items[3]);
+    TEST_ASSERT_EQUAL_INT(1, (int)n);
+    span[0].seq = 30;
+    spsc_ring_commit_n(&s_ring, 1);
+
+    span = spsc_ring_acquire_span(&s_ring, &n);
+    TEST_ASSERT_TRUE(span == &s_items[0]);
+    TEST_ASSERT_EQUAL_INT(1, (int)n);
+    /* Nothing written: committing none publishes nothing */
+    spsc_ring_commit_n(&s_ring, 0);
+    TEST_ASSERT_EQUAL_INT(3, (int)spsc_ring_count(&s_ring));
+
+    /* Drained: the span runs from the head to the end of the buffer */
+    while (spsc_ring_pop(&s_ring, &out)) {}
+    TEST_ASSERT_EQUAL_INT(30, (int)out.seq);
+    span = spsc_ring_acquire_span(&s_ring, &n);
+    TEST_ASSERT_TRUE(span == &s_items[0]);
+    TEST_ASSERT_EQUAL_INT(4, (int)n);
+    for (uint32_t i = 0; i < 4; i++) span[i].seq = 40 + i;
+    spsc_ring_commit_n(&s_ring, 4);
+    TEST_ASSERT_NULL(spsc_ring_acquire_span(&s_ring, &n));
+    TEST_ASSERT_EQUAL_INT(0, (int)n);
+    for (uint32_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(spsc_ring_pop(&s_ring, &out));
+        TEST_ASSERT_EQUAL_INT((int)(40 + i), (int)out.seq);
+    }
+}
+
+#ifdef SPSC_TEST_THREADS
+#define STRESS_COUNT 50000u
+
+static spsc_ring_t s_stress;
+static uint32_t s_stress_buf[8];
+
+static void *stress_producer(void *arg) {
+    for (uint32_t i = 0; i < STRESS_COUNT; ) {
+        if (spsc_ring_push(&s_stress, &i)) i++;
+        else sched_yield();     /* Let the consumer run on a single-CPU host */
+    }
+    return NULL;
+}
+
+void test_spsc_ring_two_threads(void) {
+    pthread_t producer;
+    uint32_t expected = 0, v;
+    bool in_order = true;
+
+    spsc_ring_init(&s_stress, s_stress_buf, sizeof(uint32_t), 8);
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&producer, NULL, stress_producer, NULL));
+    while (expected < STRESS_COUNT) {
+        if (!spsc_ring_pop(&s_stress, &v)) {
+            sched_yield();
+            continue;
+        }
+        if (v != expected) in_order = false;
+        expected++;
+    }
+    pthread_join(producer, NULL);
+
+    /* Every value exactly once, in order */
+    TEST_ASSERT_TRUE(in_order);
+    TEST_ASSERT_EQUAL_INT(0, (int)spsc_ring_count(&s_stress));
+}
+#endif
+
+void run_spsc_ring_tests(void) {
+    printf("\n=== SPSC Ring Tests ===\n");
+    RUN_TEST(test_spsc_ring_fifo_full_empty);
+    RUN_TEST(test_spsc_ring_in_place_and_wrap);
+    RUN_TEST(test_spsc_ring_span_stops_at_wrap);
+#ifdef SPSC_TEST_THREADS
+    RUN_TEST(test_spsc_ring_two_threads);
+#endif
+}